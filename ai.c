@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
 #include "checkers.h"
@@ -7,94 +8,584 @@
 
 // The logic here is probably wrong in several places. I need to test all of it.
 // But the general idea is +/- ok I think.
+//
+// To see what the search is doing, build with -DTRACE_SEARCH and trace.c,
+// call TRACE_OPEN before searching and look at the file with trace_dump.
 
 
-/* returns board state value; puts selected movement in src and dest */
-double minimax(Game_state* state, int depth, Color maximizing_player, Position* src, Position *dest)
+/* search_init prepares 'search' to search with the given limits
+ * (max_depth <= 0 means no depth limit, movetime_ms == 0 no time limit),
+ * transposition table (NULL for none) and game history (copied; NULL for a
+ * game that starts at the position searched). */
+void search_init(Search *search, int max_depth, long movetime_ms, Ttable *tt,
+                 History *history)
+{
+    search->max_depth = max_depth > 0 ? max_depth : MAXDEPTH;
+    atomic_store(&search->deadline_ms, movetime_ms > 0 ? now_ms() + movetime_ms : 0);
+    search->tt = tt;
+    if (history != NULL)
+        search->history = *history;
+    else
+        history_init(&search->history, DEFAULT_NO_PROGRESS_LIMIT);
+    search->max_nodes = 0;
+    search->plain = false;
+    search->on_depth = NULL;
+    search->on_depth_data = NULL;
+    search->multipv = 1;
+    search->nlines = 0;
+    search->nexcluded = 0;
+    atomic_store(&search->stop, false);
+    atomic_store(&search->depth, 0);
+    atomic_store(&search->nodes, 0);
+    atomic_store(&search->score, 0.0);
+    search->best.length = 0;
+}
+
+
+/* count_node counts another node and tells whether the search must stop.
+ * The clock is only looked at every so many nodes, since it's slower than
+ * searching one. */
+static bool count_node(Search *search)
+{
+    long nodes = atomic_fetch_add_explicit(&search->nodes, 1, memory_order_relaxed) + 1;
+    if (search->max_nodes > 0 && nodes >= search->max_nodes)
+        atomic_store(&search->stop, true);
+    if (nodes % 1024 == 0) {
+        long deadline = atomic_load_explicit(&search->deadline_ms, memory_order_relaxed);
+        if (deadline > 0 && now_ms() >= deadline)
+            atomic_store(&search->stop, true);
+    }
+    return atomic_load_explicit(&search->stop, memory_order_relaxed);
+}
+
+
+/* The transposition table has scores from white's point of view and counts
+ * wins from the position they're stored for; the search has them from the
+ * maximizing player's point of view and counts wins from the root.  These
+ * two convert between both. */
+static double score_to_tt(double score, Color maximizing_player, int ply)
+{
+    if (score > WIN_SCORE / 2)   score += ply;
+    if (score < -WIN_SCORE / 2)  score -= ply;
+    return maximizing_player == WHITE ? score : -score;
+}
+
+static double score_from_tt(double score, Color maximizing_player, int ply)
+{
+    if (maximizing_player != WHITE)  score = -score;
+    if (score > WIN_SCORE / 2)   score -= ply;
+    if (score < -WIN_SCORE / 2)  score += ply;
+    return score;
+}
+
+
+/* The table keeps a position and its mirror image in one entry (see
+ * game_key), written for whichever of them has the smaller hash: in the
+ * other one, white's score is the negation of the entry's and a bound on it
+ * the opposite bound.  That takes an evaluation that scores a position and
+ * its mirror image alike, as evaluate's hand-written one does but the
+ * network needn't; with the network, each is kept by its own hash. */
+static uint64_t tt_key(Game_state *state, bool *mirrored)
+{
+#ifdef NNUE
+    if (nnue_loaded) {
+        *mirrored = false;
+        return state->hash;
+    }
+#endif
+    return game_key(state, mirrored);
+}
+
+static void mirror_entry(Tt_entry *entry)
+{
+    entry->score = -entry->score;
+    if (entry->bound != TT_EXACT)
+        entry->bound = entry->bound == TT_LOWER ? TT_UPPER : TT_LOWER;
+}
+
+static bool probe(Ttable *tt, Game_state *state, Tt_entry *entry)
+{
+    bool mirrored;
+    if (!tt_probe(tt, tt_key(state, &mirrored), entry))
+        return false;
+    if (mirrored)
+        mirror_entry(entry);
+    // The best movement only means something in the list it was found in
+    if (entry->mirrored != mirrored)
+        entry->move = TT_NO_MOVE;
+    return true;
+}
+
+static void keep(Ttable *tt, Game_state *state, Tt_entry *entry)
+{
+    bool mirrored;
+    uint64_t key = tt_key(state, &mirrored);
+    entry->mirrored = mirrored;
+    if (mirrored)
+        mirror_entry(entry);
+    tt_store(tt, key, entry);
+}
+
+static double alphabeta(Search *, Game_state *, int depth, int ply,
+                        double alpha, double beta, Color maximizing_player,
+                        Move *best);
+
+/* The movements after the first are searched the way principal variation
+ * search does: the first one is most likely the best (it's the one the
+ * transposition table or the previous depth found best), so each of the
+ * others is only searched with a null window, which can't tell how good it
+ * is but only whether it's better than what's already been found -- and is
+ * much quicker to search.  Only when it is better is it searched again with
+ * the whole window, to find out by how much.
+ *
+ * Scores are doubles, so the "null" window is just narrower than any
+ * difference between two scores the evaluation can give. */
+#define NULL_WINDOW 0.001
+
+/* Late move reductions: the later a quiet movement comes in the order, the
+ * less likely it is to be any good, so it's first searched less deeply (and
+ * with a null window).  If it still turns out better than what's been found,
+ * it's searched again at the full depth.  Captures, stones getting close to
+ * promotion and movements that let the opponent capture are never reduced:
+ * that's where the tactics are, and a shallower search would miss them.
+ * Neither are the root's movements, one of which has to be chosen, nor
+ * those searched less than three plies deep: there a reduction leaves
+ * almost nothing of the search, and the shots it then misses cost more
+ * (in finding them an iteration later) than the nodes it saves. */
+#define LMR_MIN_DEPTH      3  // only reduce where there's depth to spare
+#define LMR_FIRST          3  // movements before this one are never reduced
+#define LMR_FIRST_TWO      6  // from this one on, two plies are taken off
+#define LMR_PROMOTION_ROWS 2  // stones this close to promotion aren't reduced
+
+/* has_capture tells whether the current player can capture something */
+static bool has_capture(Game_state *state)
+{
+    Position p;
+    for (p.row = 0; p.row < BOARD_SIZE; p.row++)
+        for (p.col = 0; p.col < BOARD_SIZE; p.col++) {
+            if (!piece_matches_player(get_piece(state, p), state->current_player))
+                continue;
+            Dest_options options;
+            generate_dest_options(state, p, &options, true);
+            if (options.length > 0)
+                return true;
+        }
+    return false;
+}
+
+static int reduction(Game_state *state, Game_state *sub_state, Move *move,
+                     Movtype type, int k, int depth, int ply)
+{
+    if (type == CAPTURE || ply == 0 || k < LMR_FIRST || depth < LMR_MIN_DEPTH)
+        return 0;
+
+    // Stones about to be promoted (or just promoted) are breakthroughs
+    Position src = move->path[0], dest = move->path[move->length - 1];
+    Piece piece = get_piece(state, src);
+    int rows_left = is_white(piece) ? BOARD_SIZE - 1 - dest.row : dest.row;
+    if (is_stone(piece) && rows_left <= LMR_PROMOTION_ROWS)
+        return 0;
+    if (has_capture(sub_state))
+        return 0;
+
+    return k >= LMR_FIRST_TWO && depth > LMR_MIN_DEPTH ? 2 : 1;
+}
+
+/* search_late_move searches the kth movement (k > 0) of a node, which led to
+ * 'sub_state', with a null window (and maybe reduced) first, and again as
+ * needed; returns its value like alphabeta would. */
+static double search_late_move(Search *search, Game_state *state, Game_state *sub_state,
+                               Move *move, Movtype type, int k, int depth, int ply,
+                               double alpha, double beta, Color maximizing_player)
+{
+    bool maximize = state->current_player == maximizing_player;
+    // The null window right above alpha (or below beta): all a movement has
+    // to do is get out of it
+    double low  = maximize ? alpha : beta - NULL_WINDOW;
+    double high = maximize ? alpha + NULL_WINDOW : beta;
+
+    int r = reduction(state, sub_state, move, type, k, depth, ply);
+    double value = alphabeta(search, sub_state, depth - 1 - r, ply + 1,
+                             low, high, maximizing_player, NULL);
+    bool better = maximize ? value > alpha : value < beta;
+
+    if (better && r > 0) {
+        value = alphabeta(search, sub_state, depth - 1, ply + 1,
+                          low, high, maximizing_player, NULL);
+        better = maximize ? value > alpha : value < beta;
+    }
+
+    // Better, but by how much?  (Unless it's so good that it's a cutoff
+    // anyway.)
+    if (better && value > alpha && value < beta)
+        value = alphabeta(search, sub_state, depth - 1, ply + 1,
+                          alpha, beta, maximizing_player, NULL);
+    return value;
+}
+
+
+/* alphabeta is minimax with alpha-beta pruning.  'alpha' is the value the
+ * maximizing player is already assured of and 'beta' the value the minimizing
+ * player is assured of; once they cross, the remaining movements can't change
+ * the choice made higher up in the tree and are skipped.  'ply' is the
+ * distance from the root.
+ * If 'best' is given, the best movement is stored in it; if it already holds
+ * a movement, that movement is searched first.  Otherwise the best movement
+ * the transposition table remembers for this position goes first, and the
+ * ones after it go through search_late_move (unless search->plain).
+ * When the search is stopped the value returned is meaningless. */
+static double alphabeta(Search *search, Game_state* state, int depth, int ply,
+                        double alpha, double beta, Color maximizing_player,
+                        Move *best)
 {
     bool maximize = state->current_player == maximizing_player;
     // otherwise minimize
 
-    Mov_options mov_options;
-    generate_mov_options(state, &mov_options);
-
-#if 0
-    if (mov_options.length == 0) {
-        printf("No movement options available.\n");
-        exit(EXIT_FAILURE);
-    } else {
-        for (int i = 0; i < mov_options.length; i++)
-            if (mov_options.array[i].length == 0) {
-                printf("No destinations available.\n");
-                exit(EXIT_FAILURE);
-            }
+    if (count_node(search))
+        return 0;
+
+    // Going around in circles, or shuffling dames for too long, is a draw.
+    // (The root is searched anyway, to have a movement to make.)
+    if (ply > 0 && history_is_draw(&search->history, state, 2))
+        return DRAW_SCORE;
+
+    Move_list moves;
+    generate_moves(state, &moves);
+
+    // A player who can't move loses
+    if (moves.length == 0)
+        return maximize ? -(WIN_SCORE - ply) : WIN_SCORE - ply;
+
+    // Index of the movement to search first, if any
+    int first = -1;
+
+    Tt_entry entry;
+    if (search->tt != NULL && probe(search->tt, state, &entry)) {
+        if (entry.move < moves.length)
+            first = entry.move;
+
+        // Only trust the stored score if it was searched at least as deep as
+        // needed here.  (Not at the root, which must come up with a movement.)
+        if (best == NULL && entry.depth >= depth) {
+            double score = score_from_tt(entry.score, maximizing_player, ply);
+            // The bounds swap when black is maximizing, since the table's
+            // scores are from white's point of view
+            Tt_bound bound = entry.bound;
+            if (maximizing_player != WHITE && bound != TT_EXACT)
+                bound = bound == TT_LOWER ? TT_UPPER : TT_LOWER;
+
+            if (bound == TT_EXACT)
+                return score;
+            if (bound == TT_LOWER && score > alpha)  alpha = score;
+            if (bound == TT_UPPER && score < beta)   beta = score;
+            if (alpha >= beta)
+                return score;
+        }
     }
-#endif
 
-    double sub_values[NUMPIECES][MAXOPTIONS];
+    if (best != NULL && best->length > 0) {
+        int index = find_move(&moves, best);
+        if (index >= 0)
+            first = index;
+    }
+
+    double original_alpha = alpha, original_beta = beta;
+    double value = maximize ? -INFINITY : INFINITY;
+    int best_index = 0;
+
+    history_push(&search->history, state);
 
     Game_state sub_state;
-    for (int i = 0; i < mov_options.length; i++) {
-        for (int j = 0; j < mov_options.array[i].length; j++) {
-            game_copy(&sub_state, state);
-            game_update(&sub_state, mov_options.array[i].src, mov_options.array[i].array[j]);
-
-            if (depth > 0)
-                sub_values[i][j] = minimax(&sub_state, depth - 1, maximizing_player, src, dest);
-            else
-                sub_values[i][j] = evaluate(&sub_state, maximizing_player);
+    int searched = 0;
+    for (int k = 0; k < moves.length; k++) {
+        // Go through the movements in order, except that 'first' goes first
+        int i = k;
+        if (first >= 0)
+            i = k == 0 ? first : (k <= first ? k - 1 : k);
+        Move *move = &moves.array[i];
+
+        // Multi-PV: the root movements found already are out of the running
+        if (ply == 0 && search->nexcluded > 0 && search->root_excluded[i])
+            continue;
+
+        game_copy(&sub_state, state);
+        game_apply_move(&sub_state, move);
+
+        double sub_value;
+        if (depth == 0)
+            sub_value = evaluate(&sub_state, maximizing_player);
+        else if (searched == 0 || search->plain)
+            sub_value = alphabeta(search, &sub_state, depth - 1, ply + 1,
+                                  alpha, beta, maximizing_player, NULL);
+        else
+            sub_value = search_late_move(search, state, &sub_state, move, moves.type,
+                                         k, depth, ply, alpha, beta, maximizing_player);
+        searched++;
+
+        if (atomic_load_explicit(&search->stop, memory_order_relaxed)) {
+            history_pop(&search->history);
+            return value;
         }
+
+        TRACE_SEARCHED(ply, depth, move->path[0], move->path[move->length - 1],
+                       alpha, beta, sub_value);
+
+        bool replace = ( maximize && sub_value > value)
+                    || (!maximize && sub_value < value);
+        if (replace) {
+            value = sub_value;
+            best_index = i;
+        }
+
+        if (maximize && value > alpha)  alpha = value;
+        if (!maximize && value < beta)  beta = value;
+        if (alpha >= beta)  break;
+    }
+
+    history_pop(&search->history);
+
+    if (best != NULL)
+        *best = moves.array[best_index];
+
+    // (With root movements left out, the value isn't the position's)
+    if (search->tt != NULL && !(ply == 0 && search->nexcluded > 0)) {
+        Tt_entry entry = {
+            .score = score_to_tt(value, maximizing_player, ply),
+            .depth = depth,
+            .bound = TT_EXACT,
+            .move  = best_index,
+        };
+        // A value outside the original window is only a bound: the search
+        // was cut off, or every movement failed to get inside the window.
+        if (value <= original_alpha)      entry.bound = TT_UPPER;
+        else if (value >= original_beta)  entry.bound = TT_LOWER;
+        if (maximizing_player != WHITE && entry.bound != TT_EXACT)
+            entry.bound = entry.bound == TT_LOWER ? TT_UPPER : TT_LOWER;
+        keep(search->tt, state, &entry);
     }
 
-    double value = sub_values[0][0];
-    *src = mov_options.array[0].src;
-    *dest = mov_options.array[0].array[0];
-    for (int i = 0; i < mov_options.length; i++) {
-        for (int j = 0; j < mov_options.array[i].length; j++) {
-            Position* sub_src = &mov_options.array[i].src;
-            Position* sub_dest = &mov_options.array[i].array[j];
-
-            print_indentation(depth * 4 + 2);
-            printf("(%d,%d) -> (%d,%d) (%g %s-ing)\n", 
-                    sub_src->col, sub_src->row, sub_dest->col, sub_dest->row,
-                    sub_values[i][j], maximize ? "MAX" : "MIN");
-            while (getchar() != '\n') continue;
-
-            bool replace = ( maximize && sub_values[i][j] > value)
-                        || (!maximize && sub_values[i][j] < value);
-            if (replace) {
-                value = sub_values[i][j];
-                *src = mov_options.array[i].src;
-                *dest = mov_options.array[i].array[j];
+    return value;
+}
+
+
+/* Aspiration windows: each depth's score is usually close to the previous
+ * depth's, so the search starts with a window around it, which cuts off much
+ * more than an infinite one.  If the score falls outside, the window is
+ * widened on that side and the depth searched again; past
+ * ASPIRATION_LIMIT it's opened all the way. */
+#define ASPIRATION_WINDOW 5.0   // half a stone each way
+#define ASPIRATION_MIN_DEPTH 3
+#define ASPIRATION_LIMIT 80.0
+
+static double search_root(Search *search, Game_state *state, int depth, Color player,
+                          double previous, Move *best)
+{
+    if (search->plain || depth < ASPIRATION_MIN_DEPTH || fabs(previous) > WIN_SCORE / 2)
+        return alphabeta(search, state, depth - 1, 0, -INFINITY, INFINITY, player, best);
+
+    double delta = ASPIRATION_WINDOW;
+    double alpha = previous - delta, beta = previous + delta;
+    for (;;) {
+        double value = alphabeta(search, state, depth - 1, 0, alpha, beta, player, best);
+        if (atomic_load(&search->stop) || (value > alpha && value < beta))
+            return value;
+
+        delta *= 4;
+        if (value <= alpha)  alpha = delta > ASPIRATION_LIMIT ? -INFINITY : previous - delta;
+        if (value >= beta)   beta = delta > ASPIRATION_LIMIT ? INFINITY : previous + delta;
+    }
+}
+
+
+/* pv_from_tt puts the root movement 'index' and what the transposition
+ * table has as best after it into 'line', as far as 'depth' plies */
+static void pv_from_tt(Search *search, Game_state *state, int index, int depth,
+                       Pv_line *line)
+{
+    Game_state position;
+    game_copy(&position, state);
+    line->length = 0;
+    for (;;) {
+        Move_list moves;
+        generate_moves(&position, &moves);
+        if (index < 0 || index >= moves.length)
+            break;
+        line->moves[line->length++] = index;
+        game_apply_move(&position, &moves.array[index]);
+        if (line->length == depth || line->length == MAXPV || search->tt == NULL)
+            break;
+
+        Tt_entry entry;
+        index = probe(search->tt, &position, &entry) ? entry.move : -1;
+    }
+}
+
+char *pv_to_text(Game_state *state, Pv_line *line, char *text, size_t size)
+{
+    Game_state position;
+    game_copy(&position, state);
+    size_t used = 0;
+    if (size > 0)
+        text[0] = '\0';
+    for (int i = 0; i < line->length; i++) {
+        Move_list moves;
+        generate_moves(&position, &moves);
+        if (line->moves[i] >= moves.length)
+            break;
+        Move *move = &moves.array[line->moves[i]];
+        char step[MOVE_TEXT_LENGTH];
+        move_to_text(move, moves.type, step);
+        size_t length = strlen(step) + (i > 0);
+        if (used + length >= size)
+            break;
+        used += snprintf(text + used, size - used, "%s%s", i > 0 ? " " : "", step);
+        game_apply_move(&position, move);
+    }
+    return text;
+}
+
+
+/* search does an iterative-deepening search of the position for the current
+ * player: it searches 1 ply deep, then 2 plies, and so on until one of the
+ * limits in 'search' is reached, each time trying the best movement of the
+ * previous depth first (and, from ASPIRATION_MIN_DEPTH on, looking around its
+ * score first).  The result (in search->best, search->score and
+ * search->depth) is the one from the deepest search that got to finish, so a
+ * search that's stopped early still has a movement to make -- at worst the
+ * first legal one, if not even depth 1 was finished.
+ *
+ * Multi-PV: with search->multipv > 1, each depth is searched once per line,
+ * leaving out the root movements the lines before found, so the second
+ * search finds the second best movement with its exact score, and so on.
+ * They all share the transposition table, so each search after the first
+ * mostly goes over what the first one stored. */
+double search(Game_state *state, Search *search)
+{
+    Color player = state->current_player;
+
+    Move_list moves;
+    generate_moves(state, &moves);
+    if (moves.length == 0)
+        return -WIN_SCORE;
+
+    // A search resumed from an earlier one (see Search) goes on from the
+    // depth after its last, with its lines
+    int first_depth = atomic_load(&search->depth) + 1;
+    if (first_depth == 1)
+        search->best = moves.array[0];
+
+    int nlines = search->multipv;
+    if (nlines < 1)            nlines = 1;
+    if (nlines > MAXMULTIPV)   nlines = MAXMULTIPV;
+    if (nlines > moves.length) nlines = moves.length;
+
+    for (int depth = first_depth; depth <= search->max_depth; depth++) {
+        Pv_line lines[MAXMULTIPV];
+        memset(search->root_excluded, 0, sizeof(search->root_excluded));
+        search->nexcluded = 0;
+
+        int done = 0;
+        for (; done < nlines; done++) {
+            // Each line starts from where it was the depth before
+            Move best;
+            best.length = 0;
+            double previous = 0;
+            if (done == 0) {
+                best = search->best;
+                previous = atomic_load(&search->score);
+            } else if (done < search->nlines) {
+                best = moves.array[search->lines[done].moves[0]];
+                previous = search->lines[done].score;
             }
+            if (best.length > 0 && search->root_excluded[find_move(&moves, &best)])
+                best.length = 0;
+
+            double value = search_root(search, state, depth, player, previous, &best);
+            if (atomic_load(&search->stop))
+                break;
+
+            int index = find_move(&moves, &best);
+            lines[done].score = value;
+            pv_from_tt(search, state, index, depth, &lines[done]);
+            search->root_excluded[index] = true;
+            search->nexcluded++;
         }
+        search->nexcluded = 0;
+        if (done < nlines)
+            break;
+
+        search->best = moves.array[lines[0].moves[0]];
+        memcpy(search->lines, lines, nlines * sizeof(Pv_line));
+        search->nlines = nlines;
+        atomic_store(&search->score, lines[0].score);
+        atomic_store(&search->depth, depth);
+        if (search->on_depth != NULL)
+            search->on_depth(search, search->on_depth_data);
+
+        // Nothing to gain by looking further once the outcome is known (of
+        // every line)
+        bool known = true;
+        for (int j = 0; j < nlines; j++)
+            known = known && fabs(lines[j].score) > WIN_SCORE / 2;
+        if (known)
+            break;
     }
 
-    print_indentation(depth * 4);
-    printf("Best: (%d,%d) -> (%d,%d) (%g %s)\n",
-            src->col, src->row, dest->col, dest->row,
-            value, maximize ? "MAX-ing" : "MIN-ing");
-    // game_print(state, depth * 4);
-    putchar('\n');
-    putchar('\n');
+    return atomic_load(&search->score);
+}
 
-    return value;
+
+/* search_expected_reply guesses how the current player will answer, from
+ * the best movement the transposition table remembers for the position.
+ * Returns false if it has no idea. */
+bool search_expected_reply(Ttable *tt, Game_state *state, Move *reply)
+{
+    Tt_entry entry;
+    if (!probe(tt, state, &entry))
+        return false;
+
+    Move_list moves;
+    generate_moves(state, &moves);
+    if (entry.move >= moves.length)
+        return false;
+
+    *reply = moves.array[entry.move];
+    return true;
+}
+
+
+/* returns board state value; puts selected movement in best.  Searches
+ * 'depth' + 1 plies deep, without any limits. */
+double minimax(Game_state* state, int depth, Color maximizing_player, Move *best)
+{
+    Search search;
+    search_init(&search, 0, 0, NULL, NULL);
+    best->length = 0;
+    return alphabeta(&search, state, depth, 0, -INFINITY, INFINITY,
+                     maximizing_player, best);
 }
 
 
 double evaluate(Game_state* state, Color player)
 {
-    static double stone_value = 10;
-    static double dame_value = 25;
-    static double distance_bonus = 1;
-    static double white_origin = 0;
-    static double black_origin = 7;
+#ifdef NNUE
+    if (nnue_loaded) {
+        double value = nnue_evaluate(state);
+        return player == WHITE ? value : -value;
+    }
+#endif
+
+    static const double stone_value = 10;
+    static const double dame_value = 25;
+    static const double distance_bonus = 1;
+    static const double white_origin = 0;
+    static const double black_origin = BOARD_SIZE - 1;
 
     double value = 0;
 
     Position pos;
-    for (pos.row = 0; pos.row < 8; pos.row++) {
-        for (pos.col = 0; pos.col < 8; pos.col++) {
+    for (pos.row = 0; pos.row < BOARD_SIZE; pos.row++) {
+        for (pos.col = 0; pos.col < BOARD_SIZE; pos.col++) {
             Piece piece = get_piece(state, pos);
 
             if (!is_empty(piece))
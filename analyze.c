@@ -0,0 +1,278 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include "checkers.h"
+
+/* analyze goes back over the games in a game store (see store.c), searching
+ * every position again and flagging the blunders: movements that are worth
+ * much less than the best one the search finds.
+ *
+ * Usage: analyze DIR [options]
+ *   --game N         only the Nth game (counting from 1)
+ *   --depth N        search each position N plies deep (default 6)
+ *   --movetime MS    ... or for MS milliseconds
+ *   --threshold X    how much worse than the best movement a blunder is
+ *                    (default 15, a bit more than a stone)
+ *   --threads N      (default: one per core)
+ *   --hash MB        size of the transposition table the threads share
+ *
+ * The positions of all the games are put in one list, in order, and the
+ * threads take the next one whenever they finish one.  So at any time they're
+ * all looking at nearby positions of the same game, and whatever one of
+ * them stores in the shared transposition table comes in handy for the
+ * others (and for the next positions). */
+
+static int max_depth = 6;
+static long movetime_ms = 0;
+static double threshold = 15;
+static size_t hash_mb = 64;
+
+/* An Analysis is one position: a turn of a game, and what the search made of
+ * the movement played there.  Scores are from the point of view of the
+ * player who moved. */
+typedef struct {
+    int game;
+    int turn;
+    Move best;
+    double best_score;
+    double played_score;
+} Analysis;
+
+typedef struct {
+    Game_record *games;
+    int ngames;
+    Analysis *positions;
+    int npositions;
+    atomic_int next;       // the next position a thread may take
+    atomic_long nodes;
+    Ttable tt;
+} Analyzer;
+
+/* Each thread keeps the last position it looked at, and gets to the next one
+ * from there if it's further on in the same game. */
+typedef struct {
+    int game, turn;        // -1 when there's nothing yet
+    Game_state state;
+    History history;
+} Replay;
+
+static void replay_to(Analyzer *analyzer, Replay *replay, int game, int turn)
+{
+    if (replay->game != game || replay->turn > turn) {
+        replay->game = game;
+        replay->turn = 0;
+        game_setup(&replay->state);
+        history_init(&replay->history, DEFAULT_NO_PROGRESS_LIMIT);
+    }
+
+    Game_record *record = &analyzer->games[game];
+    for (; replay->turn < turn; replay->turn++) {
+        Move move;
+        record_move(record, replay->turn, &replay->state, &move);
+        history_push(&replay->history, &replay->state);
+        game_apply_move(&replay->state, &move);
+    }
+}
+
+/* analyze_position searches the position at the turn, and the one after the
+ * movement played there, to tell how the played movement compares with the
+ * best one. */
+static void analyze_position(Analyzer *analyzer, Search *searcher, Replay *replay,
+                             Analysis *analysis)
+{
+    replay_to(analyzer, replay, analysis->game, analysis->turn);
+    Game_state *state = &replay->state;
+
+    search_init(searcher, max_depth, movetime_ms, &analyzer->tt, &replay->history);
+    analysis->best_score = search(state, searcher);
+    analysis->best = searcher->best;
+    atomic_fetch_add(&analyzer->nodes, atomic_load(&searcher->nodes));
+
+    Move played;
+    record_move(&analyzer->games[analysis->game], analysis->turn, state, &played);
+    Move_list moves;
+    generate_moves(state, &moves);
+    if (find_move(&moves, &played) == find_move(&moves, &analysis->best)) {
+        analysis->played_score = analysis->best_score;
+        return;
+    }
+
+    // The played movement's score is the opponent's score after it, one ply
+    // shallower (the search itself doesn't see wins or draws at its root)
+    Game_state after;
+    game_copy(&after, state);
+    game_apply_move(&after, &played);
+    History history = replay->history;
+    history_push(&history, state);
+    update_draw_situation(&after, &history);
+
+    if (after.situation == TIE) {
+        analysis->played_score = DRAW_SCORE;
+    } else if (after.situation != ONGOING) {
+        analysis->played_score = WIN_SCORE - 1;
+    } else {
+        int depth = max_depth > 1 ? max_depth - 1 : 1;
+        search_init(searcher, depth, movetime_ms, &analyzer->tt, &history);
+        analysis->played_score = -search(&after, searcher);
+        atomic_fetch_add(&analyzer->nodes, atomic_load(&searcher->nodes));
+    }
+}
+
+static void *analyze_thread(void *arg)
+{
+    Analyzer *analyzer = arg;
+
+    // Search holds a whole History, so it's better off on the heap
+    Search *searcher = malloc(sizeof(Search));
+    Replay *replay = malloc(sizeof(Replay));
+    if (searcher == NULL || replay == NULL)
+        return NULL;
+    replay->game = -1;
+
+    int i;
+    while ((i = atomic_fetch_add(&analyzer->next, 1)) < analyzer->npositions)
+        analyze_position(analyzer, searcher, replay, &analyzer->positions[i]);
+
+    free(searcher);
+    free(replay);
+    return NULL;
+}
+
+static const char *result_name(Situation result)
+{
+    switch (result) {
+    case WHITE_WINS: return "white won";
+    case BLACK_WINS: return "black won";
+    case TIE:        return "tie";
+    default:         return "unfinished";
+    }
+}
+
+/* report prints the blunders of each game, replaying it to write the
+ * movements down. */
+static void report(Analyzer *analyzer, int first_game)
+{
+    Analysis *analysis = analyzer->positions;
+    int total = 0;
+    for (int game = 0; game < analyzer->ngames; game++) {
+        Game_record *record = &analyzer->games[game];
+        printf("game %d (%s, %d turns)\n", first_game + game + 1,
+               result_name(record->result), record->length);
+
+        Game_state state;
+        game_setup(&state);
+        int blunders = 0;
+        for (int turn = 0; turn < record->length; turn++, analysis++) {
+            Move played;
+            Move_list moves;
+            record_move(record, turn, &state, &played);
+            generate_moves(&state, &moves);
+
+            double loss = analysis->best_score - analysis->played_score;
+            if (loss >= threshold) {
+                char played_text[MOVE_TEXT_LENGTH], best_text[MOVE_TEXT_LENGTH];
+                printf("  turn %d, %s played %s (%.1f), best was %s (%.1f)\n", turn + 1,
+                       state.current_player == WHITE ? "white" : "black",
+                       move_to_text(&played, moves.type, played_text),
+                       analysis->played_score,
+                       move_to_text(&analysis->best, moves.type, best_text),
+                       analysis->best_score);
+                blunders++;
+            }
+            game_apply_move(&state, &played);
+        }
+        printf("  %d blunders\n", blunders);
+        total += blunders;
+    }
+    printf("%d games, %d positions, %d blunders\n",
+           analyzer->ngames, analyzer->npositions, total);
+}
+
+static void usage()
+{
+    fprintf(stderr, "usage: analyze DIR [--game N] [--depth N] [--movetime MS]"
+                    " [--threshold X] [--threads N] [--hash MB]\n");
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+        usage();
+
+    int only_game = 0;
+    int threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    for (int i = 2; i < argc; i++) {
+        if      (strcmp("--game", argv[i]) == 0 && i+1 < argc)       only_game = atoi(argv[++i]);
+        else if (strcmp("--depth", argv[i]) == 0 && i+1 < argc)      max_depth = atoi(argv[++i]);
+        else if (strcmp("--movetime", argv[i]) == 0 && i+1 < argc)   movetime_ms = atol(argv[++i]);
+        else if (strcmp("--threshold", argv[i]) == 0 && i+1 < argc)  threshold = atof(argv[++i]);
+        else if (strcmp("--threads", argv[i]) == 0 && i+1 < argc)    threads = atoi(argv[++i]);
+        else if (strcmp("--hash", argv[i]) == 0 && i+1 < argc)       hash_mb = atol(argv[++i]);
+        else usage();
+    }
+    if (threads < 1)
+        threads = 1;
+
+    Game_store store;
+    if (!store_open(&store, argv[1], STORE_DEFAULT_ENTRIES)) {
+        perror(argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    // Load the games, and make the list of positions out of them
+    static Analyzer analyzer;
+    int capacity = 0, skipped = 0;
+    long offset = 0;
+    Game_record record;
+    while ((offset = store_read(&store, offset, &record)) > 0) {
+        if (only_game > 0 && ++skipped != only_game)
+            continue;
+        if (analyzer.ngames == capacity) {
+            capacity = capacity > 0 ? capacity * 2 : 64;
+            analyzer.games = realloc(analyzer.games, capacity * sizeof(Game_record));
+            if (analyzer.games == NULL) {
+                fprintf(stderr, "out of memory\n");
+                return EXIT_FAILURE;
+            }
+        }
+        analyzer.games[analyzer.ngames++] = record;
+        analyzer.npositions += record.length;
+        if (only_game > 0)
+            break;
+    }
+    store_close(&store);
+
+    analyzer.positions = malloc((analyzer.npositions + 1) * sizeof(Analysis));
+    if (analyzer.positions == NULL || !tt_init(&analyzer.tt, hash_mb)) {
+        fprintf(stderr, "out of memory\n");
+        return EXIT_FAILURE;
+    }
+    int i = 0;
+    for (int game = 0; game < analyzer.ngames; game++)
+        for (int turn = 0; turn < analyzer.games[game].length; turn++, i++) {
+            analyzer.positions[i].game = game;
+            analyzer.positions[i].turn = turn;
+        }
+
+    long start = now_ms();
+    pthread_t *pool = malloc(threads * sizeof(pthread_t));
+    int started = 0;
+    for (; pool != NULL && started < threads; started++)
+        if (pthread_create(&pool[started], NULL, analyze_thread, &analyzer) != 0)
+            break;
+    if (started == 0)
+        analyze_thread(&analyzer);  // no threads: do it all right here
+    for (int t = 0; t < started; t++)
+        pthread_join(pool[t], NULL);
+    long elapsed = now_ms() - start;
+
+    report(&analyzer, only_game > 0 ? only_game - 1 : 0);
+    fprintf(stderr, "%ld nodes in %.1f s with %d threads\n",
+            atomic_load(&analyzer.nodes), elapsed / 1000.0, started > 0 ? started : 1);
+
+    tt_free(&analyzer.tt);
+    return 0;
+}
@@ -0,0 +1,199 @@
+#include <string.h>
+#include "checkers.h"
+
+/* Moving a piece one square along a diagonal is a shift of its dark square's
+ * bit: on the rows with a dark square in column 0 (the even ones) the square
+ * up and to the left is BOARD_SIZE/2 - 1 squares further, the one up and to
+ * the right BOARD_SIZE/2; on the odd rows they're BOARD_SIZE/2 and
+ * BOARD_SIZE/2 + 1.  Squares on the edge the direction goes off of are left
+ * out before shifting (so they don't wrap around to the other side), and
+ * anything shifted past the last row is cut off after. */
+#if BOARD_SIZE == 8
+#define ROWS_EVEN  ((Square_mask) 0x0F0F0F0F)
+#define LEFT_EDGE  ((Square_mask) 0x01010101)
+#define RIGHT_EDGE ((Square_mask) 0x80808080)
+#elif BOARD_SIZE == 10
+#define ROWS_EVEN  ((Square_mask) 0x1F07C1F07C1F)
+#define LEFT_EDGE  ((Square_mask) 0x010040100401)
+#define RIGHT_EDGE ((Square_mask) 0x2008020080200)
+#else
+#error "batch.c only knows the masks of 8x8 and 10x10 boards"
+#endif
+
+#define ALL_SQUARES ((Square_mask) -1 >> (sizeof(Square_mask) * 8 - DARK_SQUARES))
+#define ROWS_ODD    (ALL_SQUARES & ~ROWS_EVEN)
+#define ROW_SQUARES (BOARD_SIZE / 2)
+
+/* A Direction shifts left (up) or right (down), the other one being 0, so
+ * that the same code does all of them without branching */
+typedef struct {
+    Square_mask even_from, odd_from;  // the squares that have a neighbor that way
+    int even_left, even_right, odd_left, odd_right;
+} Direction;
+
+/* In the order of generate_dest_options; directions[3 - d] is the opposite
+ * of directions[d]. */
+static const Direction directions[4] = {
+    { ROWS_EVEN & ~LEFT_EDGE, ROWS_ODD, 0, ROW_SQUARES + 1, 0, ROW_SQUARES },  // down left
+    { ROWS_EVEN, ROWS_ODD & ~RIGHT_EDGE, 0, ROW_SQUARES, 0, ROW_SQUARES - 1 },  // down right
+    { ROWS_EVEN & ~LEFT_EDGE, ROWS_ODD, ROW_SQUARES - 1, 0, ROW_SQUARES, 0 },  // up left
+    { ROWS_EVEN, ROWS_ODD & ~RIGHT_EDGE, ROW_SQUARES, 0, ROW_SQUARES + 1, 0 },  // up right
+};
+#define GOES_UP(d) ((d) >= 2)
+
+static inline Square_mask shift(Square_mask squares, const Direction *dir)
+{
+    Square_mask even = squares & dir->even_from, odd = squares & dir->odd_from;
+    return (even << dir->even_left >> dir->even_right
+            | odd << dir->odd_left >> dir->odd_right) & ALL_SQUARES;
+}
+
+static inline int lowest_square(Square_mask squares)
+{
+    return __builtin_ctzll(squares);
+}
+
+
+void batch_clear(Batch *batch)
+{
+    memset(batch, 0, sizeof(*batch));
+}
+
+bool batch_add(Batch *batch, Game_state *state)
+{
+    if (batch->length == BATCH_SIZE)
+        return false;
+
+    Packed_position packed;
+    pack_position(state, 0, ONGOING, &packed);
+    int i = batch->length++;
+    batch->white[i] = packed.white;
+    batch->black[i] = packed.occupied & ~packed.white;
+    batch->dames[i] = packed.dames;
+    batch->black_moves[i] = state->current_player == BLACK ? ALL_SQUARES : 0;
+    return true;
+}
+
+
+/* push_step adds a step to a position's list; there's always room for what
+ * a legal position has, the check is for boards made up with more pieces */
+static inline void push_step(uint16_t *steps, int *length, int from, int to)
+{
+    if (*length < BATCH_MAXSTEPS)
+        steps[(*length)++] = from | to << 8;
+}
+
+/* push_dame_steps walks a dame's diagonals square by square, like
+ * generate_dest_options: past empty squares it can stop anywhere, past the
+ * opponent's pieces only capturing, and its own pieces stop it (as does a
+ * second piece of the opponent's, with RULE_TURKISH_STRIKE). */
+static void push_dame_steps(Batch *batch, int i, int from, bool captures,
+                            uint16_t *steps, int *length)
+{
+    Square_mask black = batch->black_moves[i];
+    Square_mask own = (batch->white[i] & ~black) | (batch->black[i] & black);
+    Square_mask opponent = (batch->black[i] & ~black) | (batch->white[i] & black);
+
+    for (int d = 0; d < 4; d++) {
+        Square_mask square = (Square_mask) 1 << from;
+        bool over_opponent = false;
+        for (int distance = 1; distance <= DAME_RANGE; distance++) {
+            square = shift(square, &directions[d]);
+            if (square == 0 || (square & own))
+                break;
+            if (square & opponent) {
+#if RULE_TURKISH_STRIKE
+                if (over_opponent)
+                    break;  // one piece per jump
+#endif
+                over_opponent = true;
+            }
+            else if (over_opponent == captures)
+                push_step(steps, length, from, lowest_square(square));
+        }
+    }
+}
+
+void generate_batch(Batch *batch, Batch_steps *out)
+{
+    /* First for all the positions at once (the loops over i are the ones
+     * meant to be vectorized, so they're kept free of branches): which
+     * stones can step or jump in each direction, and whether anything can
+     * capture at all. */
+    Square_mask own[BATCH_SIZE], opponent[BATCH_SIZE], empty[BATCH_SIZE];
+    Square_mask stones[BATCH_SIZE], dames[BATCH_SIZE], capturing[BATCH_SIZE];
+    Square_mask steppers[4][BATCH_SIZE], jumpers[4][BATCH_SIZE];
+
+    for (int i = 0; i < BATCH_SIZE; i++) {
+        Square_mask black = batch->black_moves[i];
+        own[i] = (batch->white[i] & ~black) | (batch->black[i] & black);
+        opponent[i] = (batch->black[i] & ~black) | (batch->white[i] & black);
+        empty[i] = ALL_SQUARES & ~(batch->white[i] | batch->black[i]);
+        stones[i] = own[i] & ~batch->dames[i];
+        dames[i] = own[i] & batch->dames[i];
+        capturing[i] = 0;
+    }
+
+    for (int d = 0; d < 4; d++) {
+        const Direction *dir = &directions[d], *back = &directions[3 - d];
+
+        // White stones go up, black ones down
+        Square_mask up = GOES_UP(d) ? ALL_SQUARES : 0;
+        for (int i = 0; i < BATCH_SIZE; i++) {
+            Square_mask forward = up ^ batch->black_moves[i];
+            steppers[d][i] = stones[i] & forward & shift(empty[i], back);
+#if RULE_BACKWARD_CAPTURE
+            forward = ALL_SQUARES;
+#endif
+            jumpers[d][i] = stones[i] & forward & shift(opponent[i] & shift(empty[i], back), back);
+            capturing[i] |= jumpers[d][i];
+        }
+
+        /* Dames, spreading one square at a time: 'clear' is where they get
+         * to over empty squares, 'over' where they get to having gone over
+         * some of the opponent's pieces; an empty square in 'over' is a
+         * capture. */
+        Square_mask clear[BATCH_SIZE], over[BATCH_SIZE];
+        for (int i = 0; i < BATCH_SIZE; i++) {
+            clear[i] = dames[i];
+            over[i] = 0;
+        }
+        for (int distance = 1; distance <= DAME_RANGE && distance < BOARD_SIZE; distance++) {
+            for (int i = 0; i < BATCH_SIZE; i++) {
+                Square_mask from_clear = shift(clear[i], dir);
+                Square_mask from_over = shift(over[i], dir);
+#if RULE_TURKISH_STRIKE
+                // One piece per jump: past it, only empty squares
+                over[i] = (from_clear & opponent[i]) | (from_over & empty[i]);
+#else
+                over[i] = (from_clear & opponent[i]) | (from_over & (opponent[i] | empty[i]));
+#endif
+                clear[i] = from_clear & empty[i];
+                capturing[i] |= over[i] & empty[i];
+            }
+        }
+    }
+
+    // Then position by position, writing the steps out
+    for (int i = 0; i < batch->length; i++) {
+        bool captures = capturing[i] != 0;
+        uint16_t *steps = out->steps[i];
+        int length = 0;
+
+        for (int d = 0; d < 4; d++) {
+            const Direction *dir = &directions[d];
+            Square_mask movers = captures ? jumpers[d][i] : steppers[d][i];
+            for (; movers != 0; movers &= movers - 1) {
+                Square_mask to = shift(movers & -movers, dir);
+                if (captures)
+                    to = shift(to, dir);
+                push_step(steps, &length, lowest_square(movers), lowest_square(to));
+            }
+        }
+        for (Square_mask movers = dames[i]; movers != 0; movers &= movers - 1)
+            push_dame_steps(batch, i, lowest_square(movers), captures, steps, &length);
+
+        out->length[i] = length;
+        out->type[i] = captures ? CAPTURE : REGULAR;
+    }
+}
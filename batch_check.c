@@ -0,0 +1,219 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "checkers.h"
+
+/* batch_check compares the batched movement generation (batch.c) with
+ * generate_mov_options on many positions, and then times both.
+ *
+ * Usage: batch_check [--positions N] [--rounds N] [--seed N]
+ *   --positions N  positions to check (default 100000): half of them from
+ *                  games played at random, half with random pieces
+ *                  scattered over the board, which have many more dames
+ *                  than games reach
+ *   --rounds N     how many times each generator goes over them all for the
+ *                  timing (default 20)
+ *   --seed N       for the random numbers (default 1)
+ *
+ * Any position where the two differ is printed, with what each gave.
+ * Returns failure if there was one. */
+
+static long npositions = 100000;
+static int rounds = 20;
+static uint64_t seed = 1;
+
+#define MAXPLIES 200
+#define MAXREPORTS 10
+
+// What the timed loops add their results to, so they can't be left out
+static volatile long sink;
+
+/* random_game adds the positions of a game of random movements to
+ * 'positions' (up to 'room' of them); returns how many */
+static long random_game(Game_state *positions, long room)
+{
+    Game_state state;
+    game_setup(&state);
+    long count = 0;
+    for (int ply = 0; ply < MAXPLIES && count < room && state.situation == ONGOING; ply++) {
+        positions[count++] = state;
+        Move_list moves;
+        generate_moves(&state, &moves);
+        if (moves.length == 0)
+            break;
+        game_apply_move(&state, &moves.array[next_random(&seed) % moves.length]);
+    }
+    return count;
+}
+
+/* scattered_position puts up to NUMPIECES pieces of each color on random
+ * dark squares, a third of them dames (stones never on the row they'd
+ * promote on) */
+static void scattered_position(Game_state *state)
+{
+    Position p;
+    for (p.row = 0; p.row < BOARD_SIZE; p.row++)
+        for (p.col = 0; p.col < BOARD_SIZE; p.col++)
+            state->board[p.row][p.col] = EMPTY;
+
+    for (int color = 0; color < 2; color++) {
+        int pieces = 1 + next_random(&seed) % NUMPIECES;
+        for (int n = 0; n < pieces; n++) {
+            Position pos = dark_square_position(next_random(&seed) % DARK_SQUARES);
+            if (!is_empty(get_piece(state, pos)))
+                continue;
+            bool dame = next_random(&seed) % 3 == 0;
+            int last_row = color == 0 ? BOARD_SIZE - 1 : 0;
+            if (pos.row == last_row)
+                dame = true;
+            Piece piece = color == 0 ? (dame ? WHITE_DAME : WHITE_STONE)
+                                     : (dame ? BLACK_DAME : BLACK_STONE);
+            state->board[pos.row][pos.col] = piece;
+        }
+    }
+    state->current_player = next_random(&seed) % 2 ? BLACK : WHITE;
+    state->reversible_moves = 0;
+    game_rehash(state);
+    update_situation(state);
+}
+
+static int compare_steps(const void *a, const void *b)
+{
+    return *(const uint16_t *) a - *(const uint16_t *) b;
+}
+
+/* scalar_steps packs generate_mov_options' options like generate_batch's
+ * steps; returns how many */
+static int scalar_steps(Game_state *state, uint16_t *steps, Movtype *type)
+{
+    Mov_options options;
+    generate_mov_options(state, &options);
+    int length = 0;
+    for (int i = 0; i < options.length; i++) {
+        Dest_options *dest = &options.array[i];
+        for (int j = 0; j < dest->length; j++)
+            steps[length++] = dark_square(dest->src) | dark_square(dest->array[j]) << 8;
+    }
+    *type = options.type;
+    return length;
+}
+
+static void print_steps(const char *name, uint16_t *steps, int length, Movtype type)
+{
+    printf("  %-7s %s:", name, type == CAPTURE ? "captures" : "regular");
+    for (int i = 0; i < length; i++) {
+        Position from = dark_square_position(BATCH_STEP_FROM(steps[i]));
+        Position to = dark_square_position(BATCH_STEP_TO(steps[i]));
+        printf(" %c%d-%c%d", 'a' + from.col, from.row + 1, 'a' + to.col, to.row + 1);
+    }
+    printf("\n");
+}
+
+/* check compares the generators on one position; returns whether they agree */
+static bool check(Game_state *state, Batch_steps *out, int i)
+{
+    uint16_t expected[NUMPIECES * MAXOPTIONS], got[BATCH_MAXSTEPS];
+    Movtype expected_type;
+    int nexpected = scalar_steps(state, expected, &expected_type);
+    int ngot = out->length[i];
+    memcpy(got, out->steps[i], ngot * sizeof(got[0]));
+    qsort(expected, nexpected, sizeof(expected[0]), compare_steps);
+    qsort(got, ngot, sizeof(got[0]), compare_steps);
+
+    if (out->type[i] == expected_type && ngot == nexpected
+        && memcmp(expected, got, ngot * sizeof(got[0])) == 0)
+        return true;
+
+    static int reports = 0;
+    if (reports++ < MAXREPORTS) {
+        char text[POSITION_TEXT_LENGTH];
+        printf("differ on %s\n", game_to_text(state, text));
+        print_steps("scalar", expected, nexpected, expected_type);
+        print_steps("batch", got, ngot, out->type[i]);
+    }
+    return false;
+}
+
+static void usage()
+{
+    fprintf(stderr, "usage: batch_check [--positions N] [--rounds N] [--seed N]\n");
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++) {
+        if      (strcmp("--positions", argv[i]) == 0 && i+1 < argc)  npositions = atol(argv[++i]);
+        else if (strcmp("--rounds", argv[i]) == 0 && i+1 < argc)     rounds = atoi(argv[++i]);
+        else if (strcmp("--seed", argv[i]) == 0 && i+1 < argc)       seed = strtoull(argv[++i], NULL, 10);
+        else usage();
+    }
+    if (npositions <= 0 || rounds <= 0 || seed == 0)
+        usage();
+
+    Game_state *positions = malloc(npositions * sizeof(Game_state));
+    Batch_steps *out = malloc(sizeof(Batch_steps));
+    if (positions == NULL || out == NULL) {
+        fprintf(stderr, "batch_check: out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    long count = 0;
+    while (count < npositions / 2)
+        count += random_game(positions + count, npositions / 2 - count);
+    for (; count < npositions; count++)
+        scattered_position(&positions[count]);
+
+    // The batches are made once, so the timing is of the generation alone
+    long nbatches = (count + BATCH_SIZE - 1) / BATCH_SIZE;
+    Batch *batches = malloc(nbatches * sizeof(Batch));
+    if (batches == NULL) {
+        fprintf(stderr, "batch_check: out of memory\n");
+        return EXIT_FAILURE;
+    }
+    for (long b = 0; b < nbatches; b++) {
+        batch_clear(&batches[b]);
+        for (long i = b * BATCH_SIZE; i < count && batch_add(&batches[b], &positions[i]); i++)
+            ;
+    }
+
+    long failures = 0, steps = 0, captures = 0;
+    for (long b = 0; b < nbatches; b++) {
+        generate_batch(&batches[b], out);
+        for (int i = 0; i < batches[b].length; i++) {
+            failures += !check(&positions[b * BATCH_SIZE + i], out, i);
+            steps += out->length[i];
+            captures += out->type[i] == CAPTURE && out->length[i] > 0;
+        }
+    }
+    printf("%ld positions (%ld with captures), %ld steps, %ld differ\n",
+           count, captures, steps, failures);
+
+    long start = now_ms();
+    for (int round = 0; round < rounds; round++) {
+        for (long i = 0; i < count; i++) {
+            Mov_options options;
+            generate_mov_options(&positions[i], &options);
+            sink += options.length;
+        }
+    }
+    long scalar_ms = now_ms() - start;
+
+    start = now_ms();
+    for (int round = 0; round < rounds; round++) {
+        for (long b = 0; b < nbatches; b++) {
+            generate_batch(&batches[b], out);
+            sink += out->length[0];
+        }
+    }
+    long batch_ms = now_ms() - start;
+
+    double generated = (double) count * rounds;
+    printf("generate_mov_options %8.0f positions/s\n", generated / (scalar_ms > 0 ? scalar_ms : 1) * 1000);
+    printf("generate_batch       %8.0f positions/s\n", generated / (batch_ms > 0 ? batch_ms : 1) * 1000);
+
+    free(batches);
+    free(out);
+    free(positions);
+    return failures == 0 ? 0 : EXIT_FAILURE;
+}
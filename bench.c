@@ -0,0 +1,268 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "checkers.h"
+
+/* bench measures the engine part by part on fixed work, the same on every
+ * run, so that builds before and after a change can be compared:
+ *   perft     every movement sequence from the starting position, N plies
+ *             deep (generate_moves and game_apply_move alone)
+ *   search    a search of each position in FILE, N plies deep
+ * and then, one at a time, over the same positions from games of random
+ * movements: the movement generation (generate_moves), the evaluation
+ * (evaluate) and the transposition table's probes (tt_probe, half of them
+ * for positions stored in it).  Each gets its calls (or nodes) per second
+ * and, where the processor's counters can be read (see counters.c), its
+ * cycles, instructions, branch misses and cache misses per call -- which
+ * tell whether a change to generate_dest_options or evaluate really saved
+ * cache misses or just moved them somewhere else.  The phases are timed
+ * apart, outside the search, so that measuring doesn't change what's
+ * measured.
+ *
+ * Usage: bench [options] [FILE]
+ *   --perft N      how deep perft goes (default 8, 0 to skip it)
+ *   --depth N      how deep the searches go (default 8, 0 to skip them)
+ *   --positions N  positions for the phases (default 100000)
+ *   --rounds N     how many times each phase goes over them (default 10)
+ *   --hash MB      transposition table size (default 64)
+ *   --no-counters  only times
+ * FILE has a position per line, in tactics.txt's format (anything after a
+ * ';' is ignored); the default is tactics.txt.
+ */
+
+static int perft_depth = 8;
+static int depth = 8;
+static long npositions = 100000;
+static int rounds = 10;
+static size_t hash_mb = 64;
+static bool use_counters = true;
+static const char *file = "tactics.txt";
+
+#define MAXPLIES 200
+#define MAXSUITE 1000
+
+// What the timed loops add their results to, so they can't be left out
+static volatile double sink;
+
+static Counters counters;
+
+
+// {{{ Reporting
+static void print_header()
+{
+    printf("%-10s %12s %8s %10s", "phase", "count", "ms", "per s");
+    if (counters.available)
+        for (int c = 0; c < NCOUNTERS; c++)
+            printf(" %9s", counter_names[c]);
+    printf("\n");
+}
+
+/* report prints a phase's line: how many calls (or nodes) it made, how long
+ * it took, and its counters per call */
+static void report(const char *phase, long count, long ms, Counter_values *values)
+{
+    printf("%-10s %12ld %8ld %10.0f", phase, count, ms,
+           (double) count / (ms > 0 ? ms : 1) * 1000);
+    if (counters.available) {
+        for (int c = 0; c < NCOUNTERS; c++) {
+            if (values->valid[c])
+                printf(" %9.2f", (double) values->value[c] / (count > 0 ? count : 1));
+            else
+                printf(" %9s", "-");
+        }
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+static long phase_start;
+
+static void start_phase()
+{
+    phase_start = now_ms();
+    counters_start(&counters);
+}
+
+static void end_phase(const char *phase, long count)
+{
+    Counter_values values;
+    counters_stop(&counters, &values);
+    report(phase, count, now_ms() - phase_start, &values);
+}
+// }}}
+
+
+static long perft(Game_state *state, int depth)
+{
+    Move_list moves;
+    generate_moves(state, &moves);
+    if (depth == 1)
+        return moves.length;
+
+    long leaves = 0;
+    for (int i = 0; i < moves.length; i++) {
+        Game_state next = *state;
+        game_apply_move(&next, &moves.array[i]);
+        leaves += perft(&next, depth - 1);
+    }
+    return leaves;
+}
+
+/* read_positions reads FILE's positions into 'suite'; returns how many, or
+ * -1 if the file can't be read or has something that's not a position */
+static int read_positions(Game_state *suite)
+{
+    FILE *in = fopen(file, "r");
+    if (in == NULL) {
+        perror(file);
+        return -1;
+    }
+
+    char line[512];
+    int count = 0, number = 0;
+    while (count < MAXSUITE && fgets(line, sizeof(line), in) != NULL) {
+        number++;
+        line[strcspn(line, ";\n")] = '\0';
+        char *text = line + strspn(line, " \t");
+        if (*text == '\0' || *text == '#')
+            continue;
+        if (!game_from_text(&suite[count], text)) {
+            fprintf(stderr, "%s:%d: not a position\n", file, number);
+            fclose(in);
+            return -1;
+        }
+        count++;
+    }
+    fclose(in);
+    return count;
+}
+
+/* random_positions fills 'positions' with the positions of games of random
+ * movements, always the same ones */
+static void random_positions(Game_state *positions, long count)
+{
+    uint64_t seed = 1;
+    long n = 0;
+    while (n < count) {
+        Game_state state;
+        game_setup(&state);
+        for (int ply = 0; ply < MAXPLIES && n < count && state.situation == ONGOING; ply++) {
+            positions[n++] = state;
+            Move_list moves;
+            generate_moves(&state, &moves);
+            if (moves.length == 0)
+                break;
+            game_apply_move(&state, &moves.array[next_random(&seed) % moves.length]);
+        }
+    }
+}
+
+static void usage()
+{
+    fprintf(stderr, "usage: bench [--perft N] [--depth N] [--positions N] [--rounds N]"
+                    " [--hash MB] [--no-counters] [FILE]\n");
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++) {
+        if      (strcmp("--perft", argv[i]) == 0 && i+1 < argc)      perft_depth = atoi(argv[++i]);
+        else if (strcmp("--depth", argv[i]) == 0 && i+1 < argc)      depth = atoi(argv[++i]);
+        else if (strcmp("--positions", argv[i]) == 0 && i+1 < argc)  npositions = atol(argv[++i]);
+        else if (strcmp("--rounds", argv[i]) == 0 && i+1 < argc)     rounds = atoi(argv[++i]);
+        else if (strcmp("--hash", argv[i]) == 0 && i+1 < argc)       hash_mb = atol(argv[++i]);
+        else if (strcmp("--no-counters", argv[i]) == 0)              use_counters = false;
+        else if (argv[i][0] != '-')                                  file = argv[i];
+        else usage();
+    }
+    if (perft_depth < 0 || depth < 0 || npositions <= 0 || rounds <= 0 || hash_mb == 0)
+        usage();
+
+    Ttable tt;
+    Game_state *suite = malloc(MAXSUITE * sizeof(Game_state));
+    Game_state *positions = malloc(npositions * sizeof(Game_state));
+    Search *searcher = malloc(sizeof(Search));
+    if (suite == NULL || positions == NULL || searcher == NULL || !tt_init(&tt, hash_mb)) {
+        fprintf(stderr, "bench: out of memory\n");
+        return EXIT_FAILURE;
+    }
+    int nsuite = depth > 0 ? read_positions(suite) : 0;
+    if (nsuite < 0)
+        return EXIT_FAILURE;
+    random_positions(positions, npositions);
+
+    for (int c = 0; c < NCOUNTERS; c++)
+        counters.fds[c] = -1;
+    if (use_counters && !counters_open(&counters))
+        printf("no hardware counters (%s), only times\n", counters.error);
+    print_header();
+
+    if (perft_depth > 0) {
+        Game_state state;
+        game_setup(&state);
+        start_phase();
+        long leaves = perft(&state, perft_depth);
+        end_phase("perft", leaves);
+    }
+
+    // Every search starts from an empty table, as in a new game
+    if (nsuite > 0) {
+        long nodes = 0, ms = 0;
+        Counter_values total = { { 0 }, { false } };
+        for (int i = 0; i < nsuite; i++) {
+            tt_clear(&tt);
+            search_init(searcher, depth, 0, &tt, NULL);
+            long start = now_ms();
+            counters_start(&counters);
+            search(&suite[i], searcher);
+            Counter_values values;
+            counters_stop(&counters, &values);
+            ms += now_ms() - start;
+            nodes += atomic_load(&searcher->nodes);
+            for (int c = 0; c < NCOUNTERS; c++) {
+                total.value[c] += values.value[c];
+                total.valid[c] = values.valid[c];
+            }
+        }
+        report("search", nodes, ms, &total);
+    }
+
+    long calls = npositions * rounds;
+    start_phase();
+    for (int round = 0; round < rounds; round++) {
+        for (long i = 0; i < npositions; i++) {
+            Move_list moves;
+            generate_moves(&positions[i], &moves);
+            sink += moves.length;
+        }
+    }
+    end_phase("movegen", calls);
+
+    start_phase();
+    for (int round = 0; round < rounds; round++)
+        for (long i = 0; i < npositions; i++)
+            sink += evaluate(&positions[i], WHITE);
+    end_phase("evaluate", calls);
+
+    tt_clear(&tt);
+    for (long i = 0; i < npositions; i += 2) {
+        Tt_entry entry = { .score = 0, .depth = 1, .bound = TT_EXACT, .move = TT_NO_MOVE };
+        tt_store(&tt, positions[i].hash, &entry);
+    }
+    start_phase();
+    for (int round = 0; round < rounds; round++) {
+        for (long i = 0; i < npositions; i++) {
+            Tt_entry entry;
+            sink += tt_probe(&tt, positions[i].hash, &entry);
+        }
+    }
+    end_phase("tt probe", calls);
+
+    counters_close(&counters);
+    tt_free(&tt);
+    free(searcher);
+    free(positions);
+    free(suite);
+    return 0;
+}
@@ -1 +1 @@
-cl test.c ai.c movement.c game_state.c util.c language.c
+cl test.c ai.c tt.c trace.c movement.c game_state.c util.c language.c
@@ -1,2 +1,62 @@
 #!/bin/sh
-gcc -o checkers checkers.c interface.c movement.c game_state.c util.c language.c checkers.h -lncurses
+gcc -pthread -o checkers checkers.c interface.c engine.c ai.c tt.c mcts.c store.c movement.c game_state.c util.c language.c checkers.h -lncurses -lm
+# The same game for 10x10 (international) draughts
+gcc -pthread -DBOARD_SIZE=10 -o checkers10 checkers.c interface.c engine.c ai.c tt.c mcts.c store.c movement.c game_state.c util.c language.c -lncurses -lm
+# Other rules are chosen the same way, e.g. for Russian checkers add
+#   -DVARIANT=VARIANT_RUSSIAN
+# (see "Rule variants" in checkers.h for the others)
+gcc -o trace_dump trace_dump.c util.c
+# Looks positions up in the games recorded with --record
+gcc -o game_stats game_stats.c store.c movement.c game_state.c util.c
+# ... and goes over them again, looking for blunders
+gcc -pthread -o analyze analyze.c store.c ai.c tt.c movement.c game_state.c util.c -lm
+# With the neural evaluation (add -mavx2 for the AVX2 version of it), and
+# the program that trains its weights
+gcc -pthread -O2 -DNNUE -o checkers-nnue checkers.c interface.c engine.c ai.c tt.c mcts.c nnue.c store.c movement.c game_state.c util.c language.c -lncurses -lm
+gcc -O2 -DNNUE -o nnue_train nnue_train.c nnue.c ai.c tt.c movement.c game_state.c util.c -lm
+# Writes self-play positions as packed training data
+gcc -pthread -O2 -o datagen datagen.c monitor.c training.c ai.c tt.c movement.c game_state.c util.c -lm
+# ... and shows its games live (datagen --monitor FILE, then dashboard FILE)
+gcc -pthread -O2 -o dashboard dashboard.c monitor.c interface.c engine.c ai.c tt.c mcts.c movement.c game_state.c util.c language.c -lncurses -lm
+# Checks the batched movement generation against the regular one and times
+# both (-O3 so its loops get vectorized; add -mavx2 for wider vectors)
+gcc -O3 -o batch_check batch_check.c batch.c training.c movement.c game_state.c util.c -lm
+# Checks every movement generator against generate_mov_options on random
+# games, on all cores, shrinking whatever position one gets wrong
+gcc -pthread -O2 -o movegen_check movegen_check.c batch.c training.c movement.c game_state.c util.c -lm
+# Times perft, the search and each part of it, with the hardware counters
+gcc -pthread -O2 -o bench bench.c counters.c ai.c tt.c movement.c game_state.c util.c -lm
+# Shows the best few movements of a position, deeper and deeper
+gcc -pthread -o multipv multipv.c ai.c tt.c movement.c game_state.c util.c -lm
+# Splits the opening into work units for many processes to search
+gcc -pthread -O2 -o opening opening.c ai.c tt.c movement.c game_state.c util.c -lm
+# Proves positions won or lost with proof-number search
+gcc -pthread -O2 -o solve solve.c pns.c ai.c tt.c movement.c game_state.c util.c -lm
+# Runs the search on the positions of tactics.txt
+gcc -pthread -o tactics tactics.c ai.c tt.c movement.c game_state.c util.c -lm
+# Plays the alpha-beta search against Monte Carlo tree search
+gcc -pthread -o match match.c mcts.c ai.c tt.c movement.c game_state.c util.c -lm
+# The server hosting many games over a socket (no interface, so no ncurses)
+gcc -pthread -o checkers-server server.c ai.c tt.c movement.c game_state.c util.c -lm
+# ... and what checks its replies (run it after building the server)
+gcc -o server_check server_check.c
+# The engine alone, as a static and a shared library (see libcheckers.h).
+# It's built for each board size, each build linked into one object with
+# all but its checkers_board_N made local (so the two don't clash), and
+# then those with the API into one more, in which all but the checkers_ API
+# is made local (so the static library doesn't clash with a program's own
+# names either)
+for size in 8 10; do
+    gcc -pthread -fPIC -fvisibility=hidden -DBOARD_SIZE=$size -c libcheckers.c ai.c tt.c mcts.c movement.c game_state.c util.c
+    ld -r -o libcheckers-$size.o libcheckers.o ai.o tt.o mcts.o movement.o game_state.o util.o
+    objcopy --keep-global-symbol=checkers_board_$size libcheckers-$size.o
+done
+gcc -pthread -fPIC -fvisibility=hidden -c libcheckers_api.c
+ld -r -o libcheckers-engine.o libcheckers_api.o libcheckers-8.o libcheckers-10.o
+objcopy --localize-hidden libcheckers-engine.o
+ar rcs libcheckers.a libcheckers-engine.o
+gcc -shared -pthread -o libcheckers.so libcheckers-engine.o -lm
+rm -f libcheckers-engine.o libcheckers-8.o libcheckers-10.o libcheckers_api.o libcheckers.o ai.o tt.o mcts.o movement.o game_state.o util.o
+# To trace the search, build the test program with tracing compiled in:
+#   gcc -DTRACE_SEARCH -o test test.c ai.c tt.c trace.c movement.c game_state.c util.c language.c -lm
+# then render its search.trace with ./trace_dump search.trace
@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <ncurses.h>
 #include "checkers.h"
@@ -9,17 +10,32 @@
 // Language used in printing the messages
 Language language = EN;
 
+// Which players the engine plays for (indexed by Color), and its limits
+bool engine_plays[2] = { false, false };
+int engine_depth = 0;          // no limit
+long engine_movetime = 3000;   // milliseconds
+size_t engine_hash = 16;       // megabytes of transposition table
+bool engine_pondering = false;
+int engine_mcts_threads = 0;   // 0: alpha-beta
+
+// Turns without captures or stone movements after which the game is a tie
+int draw_limit = DEFAULT_NO_PROGRESS_LIMIT;
+
+// Directory of the game store the games are added to (NULL for none)
+char *record_directory = NULL;
+
 
 /* get_movement sets up the interactive board for the player to perform a
  * movement (with get_movement_interactively), stores the given movement in
  * 'src' and 'dest', and returns the movement type (CAPTURE or REGULAR -- never
  * INVALID because get_movement_interactively only allows the player to select
  * movements from the given options).
+ * The options are the first steps of the complete moves in 'moves'.
  */
-Movtype get_movement(Game_state *state, Position *src, Position *dest)
+Movtype get_movement(Game_state *state, Move_list *moves, Position *src, Position *dest)
 {
     Mov_options options;
-    generate_mov_options(state, &options);
+    get_step_options(moves, NULL, &options);
 
     // Tell whether a capture must be performed
     if (options.type == CAPTURE)
@@ -80,10 +96,10 @@ Movtype get_movement(Game_state *state, Position *src, Position *dest)
 }
 
 
-/* get_sequential_capture: if the player can perform a capture from 'src', the
- * game will set up the interactive board for the player to peform the capture
- * (or to choose between different possible captures if there's more than one),
- * and then store it in 'dest'.
+/* get_sequential_capture: if the player can perform a capture from where the
+ * 'played' part of the move ends, the game will set up the interactive board
+ * for the player to peform the capture (or to choose between different
+ * possible captures if there's more than one), and then store it in 'dest'.
  * If no captures are available, nothing is done. 
  * It returns CAPTURE if there were captures available, REGULAR otherwise.
  *
@@ -91,49 +107,98 @@ Movtype get_movement(Game_state *state, Position *src, Position *dest)
  * get_sequential_capture again: if CAPTURE was returned it means the player
  * can perform even more sequential captures, so call it again; otherwise stop
  * calling since no more sequential captures are available.
+ * (What's available comes from the complete moves in 'moves', so that it
+ * follows the variant's rules about which sequences are allowed.)
  */
-Movtype get_sequential_capture(Game_state *state, Position src, Position *dest)
+Movtype get_sequential_capture(Game_state *state, Move_list *moves, Move *played,
+                               Position *dest)
 {
-    Dest_options destopts;
-    generate_dest_options(state, src, &destopts, true);
-
-    if (destopts.type == CAPTURE) {
-        // get_movement_interactively takes a Mov_options, not a Dest_options,
-        // so we must create a Mov_options with only the capture(s) as option(s).  
-        Mov_options opts;
-        opts.type = CAPTURE;
-        opts.array[0] = destopts;
-        opts.length = 1;
+    Mov_options opts;
+    get_step_options(moves, played, &opts);
 
+    if (opts.length > 0) {
+        Position src = played->path[played->length - 1];
         msgwin_print(getmsg(MUST_PERFORM_SEQUENTIAL_CAPTURE, language));
         get_movement_interactively(state, &opts, &src, dest);
+        return CAPTURE;
     }
 
-    return destopts.type;
+    return REGULAR;
 }
 
 
 /* game_loop will play the game with the given Game_state until the end. */
 void game_loop(Game_state *state)
 {
+    // One engine per color, so that with --engine both each one can ponder
+    // while the other thinks
+    Engine engines[2];
+    for (int color = WHITE; color <= BLACK; color++)
+        if (engine_plays[color]) {
+            engine_init(&engines[color], engine_depth, engine_movetime, engine_hash);
+            engines[color].mcts_threads = engine_mcts_threads;
+        }
+
+    // The positions before the current one, to detect repetitions
+    History history;
+    history_init(&history, draw_limit);
+
+    // The movements played, for the game store
+    Game_record record;
+    record_init(&record);
+
     while (state->situation == ONGOING)
     {
+        Move_list moves;
+        generate_moves(state, &moves);
+        update_blocked_situation(state, &moves);
+        if (state->situation != ONGOING)
+            break;
+
+        if (engine_plays[state->current_player]) {
+            Engine *engine = &engines[state->current_player];
+            Move move;
+            get_engine_movement(state, &history, engine, &move);
+            record_push(&record, &moves, &move);
+            history_push(&history, state);
+            game_apply_move(state, &move);
+            update_draw_situation(state, &history);
+            if (engine_pondering)
+                engine_ponder(engine, state, &history);
+            continue;
+        }
+
+        history_push(&history, state);
+
         Position movsrc, movdest;
-        Movtype type = get_movement(state, &movsrc, &movdest);
-        if (type == REGULAR) {
-            perform_movement(state, movsrc, movdest);
-        } else {
+        Movtype type = get_movement(state, &moves, &movsrc, &movdest);
+        perform_step(state, movsrc, movdest);
+        Move played = { .path = { movsrc, movdest }, .length = 2 };
+        if (type == CAPTURE) {
             // keep performing captures with the same piece if available
-            while (type == CAPTURE) {
-                perform_movement(state, movsrc, movdest);
-                movsrc = movdest;
-                type = get_sequential_capture(state, movsrc, &movdest);
+            while (get_sequential_capture(state, &moves, &played, &movdest) == CAPTURE) {
+                perform_step(state, played.path[played.length - 1], movdest);
+                played.path[played.length++] = movdest;
             }
         }
+        record_push(&record, &moves, &played);
 
         upgrade_stones_to_dames(state);
         switch_player(state);
         update_situation(state);
+        update_draw_situation(state, &history);
+    }
+
+    for (int color = WHITE; color <= BLACK; color++)
+        if (engine_plays[color])
+            engine_free(&engines[color]);
+
+    Game_store store;
+    if (record_directory != NULL
+     && store_open(&store, record_directory, STORE_DEFAULT_ENTRIES)) {
+        record.result = state->situation;
+        store_append(&store, &record);
+        store_close(&store);
     }
 
     /* FIXME segmentation fault somewhere here. maybe already fixed by adding the _MSG though
@@ -157,13 +222,51 @@ int main(int argc, char **argv)
 {
     for (int i = 1; i < argc; i++) {
         if (strcmp("--pt", argv[i]) == 0)  language = PT;
+        // --engine white|black|both: who the computer plays for
+        else if (strcmp("--engine", argv[i]) == 0 && i+1 < argc) {
+            char *who = argv[++i];
+            engine_plays[WHITE] = strcmp(who, "white") == 0 || strcmp(who, "both") == 0;
+            engine_plays[BLACK] = strcmp(who, "black") == 0 || strcmp(who, "both") == 0;
+        }
+        // --depth N and --movetime MS limit how long the engine thinks
+        else if (strcmp("--depth", argv[i]) == 0 && i+1 < argc)
+            engine_depth = atoi(argv[++i]);
+        else if (strcmp("--movetime", argv[i]) == 0 && i+1 < argc)
+            engine_movetime = atol(argv[++i]);
+        // --hash MB: size of the engine's transposition table
+        else if (strcmp("--hash", argv[i]) == 0 && i+1 < argc)
+            engine_hash = atol(argv[++i]);
+        // --ponder: let the engine think while the opponent does
+        else if (strcmp("--ponder", argv[i]) == 0)
+            engine_pondering = true;
+        // --mcts N: search with Monte Carlo tree search, on N threads
+        else if (strcmp("--mcts", argv[i]) == 0 && i+1 < argc)
+            engine_mcts_threads = atoi(argv[++i]);
+        // --draw-limit N: turns without progress before the game is a tie
+        else if (strcmp("--draw-limit", argv[i]) == 0 && i+1 < argc)
+            draw_limit = atoi(argv[++i]);
+        // --record DIR: add the game to the game store in DIR
+        else if (strcmp("--record", argv[i]) == 0 && i+1 < argc)
+            record_directory = argv[++i];
+#ifdef NNUE
+        // --nnue FILE: evaluate positions with the network in FILE
+        else if (strcmp("--nnue", argv[i]) == 0 && i+1 < argc) {
+            if (!nnue_load(argv[++i])) {
+                printf("Can't load the network in %s\n", argv[i]);
+                return 1;
+            }
+        }
+#endif
     }
 
     initscr();
 
-    if (LINES < 24 || COLS < 80) {
+    // The board takes the top half of the screen, so a bigger board needs
+    // a taller terminal
+    int min_lines = BOARD_SIZE == 8 ? 24 : 28;
+    if (LINES < min_lines || COLS < 80) {
         printf("Your terminal window is too small (%dx%d)!"
-               " At least 80x24.\n", COLS, LINES);
+               " At least 80x%d.\n", COLS, LINES, min_lines);
         endwin();
         return 1;
     }
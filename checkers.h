@@ -2,8 +2,104 @@
 #define CHECKERS_H
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
 
+/* The board's size is fixed when compiling: build with -DBOARD_SIZE=10 for
+ * 10x10 (international) draughts, otherwise it's the usual 8x8.  Everything
+ * that depends on it -- tables, loop bounds, array sizes -- is worked out
+ * from it by the preprocessor, so each build is made for exactly one board
+ * and never has to check the size while it runs. */
+#ifndef BOARD_SIZE
 #define BOARD_SIZE 8
+#endif
+
+#if BOARD_SIZE != 8 && BOARD_SIZE != 10
+#error "BOARD_SIZE must be 8 or 10"
+#endif
+
+// Each player starts with the rows on their side filled, except the two
+// middle ones
+#define STARTING_ROWS (BOARD_SIZE/2 - 1)
+
+// Rule variants {{{
+/* Like the board size, the rules are chosen when compiling, with
+ * -DVARIANT=VARIANT_RUSSIAN and so on.  Each variant is a set of RULE_
+ * macros, and the movement generation is written in terms of them with #if,
+ * so a build only has the code for its own rules and never asks which rules
+ * are in effect while it plays.
+ *
+ *   RULE_BACKWARD_CAPTURE   stones can capture backwards
+ *   RULE_FLYING_DAMES       dames move and capture along whole diagonals
+ *                           (otherwise they move like stones, in all directions)
+ *   RULE_MAJORITY_CAPTURE   the player must take the capture sequence that
+ *                           captures the most pieces
+ *   RULE_TURKISH_STRIKE     captured pieces only come off the board when the
+ *                           move is over: until then they can't be jumped
+ *                           again and nothing can go past them, and a flying
+ *                           dame jumps one piece at a time (otherwise each
+ *                           capture takes its pieces off right away, and a
+ *                           dame takes everything it flies over)
+ *   RULE_PROMOTION          when a stone reaching the other side is promoted:
+ *     PROMOTE_AT_END          only if the move ends there
+ *     PROMOTE_DURING_CAPTURE  right away, going on capturing as a dame
+ *     PROMOTION_ENDS_MOVE     right away, and that ends the move
+ *   RULE_FIRST_PLAYER       who moves first
+ */
+#define VARIANT_POOL          1  // the default: the rules this game always had
+#define VARIANT_BRAZILIAN     2
+#define VARIANT_INTERNATIONAL 3  // Brazilian rules on 10x10
+#define VARIANT_RUSSIAN       4
+#define VARIANT_ENGLISH       5
+
+#define PROMOTE_AT_END         1
+#define PROMOTE_DURING_CAPTURE 2
+#define PROMOTION_ENDS_MOVE    3
+
+#ifndef VARIANT
+#define VARIANT VARIANT_POOL
+#endif
+
+#if VARIANT == VARIANT_POOL
+#define RULE_BACKWARD_CAPTURE 1
+#define RULE_FLYING_DAMES     1
+#define RULE_MAJORITY_CAPTURE 0
+#define RULE_TURKISH_STRIKE   0
+#define RULE_PROMOTION        PROMOTE_AT_END
+#define RULE_FIRST_PLAYER     WHITE
+#elif VARIANT == VARIANT_BRAZILIAN || VARIANT == VARIANT_INTERNATIONAL
+#if VARIANT == VARIANT_INTERNATIONAL && BOARD_SIZE != 10
+#error "International draughts is played on 10x10 (-DBOARD_SIZE=10)"
+#endif
+#define RULE_BACKWARD_CAPTURE 1
+#define RULE_FLYING_DAMES     1
+#define RULE_MAJORITY_CAPTURE 1
+#define RULE_TURKISH_STRIKE   1
+#define RULE_PROMOTION        PROMOTE_AT_END
+#define RULE_FIRST_PLAYER     WHITE
+#elif VARIANT == VARIANT_RUSSIAN
+#define RULE_BACKWARD_CAPTURE 1
+#define RULE_FLYING_DAMES     1
+#define RULE_MAJORITY_CAPTURE 0
+#define RULE_TURKISH_STRIKE   1
+#define RULE_PROMOTION        PROMOTE_DURING_CAPTURE
+#define RULE_FIRST_PLAYER     WHITE
+#elif VARIANT == VARIANT_ENGLISH
+#define RULE_BACKWARD_CAPTURE 0
+#define RULE_FLYING_DAMES     0
+#define RULE_MAJORITY_CAPTURE 0
+#define RULE_TURKISH_STRIKE   0
+#define RULE_PROMOTION        PROMOTION_ENDS_MOVE
+#define RULE_FIRST_PLAYER     BLACK
+#else
+#error "Unknown VARIANT"
+#endif
+
+// (Counting the pieces a sequence captures needs them to stay on the board)
+#if RULE_MAJORITY_CAPTURE && !RULE_TURKISH_STRIKE
+#error "RULE_MAJORITY_CAPTURE needs RULE_TURKISH_STRIKE"
+#endif
+// }}}
 
 // Languages {{{
 typedef enum { PT, EN } Language;
@@ -25,9 +121,11 @@ typedef enum {
     BLACK_PLAYER,
 	MUST_SELECT_MOVEMENT,
 	ALREADY_SELECTED_MOVEMENT,
-    INSTRUCTIONS
+    INSTRUCTIONS,
+    ENGINE_THINKING,  // printf format: depth, score, nodes
+    ENGINE_PLAYED     // printf format: the movement
 } Message;
-#define NMESSAGES 14
+#define NMESSAGES 16
 
 char *getmsg(Message, Language);
 // }}}
@@ -50,9 +148,12 @@ typedef struct {
 // }}}
 
 // util.c {{{
-char* write_position (Position*, char*);
+char* write_position (Position*, char*);  // writes "(col,row)", 6 chars
 int abs(int);
 void print_indentation(int);
+long now_ms();  // milliseconds from a monotonic clock
+uint32_t next_random(uint64_t *seed);  // xorshift64*, one seed per thread
+bool write_all(int fd, const void *, size_t);  // false if a write fails
 
 bool is_valid_position    (Position);
 bool is_diagonal          (Position, Position);
@@ -67,21 +168,84 @@ bool piece_matches_player (Piece, Color);
 // }}}
 
 // game_state.c {{{
+/* 'hash' is a Zobrist hash of the board and the current player: a XOR of
+ * one key per (square, piece) and one for black being the current player.
+ * set_piece and switch_player keep it up to date, so positions can be told
+ * apart (e.g. in the transposition table) without comparing whole boards.
+ * 'mirror_hash' is the same for the position's mirror image (see game_key),
+ * so that tables can keep a position and its mirror image in one entry. */
+/* 'reversible_moves' counts the turns since the last capture or stone
+ * movement (see perform_movement), for the no-progress draw rule.
+ * The board keeps each Piece in a byte (get_piece and set_piece convert), which
+ * keeps the whole Game_state small: the search copies one for every
+ * movement it looks at, and the server keeps one for every game. */
+/* Builds with the neural evaluation (-DNNUE, see nnue.c) also keep its
+ * 'accumulator' up to date in set_piece, the same way as the hash, so that
+ * evaluating a position doesn't have to look at the whole board. */
+#define NNUE_HIDDEN 64
+
 typedef struct {
-    Piece board[BOARD_SIZE][BOARD_SIZE];
+    uint8_t board[BOARD_SIZE][BOARD_SIZE];
     Color current_player;
     Situation situation;
+    uint64_t hash;
+    uint64_t mirror_hash;
+    int reversible_moves;
+#ifdef NNUE
+    int16_t accumulator[NNUE_HIDDEN];
+#endif
 } Game_state;
 
 Piece get_piece (Game_state *, Position);
 void  set_piece (Game_state *, Position, Piece);
 
+extern const char piece_to_char[];  // how each Piece is written (' ' for EMPTY)
+
+uint64_t zobrist_key (Position, Piece);
+uint64_t game_hash   (Game_state *);  // computes the hash from scratch
+uint64_t game_mirror_hash (Game_state *);  // ... and the mirror image's
+void     game_rehash (Game_state *);  // sets both
+uint64_t game_key    (Game_state *, bool *mirrored);
+
+/* Positions as a line of text: the rows from the top of the board (the last
+ * row) down, separated by '/', with '.' for empty squares and piece_to_char's
+ * characters for pieces, then a space and 'w' or 'b' for the current player.
+ * E.g. "......../......../......../...X..../......../..o...../......../........ w" */
+#define POSITION_TEXT_LENGTH (BOARD_SIZE * (BOARD_SIZE + 1) + 2)
+
+char *game_to_text   (Game_state *, char *);  // needs POSITION_TEXT_LENGTH chars
+bool  game_from_text (Game_state *, const char *);
+
 void game_setup              (Game_state *);
 void switch_player           (Game_state *);
 void upgrade_stones_to_dames (Game_state *);
 void perform_movement        (Game_state *, Position src, Position dest);
 void game_print              (Game_state *, int indent);  // Just used for debugging nowadays
 void update_situation        (Game_state *);
+void perform_step            (Game_state *, Position src, Position dest);
+void game_copy               (Game_state *to, Game_state *from);
+void game_update             (Game_state *, Position src, Position dest);
+
+/* History is the stack of the hashes of the positions a game (and then the
+ * search, on top of them) went through, to tell when a position repeats.
+ * update_situation can't see any of that, so games that keep a History call
+ * update_draw_situation after it; the search treats a repeated position, or
+ * no progress for no_progress_limit turns, as a draw. */
+#define MAXHISTORY 1024
+#define DEFAULT_NO_PROGRESS_LIMIT 50
+
+typedef struct {
+    uint64_t hashes[MAXHISTORY];
+    int length;
+    int no_progress_limit;
+} History;
+
+void history_init          (History *, int no_progress_limit);
+void history_push          (History *, Game_state *);
+void history_pop           (History *);
+int  history_repetitions   (History *, Game_state *);
+bool history_is_draw       (History *, Game_state *, int occurrences);
+void update_draw_situation (Game_state *, History *);
 /// }}}
 
 // movement.c {{{
@@ -89,12 +253,20 @@ void update_situation        (Game_state *);
 // Returns the type of the given movement -- INVALID, REGULAR or CAPTURE.
 Movtype get_movtype (Game_state *, Position from, Position to);
 
-#define MAXOPTIONS 13
+/* How far along a diagonal a dame's destinations can be: anywhere with
+ * flying dames, otherwise just one square (or two, capturing). */
+#if RULE_FLYING_DAMES
+#define DAME_RANGE BOARD_SIZE
+#else
+#define DAME_RANGE 2
+#endif
+
+#define MAXOPTIONS (2*BOARD_SIZE - 3)
 /* MAXOPTIONS is the upper bound to how many movement options any piece has.
-/* A /stone/ will have at most four options of movement (captures in all four
+ * A /stone/ will have at most four options of movement (captures in all four
  * directions), or two if it can't capture, but a /dame/ can potentially move to
  * every square in its four diagonals, the amount of which seems to be 13 in total
- * (count the X's below).
+ * on 8x8 (count the X's below), and 17 on 10x10.
  *   12345678
  * 1|       X|
  * 2|X     X |
@@ -123,7 +295,7 @@ typedef struct {
 
 void generate_dest_options(Game_state *, Position, Dest_options *, bool only_captures);
 
-#define NUMPIECES 12
+#define NUMPIECES (STARTING_ROWS * BOARD_SIZE/2)
 
 /* Mov_options groups the data that informs all movement options a player has.
  * That is, it lists all the Dest_options for each piece.  Again a
@@ -138,9 +310,57 @@ typedef struct {
 } Mov_options;
 
 void generate_mov_options(Game_state *, Mov_options *);
+
+/* A Mov_options only has the first step of each movement: when it's a capture
+ * the player may have to keep capturing with the same piece, which
+ * game_loop handles by asking for one capture at a time.  The engine needs
+ * whole turns instead, so a Move is the complete path of the moving piece:
+ * from path[0] to path[1], then (sequential captures) to path[2], and so on.
+ * A piece can capture at most NUMPIECES times, hence MAXPATH. */
+#define MAXPATH (NUMPIECES + 1)
+
+typedef struct {
+    Position path[MAXPATH];
+    int length;  // number of positions in the path, always >= 2
+} Move;
+
+/* Move_list is the variable-length array of all Moves a player can make;
+ * 'type' tells whether they're captures or regular movements, like in
+ * Mov_options.  (MAXMOVES has to stay under TT_NO_MOVE, see tt.c.)  It's
+ * plenty for the positions games get to, but it isn't a proven bound:
+ * generate_moves stops the program if a position has more. */
+#if BOARD_SIZE == 8
+#define MAXMOVES 128
+#else
+#define MAXMOVES 192
+#endif
+
+typedef struct {
+    Move array[MAXMOVES];
+    int length;
+    Movtype type;
+} Move_list;
+
+void generate_moves  (Game_state *, Move_list *);
+void update_blocked_situation (Game_state *, Move_list *);  // no moves: lost
+void get_step_options(Move_list *, Move *prefix, Mov_options *);
+void game_apply_move (Game_state *, Move *);  // in game_state.c
+int  find_move       (Move_list *, Move *);  // index in the list, or -1
+char *write_move     (Move *, char *);  // needs 10 chars per position in the path
+
+/* Moves in the usual notation: squares are a column letter and a row number
+ * ("a1" is row 0, col 0), joined by '-' for a regular movement and by 'x'
+ * for captures, like "c3-d4" or "c3xe5xc7".  move_from_text only accepts
+ * moves that can be played in the given position. */
+#define MOVE_TEXT_LENGTH (4 * MAXPATH)
+
+char *move_to_text   (Move *, Movtype, char *);  // needs MOVE_TEXT_LENGTH chars
+bool  move_from_text (Game_state *, const char *, Move *);
 // }}}
 
 // {{{ interface.c
+struct Engine;
+
 void msgwin_print(char *);
 
 void setup_interface();
@@ -153,11 +373,667 @@ void get_movement_interactively(
         Position *src,
         Position *dest
 );
+void get_engine_movement(Game_state *, History *, struct Engine *, Move *);
+
+// For other programs' windows (only declared where ncurses.h was included)
+#ifdef NCURSES_VERSION
+#define BOARD_LINES (BOARD_SIZE + 2)      // with the frame
+#define BOARD_COLS  (3 * BOARD_SIZE + 2)
+void board_show(WINDOW *, int y, int x, Game_state *);
+#endif
+// }}}
+
+// tt.c {{{
+#include <stdatomic.h>
+
+// What a stored score says about the position's real value
+typedef enum { TT_EXACT = 1, TT_LOWER, TT_UPPER } Tt_bound;
+
+/* Tt_entry is what the transposition table knows about a position: its
+ * score when searched 'depth' plies deep (from white's point of view, and
+ * with wins counted from the position itself, not from the root of the
+ * search), whether that's the exact value or just a bound, and which movement
+ * was the best ('move' is its index in generate_moves' list, or TT_NO_MOVE).
+ * The search keys positions with game_key, so an entry is for a position
+ * and its mirror image alike; 'mirrored' tells which of them 'move' is for. */
+typedef struct {
+    float score;
+    int8_t depth;
+    uint8_t bound;
+    uint8_t move;
+    uint8_t mirrored;
+} Tt_entry;
+
+#define TT_NO_MOVE 0xFF
+
+typedef struct {
+    _Atomic uint64_t check;  // the position's hash XOR data
+    _Atomic uint64_t data;   // the packed Tt_entry
+} Tt_slot;
+
+typedef struct {
+    Tt_slot *slots;
+    size_t mask;    // number of slots - 1
+    void *mapping;  // what tt_load mapped (NULL if allocated by tt_init)
+    size_t mapped;
+} Ttable;
+
+bool tt_init  (Ttable *, size_t megabytes);
+void tt_free  (Ttable *);
+void tt_clear (Ttable *);
+bool tt_probe (Ttable *, uint64_t hash, Tt_entry *);
+void tt_store (Ttable *, uint64_t hash, Tt_entry *);
+
+/* A table can be saved to a file and loaded back, along with 'root_size'
+ * bytes of whatever the program needs to pick its search up again (at most
+ * TT_FILE_MAX_ROOT).  The file is a Tt_file_header, the root data, and from
+ * TT_FILE_HEADER on the slots as they are in memory, so tt_load just maps
+ * it: however big the table, loading takes no time, and its pages are read
+ * as the search gets to them.  (The mapping is private: the search changes
+ * its copy, never the file.)
+ *
+ * The header and the root data are checked against their checksums when
+ * loading.  The slots' checksum would mean reading the whole file, so only
+ * tt_verify_file does that; a slot that got corrupted anyway is just a
+ * miss, since its two words no longer match (see tt.c).  Both return false
+ * with errno set when the file isn't right (EINVAL for a file that's not a
+ * table of this build's, or whose root data has another size).  tt_load
+ * sets a Ttable up the way tt_init does, and tt_free undoes either. */
+#define TT_FILE_MAGIC   "CKTT"
+#define TT_FILE_VERSION 1
+#define TT_FILE_HEADER  4096  // a page, so that the slots are aligned
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint16_t board_size;
+    uint16_t variant;
+    uint32_t slot_size;        // sizeof(Tt_slot)
+    uint64_t slots;
+    uint64_t slots_checksum;
+    uint32_t root_size;        // bytes of root data right after the header
+    uint32_t reserved;
+    uint64_t root_checksum;
+    uint64_t header_checksum;  // of all the above
+} Tt_file_header;
+
+#define TT_FILE_MAX_ROOT (TT_FILE_HEADER - sizeof(Tt_file_header))
+
+bool tt_save        (Ttable *, const char *path, const void *root, size_t root_size);
+bool tt_load        (Ttable *, const char *path, void *root, size_t root_size);
+bool tt_verify_file (const char *path);
+// }}}
+
+// store.c {{{
+/* The game store keeps the games played, in a directory with two files:
+ *
+ *  - games.log, the games one after the other.  Each one is a Record_header
+ *    and then one byte per movement: its index in generate_moves' list.  The
+ *    file is only ever appended to, one write per game, so several processes
+ *    can add games to it at the same time.
+ *  - positions.idx, a hash table from positions (their game_key, so a
+ *    position and its mirror image share an entry, with the wins counted
+ *    for the colors of the one whose hash is smaller) to how many games
+ *    reached them and how those games ended.  It's meant to be
+ *    memory-mapped: an Index_header and then the entries, which are updated
+ *    with atomic operations only, so readers never lock anything and
+ *    writers only race on the entry they both want.
+ *
+ * Move indices and position hashes only mean something to builds with the
+ * same board size and rules, so both files say which ones they're for. */
+
+#define STORE_LOG_MAGIC    "CKGL"
+#define STORE_INDEX_MAGIC  "CKPI"
+#define STORE_VERSION      1
+#define STORE_INDEX_VERSION 2  // 1 was keyed by the positions' hash
+#define STORE_DEFAULT_ENTRIES (1 << 20)
+
+// Games start from game_setup's position and have at most this many turns
+#define MAXRECORD MAXHISTORY
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint16_t board_size;
+    uint16_t variant;
+    uint32_t reserved;
+} Store_file_header;  // at the start of games.log
+
+typedef struct {
+    uint16_t length;    // movements
+    uint8_t  result;    // a Situation; ONGOING for unfinished games
+    uint8_t  reserved;
+} Record_header;
+
+typedef struct {
+    Situation result;
+    int length;
+    uint8_t moves[MAXRECORD];
+} Game_record;
+
+typedef struct {
+    Store_file_header file;
+    uint64_t capacity;           // entries, a power of two
+    _Atomic uint64_t used;       // entries holding a position
+    _Atomic uint64_t games;      // games indexed
+    uint64_t reserved[4];
+} Index_header;
+
+/* Results are counted for WHITE_WINS, BLACK_WINS and TIE (results[situation - 1]);
+ * unfinished games only count in 'games'.  A game is counted once for each
+ * position it reached, however many times it got there (and only once if
+ * it reached its mirror image too). */
+typedef struct {
+    _Atomic uint64_t key;        // the position's game_key, 0 in empty entries
+    _Atomic uint32_t games;
+    _Atomic uint32_t results[3];
+} Index_entry;
+
+typedef struct {
+    uint32_t games;
+    uint32_t white_wins, black_wins, ties;
+} Position_stats;
+
+typedef struct {
+    int log_fd;
+    int index_fd;
+    Index_header *index;  // the whole mapped file
+    Index_entry *entries;
+    size_t map_size;
+} Game_store;
+
+bool store_open   (Game_store *, const char *directory, uint64_t index_entries);
+void store_close  (Game_store *);
+bool store_append (Game_store *, Game_record *);
+bool store_lookup (Game_store *, Game_state *, Position_stats *);
+long store_read   (Game_store *, long offset, Game_record *);
+
+void record_init  (Game_record *);
+bool record_push  (Game_record *, Move_list *, Move *);
+bool record_move  (Game_record *, int turn, Game_state *, Move *);
+// }}}
+
+// training.c {{{
+/* Positions for training evaluations (see datagen.c), packed into a few
+ * bytes each.  Pieces only ever stand on the dark squares, BOARD_SIZE/2 of
+ * each row, so a position is three masks over them -- which are occupied,
+ * which of those have white pieces, which have dames -- plus who moves, how
+ * the game ended and what the search made of it: 16 bytes on 8x8 (32 on
+ * 10x10), where a Game_state takes about a hundred.
+ *
+ * A training file is a Training_header and then its positions, in the
+ * host's byte order. */
+#define TRAINING_MAGIC   "CKTD"
+#define TRAINING_VERSION 1
+
+#define DARK_SQUARES (BOARD_SIZE * BOARD_SIZE / 2)
+
+#if BOARD_SIZE == 8
+typedef uint32_t Square_mask;
+#else
+typedef uint64_t Square_mask;
+#endif
+
+// Scores are kept in tenths; wins (and losses) all become +-TRAINING_WIN
+#define TRAINING_WIN INT16_MAX
+
+#define PACKED_BLACK_TO_MOVE 0x01  // in flags, whose bits 1-2 are the result
+
+typedef struct {
+    Square_mask occupied;  // bit i is dark square i (see dark_square)
+    Square_mask white;
+    Square_mask dames;
+    int16_t score;         // the search's, for the player to move
+    uint8_t flags;         // PACKED_BLACK_TO_MOVE | the game's Situation << 1
+    uint8_t reserved;
+} Packed_position;
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint16_t board_size;
+    uint16_t variant;
+    uint32_t record_size;  // sizeof(Packed_position)
+    uint64_t count;        // positions in the file
+} Training_header;
+
+int      dark_square      (Position);  // 0 to DARK_SQUARES-1, row by row
+Position dark_square_position (int);
+void     pack_position    (Game_state *, double score, Situation result, Packed_position *);
+void     unpack_position  (Packed_position *, Game_state *, double *score, Situation *result);
+Square_mask mirror_squares (Square_mask);
+void     mirror_packed    (Packed_position *);
+void     training_header  (Training_header *, uint64_t count);
+bool     training_header_ok (Training_header *);
+// }}}
+
+// batch.c {{{
+/* Movement generation for many positions at once.  A Batch holds up to
+ * BATCH_SIZE positions as masks over the dark squares, the way training.c
+ * packs them, but structure-of-arrays: the white pieces of all positions in
+ * one array, their black pieces in another, and so on.  generate_batch
+ * works out what can move where with the same few mask operations for every
+ * position, in loops over the positions that the compiler turns into vector
+ * instructions (build with -O3, and -mavx2 where there is one), and only
+ * then goes position by position writing the movements out.
+ *
+ * What comes out is what generate_mov_options gives: the first step of each
+ * movement, and only captures when there's one.  A step is packed as
+ * 'from | to << 8', both dark squares (see dark_square); a position's steps
+ * are ordered by piece kind and direction, not column by column. */
+#define BATCH_SIZE 64
+#define BATCH_MAXSTEPS (NUMPIECES * MAXOPTIONS)
+
+typedef struct {
+    int length;  // positions in use; the others are empty boards
+    Square_mask white[BATCH_SIZE];
+    Square_mask black[BATCH_SIZE];
+    Square_mask dames[BATCH_SIZE];        // of either color
+    Square_mask black_moves[BATCH_SIZE];  // all ones if black is to move, else 0
+} Batch;
+
+typedef struct {
+    int length[BATCH_SIZE];
+    Movtype type[BATCH_SIZE];
+    uint16_t steps[BATCH_SIZE][BATCH_MAXSTEPS];
+} Batch_steps;
+
+#define BATCH_STEP_FROM(step) ((step) & 0xFF)
+#define BATCH_STEP_TO(step)   ((step) >> 8)
+
+void batch_clear    (Batch *);
+bool batch_add      (Batch *, Game_state *);  // false when the batch is full
+void generate_batch (Batch *, Batch_steps *);
 // }}}
 
+// monitor.c {{{
+/* A monitor lets another process watch what a program's workers are doing
+ * (datagen's games, say; see dashboard.c) without slowing them down: it's a
+ * file both map, holding a Monitor_header and then a slot per worker.  Each
+ * worker publishes its Worker_status into its own slot whenever it likes,
+ * and the watcher copies the slots out whenever it likes; neither ever
+ * waits for the other.  A slot is a seqlock: its sequence number is odd
+ * while the worker writes it, and a copy is only good if the number was
+ * even and the same before and after copying.  (The words of a slot are
+ * atomics, so that copying one while it's written is merely useless rather
+ * than undefined.)
+ *
+ * Times are now_ms()'s, whose clock all processes share. */
+#define MONITOR_MAGIC      "CKMN"
+#define MONITOR_VERSION    1
+#define MONITOR_MAXWORKERS 1024
+#define MONITOR_POSITION_LENGTH ((POSITION_TEXT_LENGTH + 7) / 8 * 8)
+
+typedef struct {
+    uint64_t games;       // games finished
+    uint64_t plies;       // movements played, all games together
+    uint64_t waiting_ms;  // time not spent playing (waiting for the writer)
+    int64_t updated_ms;   // when this was published
+    int32_t ply;          // of the game being played
+    float score;          // of its last search, from white's point of view
+    char position[MONITOR_POSITION_LENGTH];  // as game_to_text writes it
+} Worker_status;
+
+#define MONITOR_WORDS (sizeof(Worker_status) / 8)
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint16_t board_size;
+    uint16_t variant;
+    uint32_t workers;
+    int64_t started_ms;
+    _Atomic uint64_t produced;   // what the whole program made (positions)
+    _Atomic uint32_t finished;   // set when the program is done
+    uint32_t reserved;
+} Monitor_header;
+
+typedef struct {
+    _Alignas(64) _Atomic uint64_t sequence;  // a cache line of its own
+    _Atomic uint64_t words[MONITOR_WORDS];
+} Monitor_slot;
+
+typedef struct {
+    Monitor_header *header;
+    Monitor_slot *slots;
+    size_t size;
+    uint64_t file_id;  // the file's inode, to notice it being replaced
+} Monitor;
+
+/* monitor_create makes a new monitor file for 'workers' workers (replacing
+ * whatever was at 'path', which goes on as it was for whoever had it open);
+ * monitor_open opens one to watch.  Both return false with errno set if
+ * they can't (EINVAL for a file that's not a monitor of this build's). */
+bool monitor_create  (Monitor *, const char *path, int workers);
+bool monitor_open    (Monitor *, const char *path);
+void monitor_close   (Monitor *);
+void monitor_publish (Monitor *, int worker, const Worker_status *);
+bool monitor_read    (Monitor *, int worker, Worker_status *);
+// }}}
+
+// counters.c {{{
+/* The processor's own counters of what the calling thread did between
+ * counters_start and counters_stop, through Linux's perf_event_open, to
+ * tell whether a change made something cheaper or only moved its cost
+ * around (see bench.c).  Not every counter is there everywhere -- virtual
+ * machines often have none, and perf_event_paranoid may forbid them -- so
+ * each value says whether it's valid; when none could be opened,
+ * counters_open returns false with the reason in 'error', and the values
+ * all read as invalid. */
+typedef enum {
+    COUNTER_CYCLES,
+    COUNTER_INSTRUCTIONS,
+    COUNTER_BRANCH_MISSES,
+    COUNTER_L1D_MISSES,  // reads that missed the L1 data cache
+    COUNTER_LLC_MISSES,  // ... and the last level cache (going to memory)
+    NCOUNTERS
+} Counter;
+
+typedef struct {
+    int fds[NCOUNTERS];  // -1 for the counters that couldn't be opened
+    bool available;      // whether any could
+    char error[128];
+} Counters;
+
+typedef struct {
+    uint64_t value[NCOUNTERS];
+    bool valid[NCOUNTERS];
+} Counter_values;
+
+extern const char *counter_names[NCOUNTERS];  // short, for column headers
+
+bool counters_open  (Counters *);
+void counters_close (Counters *);
+void counters_start (Counters *);  // from zero
+void counters_stop  (Counters *, Counter_values *);
+// }}}
+
+// ai.c {{{
+
+/* Scores from the point of view of the maximizing player.  Positions where a
+ * player has no movements left are lost for them and worth WIN_SCORE (minus
+ * the number of plies it takes to get there, so that faster wins are
+ * preferred); everything else comes from evaluate and is much smaller. */
+#define WIN_SCORE 10000.0
+#define DRAW_SCORE 0.0
+
+// How deep a search without a depth limit can go
+#define MAXDEPTH 64
+
+/* A Pv_line is one line of play the search expects: a root movement, its
+ * score and the movements it expects to follow (the principal variation).
+ * They're kept as what the transposition table keeps, each movement's index
+ * in generate_moves' list for the position it's made in; pv_to_text writes
+ * them out. */
+#define MAXMULTIPV 16
+#define MAXPV 32
+
+typedef struct {
+    double score;
+    int length;
+    uint8_t moves[MAXPV];
+} Pv_line;
+
+char *pv_to_text (Game_state *, Pv_line *, char *text, size_t size);
+
+/* Search holds the limits of an iterative-deepening search and what it has
+ * found so far.  The search runs depth 1, 2, 3... until max_depth, until
+ * movetime_ms milliseconds have passed, until it has searched max_nodes
+ * nodes (if that's set after search_init) or until someone sets 'stop' (the
+ * atomic components may be read and written from other threads while the
+ * search runs).  'best', 'score' and 'depth' always describe the last depth
+ * that was completely searched.  'history' starts with the positions the
+ * game went through before the one searched, and the search pushes the ones
+ * along the path it's looking at on top.
+ * With 'multipv' set above 1 (after search_init) each depth finds that many
+ * root movements, best first, each with its exact score: see search.
+ * 'lines' has them (one line otherwise), from the same last complete depth.
+ * Setting 'lines', 'nlines', 'best', 'score' and 'depth' after search_init
+ * to what an earlier search of the position found resumes it: it goes on
+ * with the next depth, as if it had just done that one. */
+typedef struct Search {
+    int max_depth;
+    atomic_long deadline_ms;  // see now_ms; 0 for no time limit
+    Ttable *tt;               // may be NULL
+    History history;
+    long max_nodes;           // 0 (what search_init sets) for no node limit
+    bool plain;               // plain alpha-beta, without principal variation
+                              // search, aspiration windows or late move
+                              // reductions (to compare with; see ai.c)
 
-double minimax(Game_state* state, int depth, Color maximizing_player, Position* src, Position *dest);
+    // If set, called each time a depth has been completely searched, with
+    // 'best', 'score' and 'depth' updated (search_init clears them)
+    void (*on_depth)(struct Search *, void *data);
+    void *on_depth_data;
+
+    int multipv;
+    int nlines;
+    Pv_line lines[MAXMULTIPV];
+    bool root_excluded[MAXMOVES];  // root movements found already this depth
+    int nexcluded;
+
+    atomic_bool stop;
+    atomic_int depth;
+    atomic_long nodes;
+    _Atomic double score;
+    Move best;
+} Search;
+
+void   search_init (Search *, int max_depth, long movetime_ms, Ttable *, History *);
+double search      (Game_state *, Search *);
+bool   search_expected_reply (Ttable *, Game_state *, Move *);
+
+double minimax(Game_state* state, int depth, Color maximizing_player, Move *best);
 double evaluate(Game_state* state, Color maximizing_player);
+// }}}
+
+// mcts.c {{{
+/* The other way of searching: Monte Carlo tree search on several threads
+ * (see mcts.c).  It takes the same Search as search, minus the depth limit
+ * and the transposition table; 'max_nodes' bounds the size of its tree
+ * (about 32 bytes a node). */
+#define MCTS_DEFAULT_NODES (1 << 22)
+
+double mcts(Game_state *, Search *, int threads, int32_t max_nodes);
+// }}}
+
+// pns.c {{{
+/* The other other way of searching: proof-number search, which doesn't
+ * score positions but proves that one is won (or lost) for the player to
+ * move, however long the winning line -- what a depth-limited search can't
+ * do for, say, a long sequence of dame moves.  It's depth-first (df-pn) and
+ * keeps everything it knows in a table of fixed size, so it can run for
+ * hours without needing more memory (see pns.c).
+ *
+ * A proof treats a repetition, and DEFAULT_NO_PROGRESS_LIMIT turns without
+ * progress, as a draw; a win it finds is a win whatever the opponent does.
+ * When no proof is found, within the limits, the result is PROOF_UNKNOWN:
+ * the position may be a draw, or just need more time or memory.  When
+ * there's a proof, 'line' is how it goes: the winning movements against the
+ * longest resistance, as far as the table still knows them. */
+#define PN_INFINITY UINT32_MAX
+#define PN_MAXDEPTH 300  // plies; a path longer than this counts as a draw
+
+typedef enum { PROOF_UNKNOWN, PROOF_WIN, PROOF_LOSS } Proof;  // for the player to move
+
+/* An entry is what's known about a position: its proof and disproof numbers
+ * from the point of view of the player to move there (phi is the one it
+ * wants to bring to 0, delta the other one), and how many nodes have been
+ * searched under it, which decides what's kept when the table is full. */
+typedef struct {
+    uint64_t key;     // the position's hash and turns without progress (0: empty)
+    uint32_t phi;
+    uint32_t delta;
+    uint64_t work;
+} Pn_entry;
+
+struct Pn_frame;
+
+typedef struct Proof_search {
+    Pn_entry *table;
+    size_t mask;              // entries - 1
+    struct Pn_frame *frames;  // a ply's movements and what they lead to
+    uint64_t path[PN_MAXDEPTH];
+
+    long max_nodes;           // 0 (what proof_init sets) for no node limit
+    long deadline_ms;         // see now_ms; 0 for no time limit
+    atomic_bool stop;
+    atomic_long nodes;
+    Color attacker;           // whose win is being proved right now
+
+    // If set, called about once a second while searching
+    void (*on_progress)(struct Proof_search *, void *data);
+    void *on_progress_data;
+    long progress_ms;
+
+    Proof result;
+    Pv_line line;
+} Proof_search;
+
+bool  proof_init  (Proof_search *, size_t megabytes, long movetime_ms);
+void  proof_free  (Proof_search *);
+Proof proof_solve (Game_state *, Proof_search *);
+// }}}
+
+// nnue.c {{{
+/* The neural evaluation: a small network looking at which piece is on which
+ * square (one input feature per dark square and kind of piece), with one
+ * hidden layer of NNUE_HIDDEN clipped-ReLU units and one output.
+ * Only a few features change per movement, so the hidden layer's input sums
+ * (the accumulator) are updated as pieces come and go instead of recomputed:
+ * evaluating is then just the hidden layer and the output, in small integers.
+ *
+ * It's only compiled in with -DNNUE, and evaluate only uses it once weights
+ * are loaded with nnue_load; nnue_train makes weights from self-play games. */
+#define NNUE_MAGIC    "CKNN"
+#define NNUE_VERSION  1
+#define NNUE_SQUARES  (BOARD_SIZE * BOARD_SIZE / 2)
+#define NNUE_FEATURES (4 * NNUE_SQUARES)
+
+/* The network works with scores in units of NNUE_SCALE evaluate points.
+ * Weights are stored quantized: hidden weights and biases as multiples of
+ * 1/NNUE_QA (so an activation of 1.0 is NNUE_QA), output weights as multiples
+ * of 1/NNUE_QB and the output bias of 1/(NNUE_QA * NNUE_QB). */
+#define NNUE_SCALE 100.0
+#define NNUE_QA    127
+#define NNUE_QB    64
+
+/* A weights file is the 4 magic bytes, a uint32 version, uint16 board size,
+ * features and hidden units, and then an Nnue_weights, in the host's byte
+ * order. */
+typedef struct {
+    int16_t feature_weights[NNUE_FEATURES][NNUE_HIDDEN];
+    int16_t hidden_bias[NNUE_HIDDEN];
+    int8_t  output_weights[NNUE_HIDDEN];
+    int32_t output_bias;
+} Nnue_weights;
+
+extern bool nnue_loaded;
+
+bool   nnue_read     (const char *path, Nnue_weights *);
+bool   nnue_load     (const char *path);  // and use them in evaluate
+bool   nnue_save     (const char *path, Nnue_weights *);
+int    nnue_feature  (Position, Piece);
+void   nnue_refresh  (Game_state *);  // computes the accumulator from scratch
+void   nnue_update   (Game_state *, Position, Piece removed, Piece added);
+double nnue_evaluate (Game_state *);  // from white's point of view
+// }}}
+
+// engine.c {{{
+#include <pthread.h>
+
+/* An Engine runs a Search on a thread of its own, so that the interface can
+ * keep going (and show how the search is doing) while it thinks.
+ * engine_start copies the position and starts searching it; engine_done
+ * tells whether the search is over; engine_stop asks it to finish early with
+ * the best movement found so far; engine_wait waits for the search to end and
+ * gets its movement.
+ *
+ * While the opponent thinks, engine_ponder can keep the engine searching
+ * the position it expects to be given next (see engine.c). */
+typedef struct Engine {
+    int max_depth;
+    long movetime_ms;
+    Ttable tt;
+    int mcts_threads;  // > 0 to search with mcts instead, on that many threads
+
+    Game_state state;
+    Search search;
+    pthread_t thread;
+    bool running;  // whether 'thread' has to be joined
+    bool pondering;
+    atomic_bool done;
+} Engine;
+
+void engine_init  (Engine *, int max_depth, long movetime_ms, size_t hash_mb);
+void engine_free  (Engine *);
+void engine_start (Engine *, Game_state *, History *);
+bool engine_done  (Engine *);
+void engine_stop  (Engine *);
+void engine_wait  (Engine *, Move *);
+bool engine_ponder(Engine *, Game_state *, History *);
+// }}}
+
+// libcheckers.c {{{
+/* libcheckers.c is built once for each board size, so that both live in
+ * the library: each build's games are behind its Checkers_board, and
+ * libcheckers_api.c, the API, calls the one each game was made for.  (A
+ * game is a void * here, since each size's is its own.) */
+typedef struct {
+    int board_size;
+    void  *(*new_game)     (size_t hash_mb);  // NULL if out of memory
+    void   (*free_game)    (void *);
+    void   (*reset)        (void *);
+    bool   (*set_position) (void *, const char *text);
+    char  *(*position)     (void *, char *text, size_t size);
+    int    (*moves)        (void *, char *text, size_t size);
+    bool   (*play)         (void *, const char *move);
+    int    (*result)       (void *);  // a Checkers_result
+    double (*search)       (void *, int max_depth, long movetime_ms, char *move, size_t size);
+    void   (*stop)         (void *);
+} Checkers_board;
+
+extern const Checkers_board checkers_board_8, checkers_board_10;
+// }}}
+
+// trace.c {{{
+/* The search can record every movement it looks at into a compact binary
+ * trace file, which the separate trace_dump tool renders as an indented tree
+ * (see build.sh).  Tracing is only compiled in when TRACE_SEARCH is defined;
+ * otherwise the TRACE_ macros expand to nothing and the search doesn't pay
+ * anything for them. */
+
+#define TRACE_MAGIC   "CKTR"
+#define TRACE_VERSION 1
+
+/* A trace file is the 4 magic bytes, a uint32 version, and then one
+ * Trace_record per searched movement, written when its score is known.  So
+ * the records come in post-order: the replies to a movement are written
+ * before the movement itself.  Records are written in the host's byte order. */
+typedef struct {
+    uint8_t ply;        // distance from the root (the root's movements have ply 0)
+    uint8_t depth;      // remaining search depth below this movement
+    uint8_t src;        // row << 4 | col
+    uint8_t dest;       // row << 4 | col
+    float alpha, beta;  // window the movement was searched with
+    float score;
+} Trace_record;
+
+bool trace_open   (const char *path);
+void trace_record (int ply, int depth, Position src, Position dest,
+                   double alpha, double beta, double score);
+void trace_close  ();
+
+#ifdef TRACE_SEARCH
+#define TRACE_OPEN(path)     trace_open(path)
+#define TRACE_SEARCHED(...)  trace_record(__VA_ARGS__)
+#define TRACE_CLOSE()        trace_close()
+#else
+#define TRACE_OPEN(path)     ((void) 0)
+#define TRACE_SEARCHED(...)  ((void) 0)
+#define TRACE_CLOSE()        ((void) 0)
+#endif
+// }}}
 
 #endif
 
@@ -0,0 +1,136 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include "checkers.h"
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+const char *counter_names[NCOUNTERS] = {
+    "cycles", "instrs", "br-miss", "L1D-miss", "LLC-miss"
+};
+
+#ifdef __linux__
+
+/* The events, in Counter order.  Only the process's own code is counted
+ * (exclude_kernel), which is also what perf_event_paranoid 2, the usual
+ * setting, lets an unprivileged process count. */
+static const struct { uint32_t type; uint64_t config; } events[NCOUNTERS] = {
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | PERF_COUNT_HW_CACHE_OP_READ << 8
+                          | PERF_COUNT_HW_CACHE_RESULT_MISS << 16 },
+    { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | PERF_COUNT_HW_CACHE_OP_READ << 8
+                          | PERF_COUNT_HW_CACHE_RESULT_MISS << 16 },
+};
+
+/* What a counter reads as (PERF_FORMAT_TOTAL_TIME_*): when there are more
+ * events than the processor has counters, the kernel takes turns between
+ * them, and the count is only for the time the event was running. */
+typedef struct {
+    uint64_t value;
+    uint64_t time_enabled;
+    uint64_t time_running;
+} Reading;
+
+bool counters_open(Counters *counters)
+{
+    counters->available = false;
+    counters->error[0] = '\0';
+
+    for (int c = 0; c < NCOUNTERS; c++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = events[c].type;
+        attr.config = events[c].config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        // This thread, on whichever processor it runs
+        counters->fds[c] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if (counters->fds[c] >= 0)
+            counters->available = true;
+        else if (counters->error[0] == '\0')
+            snprintf(counters->error, sizeof(counters->error), "perf_event_open: %s%s",
+                     strerror(errno), errno == EACCES || errno == EPERM
+                     ? " (see /proc/sys/kernel/perf_event_paranoid)" : "");
+    }
+    return counters->available;
+}
+
+void counters_close(Counters *counters)
+{
+    for (int c = 0; c < NCOUNTERS; c++) {
+        if (counters->fds[c] >= 0)
+            close(counters->fds[c]);
+        counters->fds[c] = -1;
+    }
+    counters->available = false;
+}
+
+void counters_start(Counters *counters)
+{
+    for (int c = 0; c < NCOUNTERS; c++) {
+        if (counters->fds[c] >= 0) {
+            ioctl(counters->fds[c], PERF_EVENT_IOC_RESET, 0);
+            ioctl(counters->fds[c], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+void counters_stop(Counters *counters, Counter_values *values)
+{
+    for (int c = 0; c < NCOUNTERS; c++)
+        if (counters->fds[c] >= 0)
+            ioctl(counters->fds[c], PERF_EVENT_IOC_DISABLE, 0);
+
+    for (int c = 0; c < NCOUNTERS; c++) {
+        Reading reading;
+        values->valid[c] = counters->fds[c] >= 0
+                        && read(counters->fds[c], &reading, sizeof(reading)) == sizeof(reading)
+                        && reading.time_running > 0;
+        values->value[c] = !values->valid[c] ? 0
+                         : reading.time_running == reading.time_enabled ? reading.value
+                         : (uint64_t) ((double) reading.value * reading.time_enabled
+                                                              / reading.time_running);
+    }
+}
+
+#else
+
+// Elsewhere there are no counters, and everything is measured in time alone
+
+bool counters_open(Counters *counters)
+{
+    for (int c = 0; c < NCOUNTERS; c++)
+        counters->fds[c] = -1;
+    counters->available = false;
+    snprintf(counters->error, sizeof(counters->error), "only on Linux");
+    return false;
+}
+
+void counters_close(Counters *counters)
+{
+    (void) counters;
+}
+
+void counters_start(Counters *counters)
+{
+    (void) counters;
+}
+
+void counters_stop(Counters *counters, Counter_values *values)
+{
+    (void) counters;
+    memset(values, 0, sizeof(*values));
+}
+
+#endif
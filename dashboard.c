@@ -0,0 +1,216 @@
+#include <ncurses.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include "checkers.h"
+
+/* dashboard shows, live, what the workers of a program publishing into a
+ * monitor are doing (datagen --monitor FILE; see monitor.c): the board of
+ * every game being played, as many as fit on the screen, how many
+ * movements and games they're all playing per second, and how busy each
+ * worker is -- the share of its time spent playing rather than waiting
+ * (for datagen's writer, say).
+ *
+ * Usage: dashboard FILE [options]
+ *   --fps N   frames per second (default 4)
+ * q quits.
+ *
+ * The screen is redrawn at a fixed rate, however fast the workers publish:
+ * each frame copies every worker's latest status out of the monitor, which
+ * never makes a worker wait, draws them all, and sends the terminal only
+ * what changed, in one go.  Rates are over the last second or so.  When the
+ * program is started again (and makes a new FILE), the dashboard moves on
+ * to the new one. */
+
+/* interface.c's, for its messages; the dashboard has none */
+Language language = EN;
+
+static int fps = 4;
+
+#define RATE_MS 1000  // how often the rates are worked out
+#define IDLE_MS 5000  // a worker that published nothing for this long is idle
+#define LOAD_COLS 9   // "#123 100%"
+
+static const char *path;
+static Monitor monitor;
+
+// The workers' statuses now, and when the rates were last worked out
+static Worker_status status[MONITOR_MAXWORKERS];
+static bool published[MONITOR_MAXWORKERS];
+static Worker_status base[MONITOR_MAXWORKERS];
+static long base_ms;
+
+static double moves_rate, games_rate;
+static int load[MONITOR_MAXWORKERS];  // percent, or -1 until it's known
+
+/* read_statuses copies every worker's status out of the monitor.  A status
+ * the worker was rewriting right then keeps its previous copy. */
+static void read_statuses()
+{
+    for (uint32_t w = 0; w < monitor.header->workers; w++)
+        if (monitor_read(&monitor, w, &status[w]))
+            published[w] = true;
+}
+
+/* update_rates works out the rates since the last time, and starts over */
+static void update_rates(long now)
+{
+    long elapsed = now - base_ms;
+    uint64_t plies = 0, games = 0;
+    for (uint32_t w = 0; w < monitor.header->workers; w++) {
+        if (!published[w]) {
+            load[w] = -1;
+            continue;
+        }
+        plies += status[w].plies - base[w].plies;
+        games += status[w].games - base[w].games;
+        long waited = status[w].waiting_ms - base[w].waiting_ms;
+        load[w] = waited >= elapsed ? 0 : (int) (100 - 100 * waited / elapsed);
+        base[w] = status[w];
+    }
+    moves_rate = (double) plies * 1000 / elapsed;
+    games_rate = (double) games * 1000 / elapsed;
+    base_ms = now;
+}
+
+/* start_rates reads the statuses the rates will be worked out from */
+static void start_rates(long now)
+{
+    read_statuses();
+    memcpy(base, status, sizeof(base));
+    for (int w = 0; w < MONITOR_MAXWORKERS; w++)
+        load[w] = -1;
+    base_ms = now;
+}
+
+/* reopen switches to a new FILE, if there's one; returns whether it did */
+static bool reopen(long now)
+{
+    struct stat st;
+    Monitor replacement;
+    if (stat(path, &st) != 0 || (uint64_t) st.st_ino == monitor.file_id
+     || !monitor_open(&replacement, path))
+        return false;
+
+    monitor_close(&monitor);
+    monitor = replacement;
+    memset(published, 0, sizeof(published));
+    start_rates(now);
+    return true;
+}
+
+
+// {{{ Drawing
+static void draw_summary(long now)
+{
+    Monitor_header *header = monitor.header;
+    long seconds = (now - header->started_ms) / 1000;
+    move(0, 0);
+    attron(A_REVERSE);
+    printw(" %s: %u workers, up %ld:%02ld:%02ld, %llu positions, %.1f moves/s, %.2f games/s%s ",
+           path, header->workers, seconds / 3600, seconds / 60 % 60, seconds % 60,
+           (unsigned long long) atomic_load(&header->produced), moves_rate, games_rate,
+           atomic_load(&header->finished) ? " -- finished" : "");
+    attroff(A_REVERSE);
+}
+
+/* draw_loads shows how busy each worker is, as many to a line as fit;
+ * returns the next free line */
+static int draw_loads(int line, long now)
+{
+    int per_line = COLS / (LOAD_COLS + 1) > 0 ? COLS / (LOAD_COLS + 1) : 1;
+    for (uint32_t w = 0; w < monitor.header->workers; w++) {
+        if (w % per_line == 0)
+            move(line++, 0);
+        if (!published[w] || now - status[w].updated_ms > IDLE_MS)
+            printw("#%-3u idle ", w);
+        else if (load[w] < 0)
+            printw("#%-3u   -- ", w);
+        else
+            printw("#%-3u %3d%% ", w, load[w]);
+    }
+    return line + 1;
+}
+
+/* draw_boards shows the games being played in a grid, from 'line' down,
+ * each with its worker, ply and score on top */
+static void draw_boards(int line)
+{
+    int columns = (COLS + 2) / (BOARD_COLS + 2);
+    int rows = (LINES - line) / (BOARD_LINES + 1);
+    int shown = 0;
+    for (uint32_t w = 0; w < monitor.header->workers && shown < rows * columns; w++) {
+        Game_state state;
+        if (!published[w] || !game_from_text(&state, status[w].position))
+            continue;
+        int y = line + shown / columns * (BOARD_LINES + 1);
+        int x = shown % columns * (BOARD_COLS + 2);
+        mvprintw(y, x, "#%u ply %d %+.1f", w, status[w].ply, status[w].score);
+        board_show(stdscr, y + 1, x, &state);
+        shown++;
+    }
+}
+// }}}
+
+
+static void usage()
+{
+    fprintf(stderr, "usage: dashboard FILE [--fps N]\n");
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+        usage();
+    path = argv[1];
+    for (int i = 2; i < argc; i++) {
+        if      (strcmp("--fps", argv[i]) == 0 && i+1 < argc)  fps = atoi(argv[++i]);
+        else usage();
+    }
+    if (fps < 1 || fps > 100)
+        usage();
+
+    if (!monitor_open(&monitor, path)) {
+        fprintf(stderr, "dashboard: %s: %s\n", path,
+                errno == EINVAL ? "not a monitor of this build's" : strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    initscr();
+    cbreak();
+    noecho();
+    curs_set(0);
+    keypad(stdscr, true);
+
+    long frame_ms = 1000 / fps;
+    long next_frame = now_ms();
+    start_rates(next_frame);
+    for (;;) {
+        long now = now_ms();
+        if (now >= next_frame) {
+            read_statuses();
+            if (now - base_ms >= RATE_MS && !reopen(now))
+                update_rates(now);
+
+            erase();
+            draw_summary(now);
+            draw_boards(draw_loads(2, now));
+            refresh();
+            next_frame += frame_ms;
+            if (next_frame <= now)  // fell behind (the terminal's slow)
+                next_frame = now + frame_ms;
+        }
+
+        // Waiting for a key is what paces the frames
+        timeout((int) (next_frame - now_ms() > 0 ? next_frame - now_ms() : 0));
+        if (getch() == 'q')
+            break;
+    }
+
+    endwin();
+    monitor_close(&monitor);
+    return 0;
+}
@@ -0,0 +1,401 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "checkers.h"
+
+/* datagen plays the engine against itself and writes the positions it
+ * searched, with the search's score and the game's result, as training data
+ * for the evaluation (see "training.c" in checkers.h for the format).
+ *
+ * Usage: datagen DIR [options]
+ *   --positions N    how many positions to write (default 1000000)
+ *   --depth N        how deep the engine searches (default 6)
+ *   --random N       plies played at random at the start of each game, so
+ *                    that the games differ (default 8)
+ *   --threads N      games played at a time (default: one per core)
+ *   --chunk N        positions per file (default 1048576)
+ *   --bloom MB       size of the duplicate filter (default 64)
+ *   --monitor FILE   publish what each thread is playing in FILE, for
+ *                    dashboard to show
+ *
+ * The positions go into files DIR/positions-00000.bin, -00001 and so on (the
+ * numbers already taken are skipped), each a chunk of positions in random
+ * order: the positions of a game are all alike, and training wants them
+ * spread out.  Positions that were already written (the opening ones, most
+ * of all) are left out; they're recognized with a Bloom filter, which only
+ * takes a few bits per position but now and then takes a new position for
+ * an old one.
+ *
+ * The games are played on several threads, which hand full chunks to a
+ * writer thread and go on playing while it shuffles and writes them.  At
+ * most MAXQUEUED chunks wait for it; when the disk can't keep up, the
+ * players wait. */
+
+static long target = 1000000;
+static int depth = 6;
+static int random_plies = 8;
+static int chunk_size = 1 << 20;
+static size_t bloom_mb = 64;
+static const char *monitor_file = NULL;
+
+#define MAXPLIES 300
+#define MAXQUEUED 2
+
+
+// {{{ Bloom filter
+/* A position is BLOOM_PROBES bits of the filter, picked by its hash; it was
+ * seen before if they're all set already.  Bits are only ever set, with
+ * atomic ORs, so the threads share it without locking. */
+#define BLOOM_PROBES 4
+
+typedef struct {
+    _Atomic uint64_t *words;
+    uint64_t mask;  // bits - 1
+} Bloom;
+
+static bool bloom_init(Bloom *bloom, size_t megabytes)
+{
+    uint64_t bits = 64;
+    while (bits * 2 <= (uint64_t) megabytes << 23)
+        bits *= 2;
+    bloom->words = calloc(bits / 64, sizeof(uint64_t));
+    bloom->mask = bits - 1;
+    return bloom->words != NULL;
+}
+
+/* bloom_add adds the position with the given hash; returns whether it was
+ * (probably) there already */
+static bool bloom_add(Bloom *bloom, uint64_t hash)
+{
+    // The probes step by an odd amount from the hash's low half, with the
+    // high half mixed in (double hashing)
+    uint64_t step = ((hash >> 32) * 0x9E3779B97F4A7C15ull) | 1;
+    bool seen = true;
+    for (int i = 0; i < BLOOM_PROBES; i++) {
+        uint64_t bit = (hash + i * step) & bloom->mask;
+        uint64_t mask = 1ull << (bit % 64);
+        if (!(atomic_fetch_or_explicit(&bloom->words[bit / 64], mask,
+                                       memory_order_relaxed) & mask))
+            seen = false;
+    }
+    return seen;
+}
+// }}}
+
+
+// {{{ Chunks and the writer
+typedef struct Chunk {
+    struct Chunk *next;
+    int count;
+    Packed_position positions[];
+} Chunk;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    Chunk *filling;               // the one the players add positions to
+    Chunk *full, *full_last;      // waiting to be written
+    int queued;
+    Chunk *spare;                 // written ones, to be filled again
+    bool finished;                // no more chunks will come
+
+    const char *directory;
+    int next_file;
+    bool failed;                  // couldn't write a file
+
+    Bloom bloom;
+    long positions, duplicates, games;  // (under the lock)
+    long reported_ms;
+
+    Monitor monitor;           // if monitor_file was given
+    atomic_int next_worker;    // the players' slots in it
+} Exporter;
+
+static Chunk *new_chunk(Exporter *exporter)
+{
+    Chunk *chunk = exporter->spare;
+    if (chunk != NULL)
+        exporter->spare = chunk->next;
+    else
+        chunk = malloc(sizeof(Chunk) + chunk_size * sizeof(Packed_position));
+    if (chunk != NULL)
+        chunk->count = 0;
+    return chunk;
+}
+
+/* queue_chunk hands the chunk being filled to the writer, waiting if too
+ * many are waiting already.  Called with the lock held. */
+static bool queue_chunk(Exporter *exporter)
+{
+    while (exporter->queued == MAXQUEUED && !exporter->failed)
+        pthread_cond_wait(&exporter->changed, &exporter->lock);
+
+    Chunk *chunk = exporter->filling;
+    chunk->next = NULL;
+    if (exporter->full == NULL)  exporter->full = chunk;
+    else                         exporter->full_last->next = chunk;
+    exporter->full_last = chunk;
+    exporter->queued++;
+    pthread_cond_broadcast(&exporter->changed);
+
+    exporter->filling = new_chunk(exporter);
+    return exporter->filling != NULL && !exporter->failed;
+}
+
+/* write_chunk shuffles the chunk and writes it to the next free file */
+static bool write_chunk(Exporter *exporter, Chunk *chunk, uint64_t *seed)
+{
+    for (int i = chunk->count - 1; i > 0; i--) {
+        int j = next_random(seed) % (i + 1);
+        Packed_position swap = chunk->positions[i];
+        chunk->positions[i] = chunk->positions[j];
+        chunk->positions[j] = swap;
+    }
+
+    char path[4096];
+    int fd;
+    do {
+        snprintf(path, sizeof(path), "%s/positions-%05d.bin", exporter->directory,
+                 exporter->next_file++);
+        fd = open(path, O_WRONLY | O_CREAT | O_EXCL, 0644);
+    } while (fd < 0 && errno == EEXIST);
+    if (fd < 0) {
+        perror(path);
+        return false;
+    }
+
+    Training_header header;
+    training_header(&header, chunk->count);
+    bool ok = write_all(fd, &header, sizeof(header))
+           && write_all(fd, chunk->positions, chunk->count * sizeof(Packed_position));
+    if (close(fd) != 0 || !ok) {
+        perror(path);
+        return false;
+    }
+    return true;
+}
+
+static void *writer_thread(void *arg)
+{
+    Exporter *exporter = arg;
+    uint64_t seed = 0x2545F4914F6CDD1Dull ^ (uint64_t) now_ms();
+
+    pthread_mutex_lock(&exporter->lock);
+    for (;;) {
+        while (exporter->full == NULL && !exporter->finished)
+            pthread_cond_wait(&exporter->changed, &exporter->lock);
+        Chunk *chunk = exporter->full;
+        if (chunk == NULL)
+            break;
+        exporter->full = chunk->next;
+        pthread_mutex_unlock(&exporter->lock);
+
+        bool ok = write_chunk(exporter, chunk, &seed);
+
+        pthread_mutex_lock(&exporter->lock);
+        exporter->queued--;
+        if (!ok)
+            exporter->failed = true;
+        chunk->next = exporter->spare;
+        exporter->spare = chunk;
+        pthread_cond_broadcast(&exporter->changed);
+    }
+    pthread_mutex_unlock(&exporter->lock);
+    return NULL;
+}
+// }}}
+
+
+// {{{ Self-play
+typedef struct {
+    Game_state state;
+    double score;
+} Sample;
+
+/* export_game adds a game's positions, the ones not seen before, to the
+ * chunk being filled; returns false when no more are wanted */
+static bool export_game(Exporter *exporter, Sample *samples, int nsamples, Situation result)
+{
+    pthread_mutex_lock(&exporter->lock);
+    bool more = !exporter->failed && exporter->filling != NULL;
+    for (int i = 0; i < nsamples && more && exporter->positions < target; i++) {
+        if (bloom_add(&exporter->bloom, samples[i].state.hash)) {
+            exporter->duplicates++;
+            continue;
+        }
+        Chunk *chunk = exporter->filling;
+        pack_position(&samples[i].state, samples[i].score, result,
+                      &chunk->positions[chunk->count++]);
+        exporter->positions++;
+        if (chunk->count == chunk_size)
+            more = queue_chunk(exporter);
+    }
+    exporter->games++;
+    more = more && exporter->positions < target;
+    if (monitor_file != NULL)
+        atomic_store(&exporter->monitor.header->produced, exporter->positions);
+    if (now_ms() - exporter->reported_ms >= 1000 || !more) {
+        fprintf(stderr, "\r%ld positions, %ld duplicates, %ld games", exporter->positions,
+                exporter->duplicates, exporter->games);
+        exporter->reported_ms = now_ms();
+    }
+    pthread_mutex_unlock(&exporter->lock);
+    return more;
+}
+
+/* publish tells the monitor, if there's one, what the player is up to.
+ * It's a few dozen bytes copied once a movement, next to a search. */
+static void publish(Exporter *exporter, int worker, Worker_status *status, Game_state *state)
+{
+    if (monitor_file == NULL)
+        return;
+    game_to_text(state, status->position);
+    status->updated_ms = now_ms();
+    monitor_publish(&exporter->monitor, worker, status);
+}
+
+static void *play_thread(void *arg)
+{
+    Exporter *exporter = arg;
+    uint64_t seed = 0x9E3779B97F4A7C15ull ^ (uint64_t) now_ms() ^ (uint64_t) (uintptr_t) &seed;
+    int worker = atomic_fetch_add(&exporter->next_worker, 1);
+    Worker_status status;
+    memset(&status, 0, sizeof(status));
+
+    // Search holds a whole History, so it's better off on the heap
+    Search *searcher = malloc(sizeof(Search));
+    Sample *samples = malloc(MAXPLIES * sizeof(Sample));
+    Ttable tt;
+    bool ok = searcher != NULL && samples != NULL && tt_init(&tt, 16);
+
+    for (bool more = ok; more; ) {
+        Game_state state;
+        game_setup(&state);
+        History history;
+        history_init(&history, DEFAULT_NO_PROGRESS_LIMIT);
+        int nsamples = 0;
+        status.ply = 0;
+        status.score = 0;
+        publish(exporter, worker, &status, &state);
+
+        for (int ply = 0; ply < MAXPLIES && state.situation == ONGOING; ply++) {
+            Move_list moves;
+            generate_moves(&state, &moves);
+            if (moves.length == 0) {
+                state.situation = state.current_player == WHITE ? BLACK_WINS : WHITE_WINS;
+                break;
+            }
+
+            Move move;
+            if (ply < random_plies) {
+                move = moves.array[next_random(&seed) % moves.length];
+            } else {
+                search_init(searcher, depth, 0, &tt, &history);
+                samples[nsamples].score = search(&state, searcher);
+                samples[nsamples++].state = state;
+                move = searcher->best;
+                double score = samples[nsamples - 1].score;
+                status.score = state.current_player == WHITE ? score : -score;
+            }
+            history_push(&history, &state);
+            game_apply_move(&state, &move);
+            update_draw_situation(&state, &history);
+            status.plies++;
+            status.ply = ply + 1;
+            publish(exporter, worker, &status, &state);
+        }
+
+        Situation result = state.situation == ONGOING ? TIE : state.situation;
+        long waited = now_ms();
+        more = export_game(exporter, samples, nsamples, result);
+        status.waiting_ms += now_ms() - waited;
+        status.games++;
+    }
+
+    if (ok)
+        tt_free(&tt);
+    free(searcher);
+    free(samples);
+    return NULL;
+}
+// }}}
+
+
+static void usage()
+{
+    fprintf(stderr, "usage: datagen DIR [--positions N] [--depth N] [--random N]"
+                    " [--threads N] [--chunk N] [--bloom MB] [--monitor FILE]\n");
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+        usage();
+
+    int threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    for (int i = 2; i < argc; i++) {
+        if      (strcmp("--positions", argv[i]) == 0 && i+1 < argc)  target = atol(argv[++i]);
+        else if (strcmp("--depth", argv[i]) == 0 && i+1 < argc)      depth = atoi(argv[++i]);
+        else if (strcmp("--random", argv[i]) == 0 && i+1 < argc)     random_plies = atoi(argv[++i]);
+        else if (strcmp("--threads", argv[i]) == 0 && i+1 < argc)    threads = atoi(argv[++i]);
+        else if (strcmp("--chunk", argv[i]) == 0 && i+1 < argc)      chunk_size = atoi(argv[++i]);
+        else if (strcmp("--bloom", argv[i]) == 0 && i+1 < argc)      bloom_mb = atol(argv[++i]);
+        else if (strcmp("--monitor", argv[i]) == 0 && i+1 < argc)    monitor_file = argv[++i];
+        else usage();
+    }
+    if (threads < 1)
+        threads = 1;
+    if (threads > MONITOR_MAXWORKERS)
+        threads = MONITOR_MAXWORKERS;
+    if (chunk_size < 1)
+        chunk_size = 1;
+
+    static Exporter exporter;
+    pthread_mutex_init(&exporter.lock, NULL);
+    pthread_cond_init(&exporter.changed, NULL);
+    exporter.directory = argv[1];
+    exporter.filling = new_chunk(&exporter);
+    if (exporter.filling == NULL || !bloom_init(&exporter.bloom, bloom_mb)) {
+        fprintf(stderr, "out of memory\n");
+        return EXIT_FAILURE;
+    }
+    if (monitor_file != NULL && !monitor_create(&exporter.monitor, monitor_file, threads)) {
+        perror(monitor_file);
+        return EXIT_FAILURE;
+    }
+
+    pthread_t writer;
+    if (pthread_create(&writer, NULL, writer_thread, &exporter) != 0) {
+        perror("pthread_create");
+        return EXIT_FAILURE;
+    }
+    pthread_t *pool = malloc(threads * sizeof(pthread_t));
+    int started = 0;
+    for (; pool != NULL && started < threads; started++)
+        if (pthread_create(&pool[started], NULL, play_thread, &exporter) != 0)
+            break;
+    if (started == 0)
+        play_thread(&exporter);  // no threads: play right here
+    for (int t = 0; t < started; t++)
+        pthread_join(pool[t], NULL);
+
+    // What's left goes into a last, smaller chunk
+    pthread_mutex_lock(&exporter.lock);
+    if (exporter.filling != NULL && exporter.filling->count > 0 && !exporter.failed)
+        queue_chunk(&exporter);
+    exporter.finished = true;
+    pthread_cond_broadcast(&exporter.changed);
+    pthread_mutex_unlock(&exporter.lock);
+    pthread_join(writer, NULL);
+
+    if (monitor_file != NULL) {
+        atomic_store(&exporter.monitor.header->finished, 1);
+        monitor_close(&exporter.monitor);
+    }
+    fprintf(stderr, "\n");
+    return exporter.failed ? EXIT_FAILURE : 0;
+}
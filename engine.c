@@ -0,0 +1,135 @@
+#include <stdio.h>
+#include <string.h>
+#include "checkers.h"
+
+/* engine_thread is what runs on the engine's own thread: one search of the
+ * position given to engine_start. */
+static void *engine_thread(void *arg)
+{
+    Engine *engine = arg;
+    if (engine->mcts_threads > 0)
+        mcts(&engine->state, &engine->search, engine->mcts_threads, MCTS_DEFAULT_NODES);
+    else
+        search(&engine->state, &engine->search);
+    atomic_store(&engine->done, true);
+    return NULL;
+}
+
+/* engine_init is the Engine's constructor; the limits are used for every
+ * search it does (see search_init), and all of them share a transposition
+ * table of hash_mb megabytes.  (If the table can't be allocated the engine
+ * just searches without one.) */
+void engine_init(Engine *engine, int max_depth, long movetime_ms, size_t hash_mb)
+{
+    engine->max_depth = max_depth;
+    engine->movetime_ms = movetime_ms;
+    engine->mcts_threads = 0;
+    tt_init(&engine->tt, hash_mb);
+    engine->running = false;
+    engine->pondering = false;
+    atomic_init(&engine->done, true);
+}
+
+/* engine_free stops whatever the engine is doing and frees its table. */
+void engine_free(Engine *engine)
+{
+    Move ignored;
+    engine_stop(engine);
+    engine_wait(engine, &ignored);
+    tt_free(&engine->tt);
+}
+
+static void engine_launch(Engine *engine, Game_state *state, History *history,
+                          long movetime_ms)
+{
+    game_copy(&engine->state, state);
+    search_init(&engine->search, engine->max_depth, movetime_ms, &engine->tt, history);
+    atomic_store(&engine->done, false);
+
+    // If no thread can be created, search right here instead: the interface
+    // freezes while it thinks but the game can still go on.
+    if (pthread_create(&engine->thread, NULL, engine_thread, engine) != 0)
+        engine_thread(engine);
+    else
+        engine->running = true;
+}
+
+static bool same_position(Game_state *a, Game_state *b)
+{
+    return a->hash == b->hash && a->current_player == b->current_player
+        && memcmp(a->board, b->board, sizeof(a->board)) == 0;
+}
+
+/* engine_start starts searching (a copy of) the given position, which the
+ * game got to through the positions in 'history'.
+ * If the engine was pondering exactly this position (the opponent played
+ * the expected movement), the ponder search just carries on, now with the
+ * usual time limit counting from here -- so the time spent pondering comes
+ * for free.  If it was pondering something else, that search is dropped; what
+ * it stored in the transposition table stays there and helps the new one. */
+void engine_start(Engine *engine, Game_state *state, History *history)
+{
+    if (engine->pondering) {
+        engine->pondering = false;
+        if (same_position(&engine->state, state)) {
+            if (engine->movetime_ms > 0)
+                atomic_store(&engine->search.deadline_ms, now_ms() + engine->movetime_ms);
+            return;
+        }
+        Move ignored;
+        engine_stop(engine);
+        engine_wait(engine, &ignored);
+    }
+
+    engine_launch(engine, state, history, engine->movetime_ms);
+}
+
+/* engine_ponder makes the engine think on the opponent's time: 'state' is the
+ * position right after the engine's own movement, and the engine guesses the
+ * reply (from what its last search found) and starts searching the resulting
+ * position with no time limit.  The search goes on until engine_start is
+ * called with the actual position.  Returns false if there was nothing to
+ * guess, in which case the engine stays idle. */
+bool engine_ponder(Engine *engine, Game_state *state, History *history)
+{
+    Move reply;
+    if (state->situation != ONGOING
+     || !search_expected_reply(&engine->tt, state, &reply))
+        return false;
+
+    Game_state expected;
+    game_copy(&expected, state);
+    game_apply_move(&expected, &reply);
+    if (expected.situation != ONGOING)
+        return false;
+
+    // The game will have gone through 'state' before getting to 'expected'
+    History expected_history = *history;
+    history_push(&expected_history, state);
+
+    engine_launch(engine, &expected, &expected_history, 0);
+    engine->pondering = true;
+    return true;
+}
+
+bool engine_done(Engine *engine)
+{
+    return atomic_load(&engine->done);
+}
+
+/* engine_stop makes the search end as soon as possible; the engine then
+ * plays the best movement of the deepest search it finished. */
+void engine_stop(Engine *engine)
+{
+    atomic_store(&engine->search.stop, true);
+}
+
+/* engine_wait waits for the search to end and stores its movement in 'move'. */
+void engine_wait(Engine *engine, Move *move)
+{
+    if (engine->running) {
+        pthread_join(engine->thread, NULL);
+        engine->running = false;
+    }
+    *move = engine->search.best;
+}
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "checkers.h"
 
 
@@ -12,19 +13,104 @@ void game_copy(Game_state* to, Game_state* from)
 Piece get_piece(Game_state *state, Position pos)
 {
     return is_valid_position(pos)
-         ? state->board[pos.row][pos.col]
+         ? (Piece) state->board[pos.row][pos.col]
          : -1;
 }
 
 
+static uint64_t mirror_key(Position, Piece);
+
 void set_piece(Game_state *state, Position pos, Piece piece)
 {
-    if (is_valid_position(pos))
+    if (is_valid_position(pos)) {
+        state->hash ^= zobrist_key(pos, (Piece) state->board[pos.row][pos.col])
+                     ^ zobrist_key(pos, piece);
+        state->mirror_hash ^= mirror_key(pos, (Piece) state->board[pos.row][pos.col])
+                            ^ mirror_key(pos, piece);
+#ifdef NNUE
+        nnue_update(state, pos, (Piece) state->board[pos.row][pos.col], piece);
+#endif
         state->board[pos.row][pos.col] = piece;
+    }
+}
+
+
+// The key XORed into the hash when black is the current player
+#define BLACK_TO_MOVE_KEY 0x9E3779B97F4A7C15ull
+
+/* zobrist_key gives the (pseudo-random) key of having 'piece' at 'pos'.
+ * Instead of a table of random numbers filled at startup, the key is
+ * computed by scrambling the (square, piece) pair with the splitmix64
+ * finalizer: it's just as good for hashing, costs a few multiplications and
+ * has no state to set up.  Empty squares don't change the hash. */
+uint64_t zobrist_key(Position pos, Piece piece)
+{
+    if (piece == EMPTY)
+        return 0;
+    uint64_t x = ((uint64_t) (pos.row * BOARD_SIZE + pos.col) << 3 | piece)
+               * BLACK_TO_MOVE_KEY;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+uint64_t game_hash(Game_state *state)
+{
+    uint64_t hash = state->current_player == BLACK ? BLACK_TO_MOVE_KEY : 0;
+    Position p;
+    for (p.row = 0; p.row < BOARD_SIZE; p.row++)
+        for (p.col = 0; p.col < BOARD_SIZE; p.col++)
+            hash ^= zobrist_key(p, get_piece(state, p));
+    return hash;
+}
+
+/* The mirror image of a position is the same position with the board
+ * turned around (by 180 degrees, which takes dark squares to dark squares)
+ * and the colors swapped, the other player to move: each player has
+ * exactly the same movements there as in the position, and so the same
+ * prospects.  'mirror_hash' is the hash the mirror image would have, kept
+ * up to date alongside 'hash': mirror_key is the key of what a (square,
+ * piece) becomes in it. */
+static uint64_t mirror_key(Position pos, Piece piece)
+{
+    if (piece == EMPTY)
+        return 0;
+    Position turned = { BOARD_SIZE - 1 - pos.row, BOARD_SIZE - 1 - pos.col };
+    return zobrist_key(turned, is_white(piece) ? piece + 1 : piece - 1);
+}
+
+uint64_t game_mirror_hash(Game_state *state)
+{
+    uint64_t hash = state->current_player == WHITE ? BLACK_TO_MOVE_KEY : 0;
+    Position p;
+    for (p.row = 0; p.row < BOARD_SIZE; p.row++)
+        for (p.col = 0; p.col < BOARD_SIZE; p.col++)
+            hash ^= mirror_key(p, get_piece(state, p));
+    return hash;
+}
+
+/* game_rehash computes both hashes from scratch, for when the board was
+ * written without set_piece */
+void game_rehash(Game_state *state)
+{
+    state->hash = game_hash(state);
+    state->mirror_hash = game_mirror_hash(state);
+}
+
+/* game_key is the key of a position and its mirror image alike, for tables
+ * that can keep what they know about both in one entry: the smaller of the
+ * two hashes.  'mirrored' tells whether it's the mirror image's, in which
+ * case what the entry says about white is about black here, and the other
+ * way around. */
+uint64_t game_key(Game_state *state, bool *mirrored)
+{
+    *mirrored = state->mirror_hash < state->hash;
+    return *mirrored ? state->mirror_hash : state->hash;
 }
 
 // game_setup reads this to initailize the board
-char initial_board[BOARD_SIZE][BOARD_SIZE+1] = {
+#if BOARD_SIZE == 8
+static const char initial_board[BOARD_SIZE][BOARD_SIZE+1] = {
     "o o o o ",  // white pieces
     " o o o o",
     "o o o o ",
@@ -34,6 +120,20 @@ char initial_board[BOARD_SIZE][BOARD_SIZE+1] = {
     "* * * * ",
     " * * * *",
 };
+#else
+static const char initial_board[BOARD_SIZE][BOARD_SIZE+1] = {
+    "o o o o o ",  // white pieces
+    " o o o o o",
+    "o o o o o ",
+    " o o o o o",
+    "          ",
+    "          ",
+    "* * * * * ",  // black pieces
+    " * * * * *",
+    "* * * * * ",
+    " * * * * *",
+};
+#endif
 
 void game_setup(Game_state *state)
 { 
@@ -46,9 +146,14 @@ void game_setup(Game_state *state)
                 case '*': set_piece(state, p, BLACK_STONE); break;
                  
             }
-    // Game rule: white goes first
-    state->current_player = WHITE;
+    // Game rule: white goes first (except in variants where black does)
+    state->current_player = RULE_FIRST_PLAYER;
     state->situation = ONGOING;
+    state->reversible_moves = 0;
+    game_rehash(state);
+#ifdef NNUE
+    nnue_refresh(state);
+#endif
 }
 
 
@@ -78,6 +183,8 @@ void switch_player(Game_state *state)
         state->current_player = BLACK;
     else
         state->current_player = WHITE;
+    state->hash ^= BLACK_TO_MOVE_KEY;
+    state->mirror_hash ^= BLACK_TO_MOVE_KEY;
 }
 
 
@@ -85,10 +192,10 @@ void switch_player(Game_state *state)
  * the board into dames. */
 void upgrade_stones_to_dames(Game_state *state)
 {
-    Position top    = { 7, 0 };
+    Position top    = { BOARD_SIZE - 1, 0 };
     Position bottom = { 0, 0 };
 
-    for (int col = 0; col < 7; col++) {
+    for (int col = 0; col < BOARD_SIZE; col++) {
         top.col = col;
         Piece attop = get_piece(state, top);
         if (attop == WHITE_STONE)
@@ -103,8 +210,12 @@ void upgrade_stones_to_dames(Game_state *state)
  
 void perform_movement(Game_state *state, Position src, Position dest)
 {
+    // Moving a stone can't be undone, so it counts as progress
+    Piece moved = get_piece(state, src);
+    bool progress = is_stone(moved);
+
     // Move the piece
-    set_piece(state, dest, get_piece(state, src));
+    set_piece(state, dest, moved);
     set_piece(state, src, EMPTY);
 
     // Perform the captures along the way... 
@@ -116,10 +227,18 @@ void perform_movement(Game_state *state, Position src, Position dest)
     Position captured = { src.row + vstep, src.col + hstep };
     for (int i = 1; i < distance; i++)
     {
+        // ... and so does capturing
+        if (!is_empty(get_piece(state, captured)))
+            progress = true;
         set_piece(state, captured, EMPTY);
         captured.row += vstep;
         captured.col += hstep;
     }
+
+    // A turn is either a single movement or a sequence of captures, so
+    // counting here counts turns
+    if (progress)  state->reversible_moves = 0;
+    else           state->reversible_moves++;
 }
 
 void game_update(Game_state* state, Position src, Position dest) {
@@ -144,8 +263,90 @@ void game_update(Game_state* state, Position src, Position dest) {
     update_situation(state);
 }
 
+/* The History is a ring buffer: only the last MAXHISTORY positions are kept,
+ * which is plenty, since positions from before the last capture or stone
+ * movement can't come back anyway (and the no-progress limit should be well
+ * under MAXHISTORY). */
+
+void history_init(History *history, int no_progress_limit)
+{
+    history->length = 0;
+    history->no_progress_limit = no_progress_limit;
+}
+
+void history_push(History *history, Game_state *state)
+{
+    history->hashes[history->length++ % MAXHISTORY] = state->hash;
+}
+
+void history_pop(History *history)
+{
+    history->length--;
+}
+
+/* history_repetitions counts how many times the position occurred before.
+ * Only the positions since the last capture or stone movement can be the
+ * same, and only every other one has the same player to move, so that's
+ * all that is looked at. */
+int history_repetitions(History *history, Game_state *state)
+{
+    int back = state->reversible_moves;
+    if (back > history->length)      back = history->length;
+    if (back > MAXHISTORY)           back = MAXHISTORY;
+
+    int count = 0;
+    for (int distance = 2; distance <= back; distance += 2)
+        if (history->hashes[(history->length - distance) % MAXHISTORY] == state->hash)
+            count++;
+    return count;
+}
+
+/* history_is_draw tells whether the game is drawn in the position: no
+ * progress for too long, or the position has occurred 'occurrences' times
+ * (counting this one). */
+bool history_is_draw(History *history, Game_state *state, int occurrences)
+{
+    return state->reversible_moves >= history->no_progress_limit
+        || history_repetitions(history, state) + 1 >= occurrences;
+}
+
+/* update_draw_situation is update_situation's complement for games that keep
+ * a History: it declares the game a TIE when it's drawn by threefold
+ * repetition or the no-progress limit.  'history' has the positions before
+ * the current one. */
+void update_draw_situation(Game_state *state, History *history)
+{
+    if (state->situation == ONGOING && history_is_draw(history, state, 3))
+        state->situation = TIE;
+}
+
+/* perform_step performs one step of a Move: the whole movement if it's a
+ * regular one, or one of the captures in a sequence.  It's perform_movement
+ * plus, in variants where stones are promoted in the middle of a capture
+ * sequence, the promotion. */
+void perform_step(Game_state *state, Position src, Position dest)
+{
+    perform_movement(state, src, dest);
+#if RULE_PROMOTION == PROMOTE_DURING_CAPTURE
+    upgrade_stones_to_dames(state);
+#endif
+}
+
+/* game_apply_move plays a whole turn: the piece goes through every position
+ * in the move's path (capturing along the way), stones that made it to the
+ * other side become dames, and it's the other player's turn. */
+void game_apply_move(Game_state *state, Move *move)
+{
+    for (int i = 1; i < move->length; i++)
+        perform_step(state, move->path[i-1], move->path[i]);
+    upgrade_stones_to_dames(state);
+    switch_player(state);
+    update_situation(state);
+}
+
 // used when printing the board
-char background[8][9] = {
+#if BOARD_SIZE == 8
+static const char background[BOARD_SIZE][BOARD_SIZE+1] = {
     "_ _ _ _ ",
     " _ _ _ _",
     "_ _ _ _ ",
@@ -155,9 +356,24 @@ char background[8][9] = {
     "_ _ _ _ ",
     " _ _ _ _",
 };
+#else
+static const char background[BOARD_SIZE][BOARD_SIZE+1] = {
+    "_ _ _ _ _ ",
+    " _ _ _ _ _",
+    "_ _ _ _ _ ",
+    " _ _ _ _ _",
+    "_ _ _ _ _ ",
+    " _ _ _ _ _",
+    "_ _ _ _ _ ",
+    " _ _ _ _ _",
+    "_ _ _ _ _ ",
+    " _ _ _ _ _",
+};
+#endif
 
-// used to convert pieces into characters when printing the board
-char piece_to_char[] = {
+// used to convert pieces into characters when printing the board (and by
+// the interface, to draw them)
+const char piece_to_char[] = {
     [EMPTY]       = ' ',
     [WHITE_STONE] = 'o',
     [BLACK_STONE] = '*',
@@ -174,16 +390,16 @@ void game_print(Game_state *state, int indent)
     print_indentation(indent);
     // Column index on top
     printf("  ");
-    for (int col = 0; col < 8; col++)
+    for (int col = 0; col < BOARD_SIZE; col++)
         printf("%d ", col);
     printf("\n");
 
-    for (int row = 0; row < 8; row++)
+    for (int row = 0; row < BOARD_SIZE; row++)
     {
         print_indentation(indent);
         // Row index on left
         printf("%d ", row);
-        for (int col = 0; col < 8; col++)
+        for (int col = 0; col < BOARD_SIZE; col++)
         {
             Position pos = { row, col };
             char piece_icon = piece_to_char[get_piece(state, pos)];
@@ -197,7 +413,7 @@ void game_print(Game_state *state, int indent)
     print_indentation(indent);
     // Column index on bottom
     printf("  ");
-    for (int col = 0; col < 8; col++)
+    for (int col = 0; col < BOARD_SIZE; col++)
         printf("%d ", col);
     printf("\n");
 
@@ -206,3 +422,67 @@ void game_print(Game_state *state, int indent)
     if (state->current_player == WHITE) printf("white (o@)\n");
     else                                printf("black (*X)\n");
 }
+
+
+/* game_to_text writes the position as a line of text (see checkers.h) into
+ * 'text' and returns it. */
+char *game_to_text(Game_state *state, char *text)
+{
+    char *c = text;
+    for (int row = BOARD_SIZE - 1; row >= 0; row--)
+    {
+        for (int col = 0; col < BOARD_SIZE; col++)
+        {
+            Position pos = { row, col };
+            Piece piece = get_piece(state, pos);
+            *c++ = is_empty(piece) ? '.' : piece_to_char[piece];
+        }
+        if (row > 0)  *c++ = '/';
+    }
+    *c++ = ' ';
+    *c++ = state->current_player == WHITE ? 'w' : 'b';
+    *c = '\0';
+    return text;
+}
+
+
+/* game_from_text sets the game up with the position in 'text' (as written
+ * by game_to_text).  Nothing is known about how the game got there, so it's
+ * taken as if the last turn made progress.  Returns false (leaving the
+ * state in some unspecified position) if the text isn't a position. */
+bool game_from_text(Game_state *state, const char *text)
+{
+    const char *c = text;
+    for (int row = BOARD_SIZE - 1; row >= 0; row--)
+    {
+        for (int col = 0; col < BOARD_SIZE; col++, c++)
+        {
+            Piece piece = EMPTY;
+            if (*c != '.')
+            {
+                for (piece = WHITE_STONE; piece < EMPTY; piece++)
+                    if (piece_to_char[piece] == *c)
+                        break;
+                if (piece == EMPTY)
+                    return false;
+            }
+            state->board[row][col] = piece;
+        }
+        if (row > 0 && *c++ != '/')
+            return false;
+    }
+
+    if (*c++ != ' ')
+        return false;
+    if      (*c == 'w')  state->current_player = WHITE;
+    else if (*c == 'b')  state->current_player = BLACK;
+    else                 return false;
+
+    state->reversible_moves = 0;
+    game_rehash(state);
+#ifdef NNUE
+    nnue_refresh(state);
+#endif
+    update_situation(state);
+    return true;
+}
@@ -0,0 +1,68 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "checkers.h"
+
+/* game_stats tells what the game store knows about a position: how many of
+ * the games recorded (with checkers --record) got there, and how they ended.
+ *
+ * Usage: game_stats DIR [move...]          the position after these moves
+ *        game_stats DIR --position TEXT    any position (see game_to_text)
+ *
+ * With no moves it's the initial position, i.e. all the games.  Each answer
+ * is one lookup in the memory-mapped index; the games themselves aren't
+ * read. */
+
+static void usage()
+{
+    fprintf(stderr, "usage: game_stats DIR [move... | --position TEXT]\n");
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+        usage();
+
+    Game_state state;
+    game_setup(&state);
+    for (int i = 2; i < argc; i++) {
+        Move move;
+        if (strcmp(argv[i], "--position") == 0 && i + 1 < argc) {
+            if (!game_from_text(&state, argv[++i])) {
+                fprintf(stderr, "not a position: %s\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+        }
+        else if (move_from_text(&state, argv[i], &move))
+            game_apply_move(&state, &move);
+        else {
+            fprintf(stderr, "illegal move: %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    Game_store store;
+    if (!store_open(&store, argv[1], STORE_DEFAULT_ENTRIES)) {
+        perror(argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    char text[POSITION_TEXT_LENGTH];
+    printf("%s\n", game_to_text(&state, text));
+
+    Position_stats stats;
+    if (store_lookup(&store, &state, &stats)) {
+        printf("%u games: white won %u, black won %u, %u ties, %u unfinished\n",
+               stats.games, stats.white_wins, stats.black_wins, stats.ties,
+               stats.games - stats.white_wins - stats.black_wins - stats.ties);
+    } else {
+        printf("no games\n");
+    }
+    printf("(%llu games, %llu positions in the store)\n",
+           (unsigned long long) atomic_load(&store.index->games),
+           (unsigned long long) atomic_load(&store.index->used));
+
+    store_close(&store);
+    return 0;
+}
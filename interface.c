@@ -31,6 +31,16 @@ typedef struct {
     int desty,   destx;
     bool chose_src;
     bool chose_dest;
+
+    /* What's currently drawn in the window, so bspace_show only has to
+     * redraw the squares that changed since the last frame (moved or captured
+     * pieces, the cursor, the source and destination markers).  'shown' holds
+     * the three characters (with attributes) of each square; 'drawn' is false
+     * when nothing can be assumed about the window's contents, which makes
+     * the next bspace_show draw everything, frame included. */
+    chtype shown[BOARD_SIZE][BOARD_SIZE][3];
+    Color shown_player;
+    bool drawn;
 } Board_space;
 
 // TODO since these y and x coordinates won't reflect actual screen
@@ -54,22 +64,32 @@ void bspace_reset()
 {
     bspace.srcy = bspace.srcx = 0;
     bspace.desty = bspace.destx = 0;
-    bspace.playery = bspace.playerx = 0;
+    // Off the board, so no cursor is shown until someone places it
+    bspace.playery = bspace.playerx = -1;
     bspace.chose_src = false;
     bspace.chose_dest = false;
 }
 
+/* bspace_invalidate makes the next bspace_show redraw the whole board space
+ * instead of only the squares that changed. */
+void bspace_invalidate()
+{
+    bspace.drawn = false;
+}
+
 /* bspace_init is like the constructor.  */
 void bspace_init()
 {
     bspace.win = newwin(LINES/2, COLS/2, 0, 0);
     bspace_reset();
+    bspace_invalidate();
 }
 
 /* The isblacksquare bool array is a lookup table
  * that tells whether the given position is black or not.
  * In particular, it implements a checkerboard pattern.
  */
+#if BOARD_SIZE == 8
 bool isblacksquare[BOARD_SIZE][BOARD_SIZE] = {
     { true, false, true, false, true, false, true, false },
     { false, true, false, true, false, true, false, true },
@@ -80,87 +100,157 @@ bool isblacksquare[BOARD_SIZE][BOARD_SIZE] = {
     { true, false, true, false, true, false, true, false },
     { false, true, false, true, false, true, false, true },
 };
+// Frame top and bottom -- 3*8 hyphens (each square is 3 characters wide)
+#define FRAME_TOP    ".------------------------."
+#define FRAME_BOTTOM "'------------------------'"
+#else
+bool isblacksquare[BOARD_SIZE][BOARD_SIZE] = {
+    { true, false, true, false, true, false, true, false, true, false },
+    { false, true, false, true, false, true, false, true, false, true },
+    { true, false, true, false, true, false, true, false, true, false },
+    { false, true, false, true, false, true, false, true, false, true },
+    { true, false, true, false, true, false, true, false, true, false },
+    { false, true, false, true, false, true, false, true, false, true },
+    { true, false, true, false, true, false, true, false, true, false },
+    { false, true, false, true, false, true, false, true, false, true },
+    { true, false, true, false, true, false, true, false, true, false },
+    { false, true, false, true, false, true, false, true, false, true },
+};
+// Frame top and bottom -- 3*10 hyphens
+#define FRAME_TOP    ".------------------------------."
+#define FRAME_BOTTOM "'------------------------------'"
+#endif
 // With the current implementation the board will have its colors inverted,
 // because currently the code sets A_REVERSE on when it's a black square,
 // which makes sense for the light color schemes that I use, but will
 // make the square white on terminals with a dark background.
 // TODO display the board corretly on terminals with light AND dark background.
 
-/* piece_to_char associates each piece with a character that displays it. */
-char piece_to_char[] = {
-    [EMPTY]       = ' ',
-    [WHITE_STONE] = 'o',
-    [BLACK_STONE] = '*',
-    [WHITE_DAME]  = '@',
-    [BLACK_DAME]  = 'X'
+/* board_square computes the three characters (left padding, piece, right
+ * padding, with their attributes) that display the square at row, col. */
+static void board_square(Game_state *state, int row, int col, chtype square[3])
+{
+    chtype attrs = isblacksquare[row][col] ? A_REVERSE : 0;
+    Position pos = { row, col };
+    square[0] = ' ' | attrs;
+    square[1] = (chtype) piece_to_char[get_piece(state, pos)] | attrs;
+    square[2] = ' ' | attrs;
+}
 
-};
+/* board_frame draws the frame around a board whose top left corner (the
+ * frame's) is at y, x. */
+static void board_frame(WINDOW *win, int y, int x)
+{
+    mvwaddstr(win, y, x, FRAME_TOP);
+    for (int line = 1; line <= BOARD_SIZE; line++) {
+        mvwaddch(win, y + line, x, '|');                     // Frame left
+        mvwaddch(win, y + line, x + 3*BOARD_SIZE + 1, '|');  // Frame right
+    }
+    mvwaddstr(win, y + BOARD_SIZE + 1, x, FRAME_BOTTOM);
+}
+
+/* board_show draws a whole board, frame and all, with its top left corner
+ * at y, x of 'win' -- for programs that show boards other than the board
+ * space's (the dashboard's grid of games, say).  It takes BOARD_LINES by
+ * BOARD_COLS characters. */
+void board_show(WINDOW *win, int y, int x, Game_state *state)
+{
+    board_frame(win, y, x);
+    for (int row = 0; row < BOARD_SIZE; row++) {
+        wmove(win, y + BOARD_SIZE - row, x + 1);
+        for (int col = 0; col < BOARD_SIZE; col++) {
+            chtype square[3];
+            board_square(state, row, col, square);
+            for (int i = 0; i < 3; i++)
+                waddch(win, square[i]);
+        }
+    }
+}
+
+/* bspace_square computes the three characters that display the square at
+ * row, col of the board space: board_square's, with the player's marks. */
+static void bspace_square(Game_state *state, int row, int col, chtype square[3])
+{
+    board_square(state, row, col, square);
+
+    // Left and right padding around the piece
+    chtype left  = ' ';
+    chtype right = ' ';
+    chtype attrs = square[1] & A_ATTRIBUTES;
+    /* The padding also indicates player (with [] around), source (with < at the left)
+     * and destination (with > at the left) positions.
+     */
+    /* [TODO consider alternative to < and > symbols:
+     * language-dependent mnemonics defined in language.c
+     * (like 's' for source and 'd' for destination)]
+     */
+    /* The /order/ of the following IFs matters with respect to the padding:
+     * its effect is that, on the same square,
+     * player cursor [] overwrites destination symbol > overwrites source symbol <.
+     */
+    if (bspace.chose_src && row==bspace.srcy && col==bspace.srcx) {
+        attrs |= A_BLINK;
+        left = '<';
+    }
+    if (bspace.chose_dest && row==bspace.desty && col==bspace.destx) {
+        attrs |= A_BLINK;
+        left = '>';
+    }
+    if (row == bspace.playery && col == bspace.playerx) {
+        left  = '[';
+        right = ']';
+    }
+
+    square[0] = left | attrs;
+    square[1] = (square[1] & A_CHARTEXT) | attrs;
+    square[2] = right | attrs;
+}
 
 /* bspace_show() loads the visual representation of the board
- * space into its window.
+ * space into its window.  Only what changed since the previous call is
+ * written to the window (see the 'shown' component of Board_space), so that
+ * moving the cursor around costs a couple of squares instead of a whole
+ * board on slow terminals.
  */
 void bspace_show(Game_state *state)
 {   // {{{
-    wmove(bspace.win, 0, 0);
-
-    // Frame top -- 3*8 hyphens (each square is 3 characters wide)
-    waddstr(bspace.win, ".------------------------.\n");
-
-    for (int row = 7; row >= 0; row--) {
-        waddch(bspace.win, '|');  // Frame left
+    if (!bspace.drawn) {
+        werase(bspace.win);
+        board_frame(bspace.win, 0, 0);
+    }
 
+    for (int row = 0; row < BOARD_SIZE; row++) {
         for (int col = 0; col < BOARD_SIZE; col++) {
-            // Left and right padding around the piece
-            chtype left  = ' ';
-            chtype right = ' ';
-            /* The padding also indicates player (with [] around), source (with < at the left)
-             * and destination (with > at the left) positions.
-             */
-            /* [TODO consider alternative to < and > symbols:
-             * language-dependent mnemonics defined in language.c
-             * (like 's' for source and 'd' for destination)]
-             */
-            /* The /order/ of the following IFs matters with respect to the padding:
-             * its effect is that, on the same square,
-             * player cursor [] overwrites destination symbol > overwrites source symbol <.
-             */
-            if (bspace.chose_src && row==bspace.srcy && col==bspace.srcx) {
-                wattron(bspace.win, A_BLINK);
-                left = '<';
-            }
-            if (bspace.chose_dest && row==bspace.desty && col==bspace.destx) {
-                wattron(bspace.win, A_BLINK);
-                left = '>';
-            } 
-            if (row == bspace.playery && col == bspace.playerx) {
-                left  = '[';
-                right = ']';
+            chtype square[3];
+            bspace_square(state, row, col, square);
+
+            chtype *shown = bspace.shown[row][col];
+            bool changed = !bspace.drawn || square[0] != shown[0]
+                        || square[1] != shown[1] || square[2] != shown[2];
+            if (!changed)
+                continue;
+
+            // The last row is at the top, just under the frame
+            wmove(bspace.win, BOARD_SIZE - row, 1 + 3*col);
+            for (int i = 0; i < 3; i++) {
+                waddch(bspace.win, square[i]);
+                shown[i] = square[i];
             }
-
-            if (isblacksquare[row][col])
-                wattron(bspace.win, A_REVERSE);
-
-            waddch(bspace.win, left);
-            Position pos = { row, col };
-            waddch(bspace.win, piece_to_char[get_piece(state, pos)]);
-            waddch(bspace.win, right);
-
-            // Turn off all attributes that might have been turned on
-            wattroff(bspace.win, A_BLINK | A_UNDERLINE | A_REVERSE);
         }
-        waddch(bspace.win, '|');  // Frame right
-        waddch(bspace.win, '\n');
     }
 
-    // Frame bottom
-    waddstr(bspace.win, "'------------------------'\n");
-
     // Show current player
-    waddstr(bspace.win, getmsg(CURRENT_PLAYER, language));
-    Message cur_player_msg = state->current_player == WHITE
-                          ? WHITE_PLAYER : BLACK_PLAYER;
-    waddstr(bspace.win, getmsg(cur_player_msg, language));
-    waddch(bspace.win, '\n');
+    if (!bspace.drawn || state->current_player != bspace.shown_player) {
+        wmove(bspace.win, BOARD_SIZE + 2, 0);
+        wclrtoeol(bspace.win);
+        waddstr(bspace.win, getmsg(CURRENT_PLAYER, language));
+        Message cur_player_msg = state->current_player == WHITE
+                              ? WHITE_PLAYER : BLACK_PLAYER;
+        waddstr(bspace.win, getmsg(cur_player_msg, language));
+        bspace.shown_player = state->current_player;
+    }
+
+    bspace.drawn = true;
 }   // }}}
 
 
@@ -223,10 +313,12 @@ void msgwin_init()
 
 /* msgwin_print prints the given message on the messages window.
  * It overwrites the previous message.
+ * (werase rather than wclear: wclear would make the next refresh repaint the
+ * whole terminal.)
  */
 void msgwin_print(char *msg)
 {
-    wclear(msgwin);
+    werase(msgwin);
     wmove(msgwin, 0, 0);
     waddstr(msgwin, msg);
 }
@@ -256,6 +348,9 @@ void setup_interface()
     cbreak();
     noecho();
     curs_set(0);
+    // The first refresh of stdscr clears the terminal; doing it here, once,
+    // means refresh_interface never has to touch stdscr.
+    refresh();
     msgwin_init();
     instrwin_init();
     bspace_init();
@@ -271,17 +366,17 @@ void close_interface()
     endwin();
 }
 
-/* refresh_interface updates the screen */
+/* refresh_interface updates the screen.
+ * The windows are only copied to the virtual screen with wnoutrefresh, and
+ * then doupdate sends the terminal whatever changed in all of them at once,
+ * instead of one burst of output per window like wrefresh would. */
 void refresh_interface(Game_state *state)
 {
-    /* This is *the correct order* in which to call these functions.
-     * [Not sure precisely why; with other orders only a second call to
-     * refresh_interface would display the board for the first time.] */
     bspace_show(state);
-    refresh();
-    wrefresh(bspace.win);
-    wrefresh(msgwin);
-    wrefresh(instrwin);
+    wnoutrefresh(bspace.win);
+    wnoutrefresh(msgwin);
+    wnoutrefresh(instrwin);
+    doupdate();
 }
 
 
@@ -383,7 +478,42 @@ done:
     dest->row = bspace.desty;
     dest->col = bspace.destx;
 
-    wclear(msgwin);
+    werase(msgwin);
 }   // }}}
-// }}}
 
+
+/* get_engine_movement lets the engine search for its movement (on its own
+ * thread) while the interface keeps showing how the search is going, and
+ * stores the movement in 'move'.  Pressing 'n' makes the engine stop
+ * searching and play the best movement it has found so far. */
+void get_engine_movement(Game_state *state, History *history, Engine *engine,
+                         Move *move)
+{   //{{{
+    bspace_reset();
+    engine_start(engine, state, history);
+
+    // wgetch waits at most this long, so the search info is updated often
+    wtimeout(bspace.win, 100);
+    while (!engine_done(engine))
+    {
+        char info[128];
+        snprintf(info, sizeof(info), getmsg(ENGINE_THINKING, language),
+                 atomic_load(&engine->search.depth),
+                 atomic_load(&engine->search.score),
+                 atomic_load(&engine->search.nodes));
+        msgwin_print(info);
+        refresh_interface(state);
+
+        if (wgetch(bspace.win) == 'n')
+            engine_stop(engine);
+    }
+    wtimeout(bspace.win, -1);
+
+    engine_wait(engine, move);
+
+    char move_str[10*MAXPATH], msg[10*MAXPATH + 64];
+    snprintf(msg, sizeof(msg), getmsg(ENGINE_PLAYED, language),
+             write_move(move, move_str));
+    msgwin_print(msg);
+}   // }}}
+// }}}
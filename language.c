@@ -22,7 +22,10 @@ static char *msgs[NLANGS][NMESSAGES] = {
             "m para marcar origem do movimento\n"
             "m marcar para selecionar destino\n"
             "u para desmarcar\n"
-            "espaço para confirmar o movimento\n",
+            "espaço para confirmar o movimento\n"
+            "n para o computador jogar agora\n",
+        [ENGINE_THINKING] = "Pensando... profundidade %d, valor %+.1f, %ld nos",
+        [ENGINE_PLAYED] = "O computador jogou %s",
     },
     [EN] = {
         [SOURCE_PROMPT] = "> Source: ",
@@ -44,7 +47,10 @@ static char *msgs[NLANGS][NMESSAGES] = {
             "m to mark movement source\n"
             "m again to mark movement destination\n"
             "u to unmark\n"
-            "SPACE to confirm movement\n",
+            "SPACE to confirm movement\n"
+            "n to make the engine move now\n",
+        [ENGINE_THINKING] = "Thinking... depth %d, score %+.1f, %ld nodes",
+        [ENGINE_PLAYED] = "The engine played %s",
     },
 };
 
@@ -0,0 +1,167 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "checkers.h"
+#include "libcheckers.h"
+
+/* The library's games (see libcheckers.h) on top of the engine, for the
+ * board size this is built for: build.sh builds it once for each size, and
+ * libcheckers_api.c hands every game to its own size's checkers_board_N.
+ * Each Lib_game is a whole game, so nothing here is shared between games;
+ * the engine itself only has constant tables. */
+
+typedef struct {
+    Game_state state;
+    History history;   // the positions before the current one
+    Ttable tt;
+    bool has_tt;
+    Search search;     // holds a whole History, so it's better off in here
+} Lib_game;
+
+_Static_assert(POSITION_TEXT_LENGTH <= CHECKERS_POSITION_TEXT, "CHECKERS_POSITION_TEXT is too small");
+_Static_assert(MOVE_TEXT_LENGTH <= CHECKERS_MOVE_TEXT, "CHECKERS_MOVE_TEXT is too small");
+
+static void lib_reset(void *);
+
+static void *lib_new(size_t hash_mb)
+{
+    Lib_game *game = malloc(sizeof(Lib_game));
+    if (game == NULL)
+        return NULL;
+
+    game->has_tt = hash_mb > 0;
+    if (game->has_tt && !tt_init(&game->tt, hash_mb)) {
+        free(game);
+        return NULL;
+    }
+    search_init(&game->search, 0, 0, NULL, NULL);
+    lib_reset(game);
+    return game;
+}
+
+static void lib_free(void *data)
+{
+    Lib_game *game = data;
+    if (game->has_tt)
+        tt_free(&game->tt);
+    free(game);
+}
+
+static void lib_reset(void *data)
+{
+    Lib_game *game = data;
+    game_setup(&game->state);
+    history_init(&game->history, DEFAULT_NO_PROGRESS_LIMIT);
+}
+
+static bool lib_set_position(void *data, const char *text)
+{
+    Lib_game *game = data;
+    Game_state state;
+    if (!game_from_text(&state, text))
+        return false;
+
+    game->state = state;
+    history_init(&game->history, DEFAULT_NO_PROGRESS_LIMIT);
+    return true;
+}
+
+static char *lib_position(void *data, char *text, size_t size)
+{
+    Lib_game *game = data;
+    char position[POSITION_TEXT_LENGTH];
+    snprintf(text, size, "%s", game_to_text(&game->state, position));
+    return text;
+}
+
+static int lib_moves(void *data, char *text, size_t size)
+{
+    Lib_game *game = data;
+    Move_list moves;
+    generate_moves(&game->state, &moves);
+
+    size_t used = 0;
+    if (size > 0)
+        text[0] = '\0';
+    for (int i = 0; i < moves.length; i++) {
+        char move[MOVE_TEXT_LENGTH];
+        move_to_text(&moves.array[i], moves.type, move);
+        size_t length = strlen(move) + (i > 0);
+        if (used + length >= size)
+            break;
+        used += snprintf(text + used, size - used, "%s%s", i > 0 ? " " : "", move);
+    }
+    return moves.length;
+}
+
+static int lib_result(void *);
+
+static bool lib_play(void *data, const char *text)
+{
+    Lib_game *game = data;
+    Move move;
+    if (lib_result(game) != CHECKERS_ONGOING
+        || !move_from_text(&game->state, text, &move))
+        return false;
+
+    history_push(&game->history, &game->state);
+    game_apply_move(&game->state, &move);
+    update_draw_situation(&game->state, &game->history);
+    return true;
+}
+
+/* update_situation only counts pieces; a player who can't move has lost too */
+static int lib_result(void *data)
+{
+    Lib_game *game = data;
+    Game_state *state = &game->state;
+    if (state->situation == ONGOING) {
+        Move_list moves;
+        generate_moves(state, &moves);
+        if (moves.length == 0)
+            return state->current_player == WHITE ? CHECKERS_BLACK_WINS : CHECKERS_WHITE_WINS;
+    }
+
+    switch (state->situation) {
+    case WHITE_WINS: return CHECKERS_WHITE_WINS;
+    case BLACK_WINS: return CHECKERS_BLACK_WINS;
+    case TIE:        return CHECKERS_TIE;
+    default:         return CHECKERS_ONGOING;
+    }
+}
+
+static double lib_search(void *data, int max_depth, long movetime_ms,
+                         char *move, size_t size)
+{
+    Lib_game *game = data;
+    if (size > 0)
+        move[0] = '\0';
+    if (lib_result(game) != CHECKERS_ONGOING)
+        return 0;
+
+    Search *searcher = &game->search;
+    search_init(searcher, max_depth, movetime_ms, game->has_tt ? &game->tt : NULL,
+                &game->history);
+    double score = search(&game->state, searcher);
+
+    Move_list moves;
+    generate_moves(&game->state, &moves);
+    char text[MOVE_TEXT_LENGTH];
+    snprintf(move, size, "%s", move_to_text(&searcher->best, moves.type, text));
+    return score;
+}
+
+static void lib_stop(void *data)
+{
+    Lib_game *game = data;
+    atomic_store(&game->search.stop, true);
+}
+
+#if BOARD_SIZE == 8
+const Checkers_board checkers_board_8 = {
+#else
+const Checkers_board checkers_board_10 = {
+#endif
+    BOARD_SIZE, lib_new, lib_free, lib_reset, lib_set_position, lib_position,
+    lib_moves, lib_play, lib_result, lib_search, lib_stop,
+};
@@ -0,0 +1,93 @@
+#ifndef LIBCHECKERS_H
+#define LIBCHECKERS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* libcheckers is the engine without the interface -- the rules, the search
+ * and the evaluation -- as a library to embed in other programs (build.sh
+ * builds libcheckers.a and libcheckers.so).  This is all a program using it
+ * needs to include; checkers.h stays the engine's own business.
+ *
+ * Everything a game needs is in its Checkers, made by checkers_new: the
+ * position, the positions before it (for draws by repetition), and the
+ * transposition table its searches use.  The library has no other state, so
+ * a program can have as many games as it likes, each used by one thread at
+ * a time.  The only call that may be made on a game while another thread
+ * is using it is checkers_stop, to end that thread's checkers_search.
+ *
+ * Each game is on the board it was made for, 8x8 or 10x10: the library
+ * has the engine built for both (with no board size checks in its loops),
+ * and one program can play on both at once.  The rules are the ones the
+ * library was built with (see checkers.h).  Positions and movements are
+ * written as text, the same way as everywhere else:
+ *   position  "......../......../......../...X..../......../..o...../......../........ w"
+ *             (on 8x8) the rows from the top down, '.' for empty squares, 'o' and '*'
+ *             for white and black stones, '@' and 'X' for white and black
+ *             dames, and 'w' or 'b' for who moves
+ *   movement  "c3-d4", or "c3xe5xc7" for captures ("a1" is the bottom left)
+ */
+
+typedef struct Checkers Checkers;
+
+typedef enum {
+    CHECKERS_ONGOING,
+    CHECKERS_WHITE_WINS,
+    CHECKERS_BLACK_WINS,
+    CHECKERS_TIE
+} Checkers_result;
+
+// Big enough for any position's or movement's text
+#define CHECKERS_POSITION_TEXT 128
+#define CHECKERS_MOVE_TEXT     128
+
+#if defined(__GNUC__)
+#define CHECKERS_API __attribute__((visibility("default")))
+#else
+#define CHECKERS_API
+#endif
+
+/* checkers_new makes a game on a board_size x board_size board (8 or 10) at
+ * the starting position, whose searches have a transposition table of
+ * hash_mb megabytes (0 for none).  Returns NULL if there isn't enough
+ * memory, or for another board size. */
+CHECKERS_API Checkers *checkers_new  (int board_size, size_t hash_mb);
+CHECKERS_API void      checkers_free (Checkers *);
+CHECKERS_API int       checkers_board_size (Checkers *);
+
+/* checkers_reset goes back to the starting position; checkers_set_position
+ * starts the game again from the position in 'text' (returning false and
+ * leaving the game as it was if it isn't a position).  Either way the
+ * positions before are forgotten. */
+CHECKERS_API void checkers_reset        (Checkers *);
+CHECKERS_API bool checkers_set_position (Checkers *, const char *text);
+
+/* checkers_position writes the current position into 'text' (at most
+ * 'size' chars, CHECKERS_POSITION_TEXT is always enough) and returns it. */
+CHECKERS_API char *checkers_position (Checkers *, char *text, size_t size);
+
+/* checkers_moves writes the movements the player to move can make, separated
+ * by spaces, into 'text' (at most 'size' chars; as many as fit) and returns
+ * how many there are. */
+CHECKERS_API int checkers_moves (Checkers *, char *text, size_t size);
+
+/* checkers_play makes a movement; returns false (changing nothing) if it
+ * can't be made in the current position or the game is over. */
+CHECKERS_API bool checkers_play (Checkers *, const char *move);
+
+CHECKERS_API Checkers_result checkers_result (Checkers *);
+
+/* checkers_search looks for the best movement in the current position, up
+ * to max_depth plies (0 for no limit) and for movetime_ms milliseconds (0
+ * for no limit; at least one of them should be given), and writes it into
+ * 'move' (at most 'size' chars).  Returns its score for the player to move
+ * (positive is good for them; a stone is worth about 10), or leaves 'move'
+ * empty if the game is over.  It doesn't make the movement. */
+CHECKERS_API double checkers_search (Checkers *, int max_depth, long movetime_ms,
+                                     char *move, size_t size);
+
+/* checkers_stop makes the game's checkers_search, running on another
+ * thread, return right away with the best movement it has so far. */
+CHECKERS_API void checkers_stop (Checkers *);
+
+#endif
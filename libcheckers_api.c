@@ -0,0 +1,88 @@
+#include <stdlib.h>
+#include "checkers.h"
+#include "libcheckers.h"
+
+/* The library's API (see libcheckers.h).  The engine is built once for
+ * each board size (see libcheckers.c), so a Checkers is just which of them
+ * a game was made for, and the game itself; everything else is passed on
+ * to that size's build.  Nothing is shared between games. */
+
+struct Checkers {
+    const Checkers_board *board;
+    void *game;
+};
+
+Checkers *checkers_new(int board_size, size_t hash_mb)
+{
+    const Checkers_board *board;
+    switch (board_size) {
+    case 8:  board = &checkers_board_8;  break;
+    case 10: board = &checkers_board_10; break;
+    default: return NULL;
+    }
+
+    Checkers *checkers = malloc(sizeof(Checkers));
+    if (checkers == NULL)
+        return NULL;
+    checkers->board = board;
+    checkers->game = board->new_game(hash_mb);
+    if (checkers->game == NULL) {
+        free(checkers);
+        return NULL;
+    }
+    return checkers;
+}
+
+void checkers_free(Checkers *checkers)
+{
+    if (checkers == NULL)
+        return;
+    checkers->board->free_game(checkers->game);
+    free(checkers);
+}
+
+int checkers_board_size(Checkers *checkers)
+{
+    return checkers->board->board_size;
+}
+
+void checkers_reset(Checkers *checkers)
+{
+    checkers->board->reset(checkers->game);
+}
+
+bool checkers_set_position(Checkers *checkers, const char *text)
+{
+    return checkers->board->set_position(checkers->game, text);
+}
+
+char *checkers_position(Checkers *checkers, char *text, size_t size)
+{
+    return checkers->board->position(checkers->game, text, size);
+}
+
+int checkers_moves(Checkers *checkers, char *text, size_t size)
+{
+    return checkers->board->moves(checkers->game, text, size);
+}
+
+bool checkers_play(Checkers *checkers, const char *move)
+{
+    return checkers->board->play(checkers->game, move);
+}
+
+Checkers_result checkers_result(Checkers *checkers)
+{
+    return (Checkers_result) checkers->board->result(checkers->game);
+}
+
+double checkers_search(Checkers *checkers, int max_depth, long movetime_ms,
+                       char *move, size_t size)
+{
+    return checkers->board->search(checkers->game, max_depth, movetime_ms, move, size);
+}
+
+void checkers_stop(Checkers *checkers)
+{
+    checkers->board->stop(checkers->game);
+}
@@ -0,0 +1,105 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "checkers.h"
+
+/* match plays the alpha-beta search (search) against Monte Carlo tree search
+ * (mcts), both with the same time per movement, to see how they compare on
+ * this machine.
+ *
+ * Usage: match [--games N] [--movetime MS] [--threads N] [--random N]
+ *   --games N      games to play (default 10), alternating colors
+ *   --movetime MS  time per movement (default 500)
+ *   --threads N    threads for mcts (default 1); alpha-beta always has one
+ *   --random N     plies played at random to start each game (default 4),
+ *                  the same for each pair of games
+ */
+
+static int ngames = 10;
+static long movetime = 500;
+static int threads = 1;
+static int random_plies = 4;
+
+#define MAXPLIES 300
+
+/* play_game plays one game; returns its Situation */
+static Situation play_game(Color mcts_color, unsigned opening, Ttable *tt, Search *searcher)
+{
+    Game_state state;
+    game_setup(&state);
+    History history;
+    history_init(&history, DEFAULT_NO_PROGRESS_LIMIT);
+    srand(opening);
+
+    for (int ply = 0; ply < MAXPLIES && state.situation == ONGOING; ply++) {
+        Move_list moves;
+        generate_moves(&state, &moves);
+        if (moves.length == 0)
+            return state.current_player == WHITE ? BLACK_WINS : WHITE_WINS;
+
+        Move move;
+        if (ply < random_plies) {
+            move = moves.array[rand() % moves.length];
+        } else {
+            search_init(searcher, 0, movetime, tt, &history);
+            if (state.current_player == mcts_color)
+                mcts(&state, searcher, threads, MCTS_DEFAULT_NODES);
+            else
+                search(&state, searcher);
+            move = searcher->best;
+        }
+        history_push(&history, &state);
+        game_apply_move(&state, &move);
+        update_draw_situation(&state, &history);
+    }
+    return state.situation == ONGOING ? TIE : state.situation;
+}
+
+static void usage()
+{
+    fprintf(stderr, "usage: match [--games N] [--movetime MS] [--threads N] [--random N]\n");
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++) {
+        if      (strcmp("--games", argv[i]) == 0 && i+1 < argc)     ngames = atoi(argv[++i]);
+        else if (strcmp("--movetime", argv[i]) == 0 && i+1 < argc)  movetime = atol(argv[++i]);
+        else if (strcmp("--threads", argv[i]) == 0 && i+1 < argc)   threads = atoi(argv[++i]);
+        else if (strcmp("--random", argv[i]) == 0 && i+1 < argc)    random_plies = atoi(argv[++i]);
+        else usage();
+    }
+
+    Ttable tt;
+    tt_init(&tt, 64);
+    Search *searcher = malloc(sizeof(Search));
+    if (searcher == NULL)
+        return EXIT_FAILURE;
+
+    int mcts_wins = 0, search_wins = 0, ties = 0;
+    for (int game = 0; game < ngames; game++) {
+        Color mcts_color = game % 2 == 0 ? WHITE : BLACK;
+        tt_clear(&tt);
+        Situation result = play_game(mcts_color, 1 + game / 2, &tt, searcher);
+
+        const char *winner = "tie";
+        if (result == TIE) {
+            ties++;
+        } else if ((result == WHITE_WINS) == (mcts_color == WHITE)) {
+            mcts_wins++;
+            winner = "mcts";
+        } else {
+            search_wins++;
+            winner = "alpha-beta";
+        }
+        printf("game %d: mcts plays %s, %s\n", game + 1,
+               mcts_color == WHITE ? "white" : "black", winner);
+        fflush(stdout);
+    }
+    printf("mcts %d, alpha-beta %d, ties %d\n", mcts_wins, search_wins, ties);
+
+    free(searcher);
+    tt_free(&tt);
+    return 0;
+}
@@ -0,0 +1,327 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include "checkers.h"
+
+/* Monte Carlo tree search: instead of looking at every movement to a fixed
+ * depth, play lots of random games (playouts) from the position and grow a
+ * tree towards the movements whose playouts go best.  Each iteration walks
+ * down the tree choosing children by UCT (the win rate so far plus a bonus
+ * for children that haven't been tried much), adds the children of the node
+ * it ends at, plays a random game from there and counts its result in every
+ * node on the way back up.
+ *
+ * Several threads work on the same tree.  The counts are atomic, and a thread
+ * walking through a node adds a "virtual loss" to it until its playout is
+ * counted, so that the others are steered towards other parts of the tree
+ * meanwhile instead of all piling onto the same path. */
+
+/* Nodes come from one arena allocated per search, the children of a node
+ * next to each other.  Nodes don't hold positions: a thread replays the
+ * movements from the root as it walks down.  'wins' counts in halves (2 for
+ * a win, 1 for a draw), for the player who made the movement into the node. */
+typedef struct {
+    _Atomic int32_t children;   // index of the first child; NOT_EXPANDED or EXPANDING
+    uint16_t nchildren;
+    uint8_t move;               // index in the parent's generate_moves list
+    _Atomic int32_t visits;
+    _Atomic int32_t virtual_losses;
+    _Atomic int64_t wins;
+} Mcts_node;
+
+#define NOT_EXPANDED -1
+#define EXPANDING    -2
+
+typedef struct {
+    Mcts_node *nodes;
+    int32_t capacity;
+    _Atomic int32_t used;
+    Game_state *root_state;
+    Search *search;
+    _Atomic int max_depth;
+} Mcts_tree;
+
+// The weight of the exploration bonus in UCT
+#define UCT_EXPLORATION 1.4
+// Playouts that go on longer than this are taken as draws
+#define MAXPLAYOUT 300
+
+
+
+/* playout plays random movements from 'state' until the game ends, and tells
+ * how it went for 'player' (2 win, 1 draw, 0 loss).
+ * Regular movements are picked straight from generate_mov_options, which is
+ * much cheaper than building whole Moves; only when there are captures (which
+ * may go on in sequences, with rules depending on the variant) does it ask
+ * generate_moves for the complete ones. */
+static int playout(Game_state *state, Color player, uint64_t *seed)
+{
+    for (int ply = 0; ply < MAXPLAYOUT; ply++) {
+        if (state->situation != ONGOING)
+            break;
+        if (state->reversible_moves >= DEFAULT_NO_PROGRESS_LIMIT)
+            return 1;
+
+        Mov_options options;
+        generate_mov_options(state, &options);
+        if (options.length == 0)
+            return state->current_player == player ? 0 : 2;
+
+        Move move;
+        if (options.type == REGULAR) {
+            int total = 0;
+            for (int i = 0; i < options.length; i++)
+                total += options.array[i].length;
+            int pick = next_random(seed) % total;
+            for (int i = 0; pick >= 0; i++) {
+                Dest_options *dests = &options.array[i];
+                if (pick < dests->length) {
+                    move.path[0] = dests->src;
+                    move.path[1] = dests->array[pick];
+                    move.length = 2;
+                }
+                pick -= dests->length;
+            }
+        } else {
+            Move_list moves;
+            generate_moves(state, &moves);
+            move = moves.array[next_random(seed) % moves.length];
+        }
+        game_apply_move(state, &move);
+    }
+
+    if (state->situation == WHITE_WINS)  return player == WHITE ? 2 : 0;
+    if (state->situation == BLACK_WINS)  return player == BLACK ? 2 : 0;
+    return 1;
+}
+
+
+/* expand gives the node its children, one per movement in 'moves'.  Only one
+ * thread gets to do it; the others carry on as if the node were a leaf.
+ * Returns false if it didn't (or the arena is full). */
+static bool expand(Mcts_tree *tree, Mcts_node *node, Move_list *moves)
+{
+    int32_t expected = NOT_EXPANDED;
+    if (moves->length == 0
+     || !atomic_compare_exchange_strong(&node->children, &expected, EXPANDING))
+        return false;
+
+    int32_t first = atomic_fetch_add(&tree->used, moves->length);
+    if (first + moves->length > tree->capacity) {
+        atomic_store(&node->children, NOT_EXPANDED);
+        return false;
+    }
+
+    for (int i = 0; i < moves->length; i++) {
+        Mcts_node *child = &tree->nodes[first + i];
+        atomic_init(&child->children, NOT_EXPANDED);
+        child->nchildren = 0;
+        child->move = (uint8_t) i;
+        atomic_init(&child->visits, 0);
+        atomic_init(&child->virtual_losses, 0);
+        atomic_init(&child->wins, 0);
+    }
+    node->nchildren = (uint16_t) moves->length;
+    atomic_store_explicit(&node->children, first, memory_order_release);
+    return true;
+}
+
+/* select_child picks the child with the best UCT value; children no one has
+ * tried yet come first.  Virtual losses count as visits that were lost. */
+static Mcts_node *select_child(Mcts_tree *tree, Mcts_node *node, uint64_t *seed)
+{
+    int32_t first = atomic_load_explicit(&node->children, memory_order_acquire);
+    Mcts_node *children = &tree->nodes[first];
+    double parent_visits = atomic_load_explicit(&node->visits, memory_order_relaxed)
+                         + atomic_load_explicit(&node->virtual_losses, memory_order_relaxed);
+    double log_parent = log(parent_visits + 1);
+
+    Mcts_node *best = NULL;
+    double best_value = -1;
+    int offset = next_random(seed) % node->nchildren;  // so that ties differ
+    for (int k = 0; k < node->nchildren; k++) {
+        Mcts_node *child = &children[(k + offset) % node->nchildren];
+        double visits = atomic_load_explicit(&child->visits, memory_order_relaxed)
+                      + atomic_load_explicit(&child->virtual_losses, memory_order_relaxed);
+        if (visits == 0)
+            return child;
+        double wins = atomic_load_explicit(&child->wins, memory_order_relaxed) / 2.0;
+        double value = wins / visits + UCT_EXPLORATION * sqrt(log_parent / visits);
+        if (value > best_value) {
+            best_value = value;
+            best = child;
+        }
+    }
+    return best;
+}
+
+/* iterate does one iteration of the search: down the tree, expand, playout,
+ * and back up. */
+static void iterate(Mcts_tree *tree, uint64_t *seed)
+{
+    Mcts_node *path[MAXHISTORY];
+    Color movers[MAXHISTORY];   // who made the movement into each node
+    int length = 0;
+
+    Game_state state;
+    game_copy(&state, tree->root_state);
+    Mcts_node *node = &tree->nodes[0];
+    path[length++] = node;
+    atomic_fetch_add_explicit(&node->virtual_losses, 1, memory_order_relaxed);
+
+    while (state.situation == ONGOING && length < MAXHISTORY) {
+        Move_list moves;
+        generate_moves(&state, &moves);
+        if (atomic_load_explicit(&node->children, memory_order_acquire) < 0) {
+            // A leaf: give it children (if no one else is), and go on to
+            // one of them for the playout
+            if (!expand(tree, node, &moves))
+                break;
+        }
+
+        node = select_child(tree, node, seed);
+        movers[length] = state.current_player;
+        path[length++] = node;
+        atomic_fetch_add_explicit(&node->virtual_losses, 1, memory_order_relaxed);
+        game_apply_move(&state, &moves.array[node->move]);
+        if (atomic_load_explicit(&node->visits, memory_order_relaxed) == 0)
+            break;  // new here: this is where the playout starts
+    }
+
+    int depth = length - 1;
+    int max_depth = atomic_load_explicit(&tree->max_depth, memory_order_relaxed);
+    while (depth > max_depth
+        && !atomic_compare_exchange_weak(&tree->max_depth, &max_depth, depth))
+        ;
+
+    // The playout's result for white, and then for whoever moved into each node
+    int white_result = playout(&state, WHITE, seed);
+    for (int i = 0; i < length; i++) {
+        Mcts_node *visited = path[i];
+        int result = i == 0 || movers[i] == WHITE ? white_result : 2 - white_result;
+        atomic_fetch_add_explicit(&visited->wins, result, memory_order_relaxed);
+        atomic_fetch_add_explicit(&visited->visits, 1, memory_order_relaxed);
+        atomic_fetch_sub_explicit(&visited->virtual_losses, 1, memory_order_relaxed);
+    }
+    atomic_fetch_add_explicit(&tree->search->nodes, 1, memory_order_relaxed);
+}
+
+/* most_visited is the root's child the search believes in the most. */
+static Mcts_node *most_visited(Mcts_tree *tree)
+{
+    Mcts_node *root = &tree->nodes[0];
+    int32_t first = atomic_load(&root->children);
+    if (first < 0)
+        return NULL;
+
+    Mcts_node *best = &tree->nodes[first];
+    for (int i = 1; i < root->nchildren; i++)
+        if (atomic_load(&tree->nodes[first + i].visits) > atomic_load(&best->visits))
+            best = &tree->nodes[first + i];
+    return best;
+}
+
+/* The score shown for an MCTS search is its win rate, scaled to look like
+ * evaluate's scores: +-100 for certain wins and losses, 0 for even chances. */
+static double win_rate_score(Mcts_node *node)
+{
+    int32_t visits = atomic_load(&node->visits);
+    return visits > 0 ? (atomic_load(&node->wins) / (2.0 * visits) - 0.5) * 200 : 0;
+}
+
+typedef struct {
+    Mcts_tree *tree;
+    uint64_t seed;
+    bool reports;  // this thread keeps the Search's score and depth up to date
+} Mcts_worker;
+
+static void *mcts_thread(void *arg)
+{
+    Mcts_worker *worker = arg;
+    Mcts_tree *tree = worker->tree;
+    Search *search = tree->search;
+
+    for (long i = 1; ; i++) {
+        if (atomic_load_explicit(&search->stop, memory_order_relaxed))
+            break;
+        if (atomic_load_explicit(&tree->used, memory_order_relaxed) >= tree->capacity) {
+            atomic_store(&search->stop, true);  // nothing more to learn
+            break;
+        }
+        iterate(tree, &worker->seed);
+
+        if (i % 256 == 0) {
+            long deadline = atomic_load_explicit(&search->deadline_ms, memory_order_relaxed);
+            if (deadline > 0 && now_ms() >= deadline)
+                atomic_store(&search->stop, true);
+            Mcts_node *best = most_visited(tree);
+            if (worker->reports && best != NULL) {
+                atomic_store(&search->score, win_rate_score(best));
+                atomic_store(&search->depth, atomic_load(&tree->max_depth));
+            }
+        }
+    }
+    return NULL;
+}
+
+/* mcts searches the position like search does -- same limits (except that
+ * there's no depth: without a time limit it runs until stopped, or until
+ * 'max_nodes' nodes are in the tree), same results in 'search', with the
+ * depth being how deep the tree got and the score the best movement's win
+ * rate -- but with Monte Carlo tree search on 'threads' threads. */
+double mcts(Game_state *state, Search *search, int threads, int32_t max_nodes)
+{
+    Move_list moves;
+    generate_moves(state, &moves);
+    if (moves.length == 0)
+        return -WIN_SCORE;
+    search->best = moves.array[0];
+    if (moves.length == 1)
+        return 0;  // nothing to think about
+
+    Mcts_tree tree = { .capacity = max_nodes, .root_state = state, .search = search };
+    tree.nodes = malloc(max_nodes * sizeof(Mcts_node));
+    if (tree.nodes == NULL)
+        return 0;
+    atomic_init(&tree.used, 1);
+    atomic_init(&tree.max_depth, 0);
+    atomic_init(&tree.nodes[0].children, NOT_EXPANDED);
+    tree.nodes[0].nchildren = 0;
+    atomic_init(&tree.nodes[0].visits, 0);
+    atomic_init(&tree.nodes[0].virtual_losses, 0);
+    atomic_init(&tree.nodes[0].wins, 0);
+
+    if (threads < 1)
+        threads = 1;
+    Mcts_worker *workers = malloc(threads * sizeof(Mcts_worker));
+    pthread_t *handles = malloc(threads * sizeof(pthread_t));
+    int started = 0;
+    for (int i = 0; workers != NULL && handles != NULL && i < threads; i++) {
+        workers[i] = (Mcts_worker) {
+            .tree = &tree,
+            .seed = (state->hash ^ (uint64_t) now_ms()) * 2654435761u + i + 1,
+            .reports = i == 0,
+        };
+        if (i > 0 && pthread_create(&handles[started], NULL, mcts_thread, &workers[i]) == 0)
+            started++;
+    }
+    // This thread is one of the workers too
+    if (workers != NULL)
+        mcts_thread(&workers[0]);
+    for (int i = 0; i < started; i++)
+        pthread_join(handles[i], NULL);
+
+    Mcts_node *best = most_visited(&tree);
+    if (best != NULL) {
+        search->best = moves.array[best->move];
+        atomic_store(&search->score, win_rate_score(best));
+        atomic_store(&search->depth, atomic_load(&tree.max_depth));
+    }
+
+    free(workers);
+    free(handles);
+    free(tree.nodes);
+    return atomic_load(&search->score);
+}
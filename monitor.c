@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "checkers.h"
+
+/* See checkers.h for what a monitor is. */
+
+_Static_assert(sizeof(Worker_status) % 8 == 0, "a Worker_status is copied a word at a time");
+
+// Where the slots start: the header gets a cache line (or more) of its own
+#define SLOTS_OFFSET ((sizeof(Monitor_header) + 63) / 64 * 64)
+
+static size_t monitor_size(uint32_t workers)
+{
+    return SLOTS_OFFSET + workers * sizeof(Monitor_slot);
+}
+
+static bool monitor_map(Monitor *monitor, int fd, size_t size, int protection)
+{
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+        return false;
+    void *mapping = mmap(NULL, size, protection, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED)
+        return false;
+    monitor->header = mapping;
+    monitor->slots = (Monitor_slot *) ((char *) mapping + SLOTS_OFFSET);
+    monitor->size = size;
+    monitor->file_id = st.st_ino;
+    return true;
+}
+
+/* monitor_create writes the new file under a temporary name and renames it
+ * into place, so that a dashboard watching the previous one doesn't find
+ * its file cut short under it. */
+bool monitor_create(Monitor *monitor, const char *path, int workers)
+{
+    monitor->header = NULL;
+    if (workers < 1 || workers > MONITOR_MAXWORKERS) {
+        errno = EINVAL;
+        return false;
+    }
+
+    char temporary[4096];
+    snprintf(temporary, sizeof(temporary), "%s.tmp", path);
+    int fd = open(temporary, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return false;
+
+    // ftruncate fills the slots with zeros: sequence 0, nothing published
+    size_t size = monitor_size(workers);
+    bool ok = ftruncate(fd, size) == 0 && monitor_map(monitor, fd, size, PROT_READ | PROT_WRITE);
+    int error = errno;
+    close(fd);
+    if (!ok) {
+        unlink(temporary);
+        errno = error;
+        return false;
+    }
+
+    Monitor_header *header = monitor->header;
+    memcpy(header->magic, MONITOR_MAGIC, 4);
+    header->version = MONITOR_VERSION;
+    header->board_size = BOARD_SIZE;
+    header->variant = VARIANT;
+    header->workers = workers;
+    header->started_ms = now_ms();
+    if (rename(temporary, path) != 0) {
+        error = errno;
+        monitor_close(monitor);
+        unlink(temporary);
+        errno = error;
+        return false;
+    }
+    return true;
+}
+
+bool monitor_open(Monitor *monitor, const char *path)
+{
+    monitor->header = NULL;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    Monitor_header header;
+    struct stat st;
+    bool ok = pread(fd, &header, sizeof(header), 0) == sizeof(header) && fstat(fd, &st) == 0
+           && memcmp(header.magic, MONITOR_MAGIC, 4) == 0 && header.version == MONITOR_VERSION
+           && header.board_size == BOARD_SIZE && header.variant == VARIANT
+           && header.workers >= 1 && header.workers <= MONITOR_MAXWORKERS
+           && (uint64_t) st.st_size == monitor_size(header.workers);
+    if (!ok) {
+        close(fd);
+        errno = EINVAL;
+        return false;
+    }
+    ok = monitor_map(monitor, fd, st.st_size, PROT_READ);
+    int error = errno;
+    close(fd);
+    errno = error;
+    return ok;
+}
+
+void monitor_close(Monitor *monitor)
+{
+    if (monitor->header != NULL)
+        munmap(monitor->header, monitor->size);
+    monitor->header = NULL;
+}
+
+/* monitor_publish puts the worker's status in its slot.  Only that worker
+ * may publish into it. */
+void monitor_publish(Monitor *monitor, int worker, const Worker_status *status)
+{
+    Monitor_slot *slot = &monitor->slots[worker];
+    uint64_t words[MONITOR_WORDS];
+    memcpy(words, status, sizeof(words));
+
+    uint64_t sequence = atomic_load_explicit(&slot->sequence, memory_order_relaxed);
+    atomic_store_explicit(&slot->sequence, sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    for (size_t i = 0; i < MONITOR_WORDS; i++)
+        atomic_store_explicit(&slot->words[i], words[i], memory_order_relaxed);
+    atomic_store_explicit(&slot->sequence, sequence + 2, memory_order_release);
+}
+
+/* monitor_read copies the worker's latest status out of its slot.  Returns
+ * false if it has never published one, or if it kept rewriting it while it
+ * was being copied (which, since a worker publishes now and then and it
+ * takes no time, shouldn't happen more than once in a while). */
+bool monitor_read(Monitor *monitor, int worker, Worker_status *status)
+{
+    Monitor_slot *slot = &monitor->slots[worker];
+    for (int tries = 0; tries < 100; tries++) {
+        uint64_t before = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        if (before == 0)
+            return false;
+        if (before % 2 == 1)
+            continue;
+
+        uint64_t words[MONITOR_WORDS];
+        for (size_t i = 0; i < MONITOR_WORDS; i++)
+            words[i] = atomic_load_explicit(&slot->words[i], memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&slot->sequence, memory_order_relaxed) == before) {
+            memcpy(status, words, sizeof(words));
+            return true;
+        }
+    }
+    return false;
+}
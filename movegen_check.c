@@ -0,0 +1,480 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "checkers.h"
+
+/* movegen_check is the safety net for making the movement generation
+ * faster: it plays random games on every core and checks, on each position
+ * they reach, that every generator in 'generators' gives exactly the
+ * movements the reference one (generate_mov_options, on top of get_movtype
+ * and generate_dest_options) gives.  A new generator only has to be added
+ * to the table to be checked the same way.  ("mirror" checks that the
+ * rules treat both players alike, generating for the mirror image.)
+ *
+ * When a generator gets a position wrong, the position is shrunk: pieces
+ * are taken off and dames made stones one at a time, as long as the
+ * generator keeps getting it wrong, so what's reported is a position with
+ * nothing left on it that isn't needed for the mistake.  It's printed with
+ * what each generator gave, and added to FILE in tactics.txt's format (a
+ * position, then after ';' what went wrong), so that it can be checked
+ * again after the fix with 'movegen_check --recheck FILE'.
+ *
+ * Since all of that only compares first steps, whole movements are checked
+ * too, where the published perft counts of the variant are known: every
+ * movement sequence from the starting position, PERFT_DEPTH plies deep,
+ * has to come to PERFT_COUNT.  (They catch, for example, capture sequences
+ * counted twice.)
+ *
+ * Usage: movegen_check [options]
+ *   --positions N     how many positions to check (default 10000000)
+ *   --threads N       games played at a time (default: one per core)
+ *   --seed N          for the random numbers (default 1)
+ *   --out FILE        where the failing positions go (default movegen.fail)
+ *   --max-failures N  stop after that many (default 10)
+ *   --recheck FILE    check FILE's positions instead of random ones (what
+ *                     fails is only printed then)
+ * It prints how many positions per second it checks, and returns failure
+ * if any position failed. */
+
+static long target = 10000000;
+static uint64_t seed = 1;
+static const char *out_file = "movegen.fail";
+static long max_failures = 10;
+static const char *recheck_file = NULL;
+
+#define MAXPLIES 200
+#define MAXSTEPS BATCH_MAXSTEPS
+
+// Published perft counts
+#if VARIANT == VARIANT_BRAZILIAN
+#define PERFT_DEPTH 8
+#define PERFT_COUNT 907830L
+#elif VARIANT == VARIANT_INTERNATIONAL
+#define PERFT_DEPTH 8
+#define PERFT_COUNT 6483961L
+#elif VARIANT == VARIANT_RUSSIAN
+#define PERFT_DEPTH 9
+#define PERFT_COUNT 4570667L
+#endif
+
+
+// {{{ Generators
+/* What a generator gives for a position: the first step of each movement
+ * it allows, packed like generate_batch's (from | to << 8, dark squares),
+ * in any order, and whether they're captures. */
+typedef struct {
+    int length;
+    Movtype type;
+    uint16_t steps[MAXSTEPS];
+} Step_list;
+
+/* A generator does 'count' (at most BATCH_SIZE) positions at a time, for
+ * the ones that are faster that way. */
+typedef struct {
+    const char *name;
+    void (*generate)(Game_state *positions, int count, Step_list *out);
+} Generator;
+
+static void mov_options_steps(Game_state *positions, int count, Step_list *out)
+{
+    for (int i = 0; i < count; i++) {
+        Mov_options options;
+        generate_mov_options(&positions[i], &options);
+        out[i].length = 0;
+        out[i].type = options.type;
+        for (int j = 0; j < options.length; j++) {
+            Dest_options *dest = &options.array[j];
+            for (int k = 0; k < dest->length; k++)
+                out[i].steps[out[i].length++] = dark_square(dest->src)
+                                              | dark_square(dest->array[k]) << 8;
+        }
+    }
+}
+
+static void batch_steps(Game_state *positions, int count, Step_list *out)
+{
+    Batch batch;
+    static _Thread_local Batch_steps steps;
+    batch_clear(&batch);
+    for (int i = 0; i < count; i++)
+        batch_add(&batch, &positions[i]);
+    generate_batch(&batch, &steps);
+    for (int i = 0; i < count; i++) {
+        out[i].length = steps.length[i];
+        out[i].type = steps.type[i];
+        memcpy(out[i].steps, steps.steps[i], steps.length[i] * sizeof(uint16_t));
+    }
+}
+
+#if !RULE_MAJORITY_CAPTURE && !RULE_TURKISH_STRIKE
+/* The first steps of generate_moves' whole movements.  (With the majority
+ * rule it leaves out the ones that capture too little, and with the Turkish
+ * strike a dame's landing squares it can't go on capturing from, none of
+ * which generate_mov_options can know about.) */
+static void moves_steps(Game_state *positions, int count, Step_list *out)
+{
+    for (int i = 0; i < count; i++) {
+        Move_list moves;
+        generate_moves(&positions[i], &moves);
+        out[i].length = 0;
+        out[i].type = moves.length > 0 ? moves.type : REGULAR;
+        for (int j = 0; j < moves.length; j++) {
+            uint16_t step = dark_square(moves.array[j].path[0])
+                          | dark_square(moves.array[j].path[1]) << 8;
+            // Movements going on differently after the same first step
+            bool seen = false;
+            for (int k = 0; k < out[i].length && !seen; k++)
+                seen = out[i].steps[k] == step;
+            if (!seen)
+                out[i].steps[out[i].length++] = step;
+        }
+    }
+}
+#endif
+
+/* batch's steps for the position's mirror image (made with mirror_packed),
+ * turned back around: the rules being the same for both players is what
+ * lets tables keep a position and its mirror image in one entry (see
+ * game_key). */
+static void mirror_steps(Game_state *positions, int count, Step_list *out)
+{
+    Game_state mirrored[BATCH_SIZE];
+    for (int i = 0; i < count; i++) {
+        Packed_position packed;
+        pack_position(&positions[i], 0, ONGOING, &packed);
+        mirror_packed(&packed);
+        unpack_position(&packed, &mirrored[i], NULL, NULL);
+    }
+    batch_steps(mirrored, count, out);
+    for (int i = 0; i < count; i++)
+        for (int j = 0; j < out[i].length; j++)
+            out[i].steps[j] = (DARK_SQUARES - 1 - BATCH_STEP_FROM(out[i].steps[j]))
+                            | (DARK_SQUARES - 1 - BATCH_STEP_TO(out[i].steps[j])) << 8;
+}
+
+static Generator reference = { "mov_options", mov_options_steps };
+
+static Generator generators[] = {
+    { "batch", batch_steps },
+    { "mirror", mirror_steps },
+#if !RULE_MAJORITY_CAPTURE && !RULE_TURKISH_STRIKE
+    { "moves", moves_steps },
+#endif
+};
+
+#define NGENERATORS ((int) (sizeof(generators) / sizeof(generators[0])))
+
+static int compare_steps(const void *a, const void *b)
+{
+    return *(const uint16_t *) a - *(const uint16_t *) b;
+}
+
+/* same_steps sorts both lists and tells whether they're the same */
+static bool same_steps(Step_list *a, Step_list *b)
+{
+    qsort(a->steps, a->length, sizeof(uint16_t), compare_steps);
+    qsort(b->steps, b->length, sizeof(uint16_t), compare_steps);
+    // With no movements at all, whether they'd be captures doesn't matter
+    return a->length == b->length && (a->type == b->type || a->length == 0)
+        && memcmp(a->steps, b->steps, a->length * sizeof(uint16_t)) == 0;
+}
+
+/* fails tells whether the generator gets the position wrong */
+static bool fails(Generator *generator, Game_state *state)
+{
+    Step_list expected, got;
+    reference.generate(state, 1, &expected);
+    generator->generate(state, 1, &got);
+    return !same_steps(&expected, &got);
+}
+// }}}
+
+
+// {{{ Failures
+/* Changing the board directly leaves the hash and the situation behind */
+static void retouch(Game_state *state)
+{
+    state->reversible_moves = 0;
+    game_rehash(state);
+    update_situation(state);
+}
+
+/* shrink takes pieces off the position and makes dames stones, one at a
+ * time, keeping each change the generator still fails with, until no
+ * change is left to try. */
+static void shrink(Generator *generator, Game_state *state)
+{
+    for (bool shrunk = true; shrunk; ) {
+        shrunk = false;
+        for (int square = 0; square < DARK_SQUARES; square++) {
+            Position pos = dark_square_position(square);
+            Piece piece = get_piece(state, pos);
+            if (is_empty(piece))
+                continue;
+
+            // A stone can't be on the row it would have been promoted on
+            Piece smaller[2] = { EMPTY, EMPTY };
+            if (piece == WHITE_DAME && pos.row != BOARD_SIZE - 1)  smaller[1] = WHITE_STONE;
+            if (piece == BLACK_DAME && pos.row != 0)               smaller[1] = BLACK_STONE;
+            for (int i = 0; i < 2; i++) {
+                if (i == 1 && smaller[i] == EMPTY)
+                    break;
+                Game_state candidate = *state;
+                candidate.board[pos.row][pos.col] = smaller[i];
+                retouch(&candidate);
+                if (fails(generator, &candidate)) {
+                    *state = candidate;
+                    shrunk = true;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+static void print_steps(FILE *out, const char *name, Step_list *list)
+{
+    fprintf(out, " %s %s:", name, list->type == CAPTURE ? "captures" : "regular");
+    for (int i = 0; i < list->length; i++) {
+        Position from = dark_square_position(BATCH_STEP_FROM(list->steps[i]));
+        Position to = dark_square_position(BATCH_STEP_TO(list->steps[i]));
+        fprintf(out, " %c%d-%c%d", 'a' + from.col, from.row + 1, 'a' + to.col, to.row + 1);
+    }
+}
+
+static pthread_mutex_t report_lock = PTHREAD_MUTEX_INITIALIZER;
+static atomic_long checked;
+static atomic_long failures;
+
+/* report shrinks a position the generator fails on, prints it and adds it
+ * to out_file */
+static void report(Generator *generator, Game_state *state)
+{
+    Game_state original = *state;
+    shrink(generator, state);
+
+    Step_list expected, got;
+    reference.generate(state, 1, &expected);
+    generator->generate(state, 1, &got);
+    same_steps(&expected, &got);  // to sort them
+    char text[POSITION_TEXT_LENGTH], original_text[POSITION_TEXT_LENGTH];
+    game_to_text(state, text);
+    game_to_text(&original, original_text);
+
+    pthread_mutex_lock(&report_lock);
+    FILE *out = out_file != NULL ? fopen(out_file, "a") : NULL;
+    FILE *streams[2] = { stdout, out };
+    for (int i = 0; i < 2; i++) {
+        if (streams[i] == NULL)
+            continue;
+        fprintf(streams[i], "%s ; %s differs from", text, generator->name);
+        print_steps(streams[i], reference.name, &expected);
+        fprintf(streams[i], ";");
+        print_steps(streams[i], generator->name, &got);
+        if (strcmp(text, original_text) != 0)
+            fprintf(streams[i], "; shrunk from %s", original_text);
+        fprintf(streams[i], "\n");
+    }
+    if (out != NULL)
+        fclose(out);
+    else if (out_file != NULL)
+        perror(out_file);
+    fflush(stdout);
+    pthread_mutex_unlock(&report_lock);
+}
+
+/* check_positions runs every generator on the positions and reports the
+ * ones they get wrong */
+static void check_positions(Game_state *positions, int count)
+{
+    static _Thread_local Step_list expected[BATCH_SIZE], got[BATCH_SIZE];
+    reference.generate(positions, count, expected);
+    for (int g = 0; g < NGENERATORS; g++) {
+        generators[g].generate(positions, count, got);
+        for (int i = 0; i < count; i++) {
+            Step_list copy = expected[i];
+            if (!same_steps(&copy, &got[i]) && atomic_fetch_add(&failures, 1) < max_failures)
+                report(&generators[g], &positions[i]);
+        }
+    }
+    atomic_fetch_add(&checked, count);
+}
+// }}}
+
+
+/* check_thread plays games of random movements, checking their positions
+ * BATCH_SIZE at a time, until enough were checked */
+static void *check_thread(void *arg)
+{
+    uint64_t seed = *(uint64_t *) arg;
+    Game_state positions[BATCH_SIZE];
+    int count = 0;
+    while (atomic_load(&checked) < target && atomic_load(&failures) < max_failures) {
+        Game_state state;
+        game_setup(&state);
+        for (int ply = 0; ply < MAXPLIES && state.situation == ONGOING; ply++) {
+            positions[count++] = state;
+            if (count == BATCH_SIZE) {
+                check_positions(positions, count);
+                count = 0;
+            }
+            Move_list moves;
+            generate_moves(&state, &moves);
+            if (moves.length == 0)
+                break;
+            game_apply_move(&state, &moves.array[next_random(&seed) % moves.length]);
+        }
+    }
+    return NULL;
+}
+
+/* recheck checks the positions in recheck_file; returns how many there
+ * were, or -1 if it can't be read or has something that's not a position */
+static long recheck()
+{
+    FILE *in = fopen(recheck_file, "r");
+    if (in == NULL) {
+        perror(recheck_file);
+        return -1;
+    }
+
+    char line[4096];
+    long count = 0, number = 0;
+    while (fgets(line, sizeof(line), in) != NULL) {
+        number++;
+        line[strcspn(line, ";\n")] = '\0';
+        char *text = line + strspn(line, " \t");
+        for (char *end = text + strlen(text); end > text && end[-1] == ' '; )
+            *--end = '\0';
+        if (*text == '\0' || *text == '#')
+            continue;
+        Game_state state;
+        if (!game_from_text(&state, text)) {
+            fprintf(stderr, "%s:%ld: not a position\n", recheck_file, number);
+            fclose(in);
+            return -1;
+        }
+        check_positions(&state, 1);
+        count++;
+    }
+    fclose(in);
+    return count;
+}
+
+#ifdef PERFT_DEPTH
+static long perft(Game_state *state, int depth)
+{
+    Move_list moves;
+    generate_moves(state, &moves);
+    if (depth == 1)
+        return moves.length;
+
+    long leaves = 0;
+    for (int i = 0; i < moves.length; i++) {
+        Game_state next = *state;
+        game_apply_move(&next, &moves.array[i]);
+        leaves += perft(&next, depth - 1);
+    }
+    return leaves;
+}
+
+/* check_perft compares the perft count with the published one */
+static void check_perft()
+{
+    Game_state state;
+    game_setup(&state);
+    long leaves = perft(&state, PERFT_DEPTH);
+    printf("perft %d: %ld", PERFT_DEPTH, leaves);
+    if (leaves == PERFT_COUNT) {
+        printf(", as published\n");
+    } else {
+        printf(", but %ld are published\n", PERFT_COUNT);
+        atomic_fetch_add(&failures, 1);
+    }
+    fflush(stdout);
+}
+#endif
+
+static void usage()
+{
+    fprintf(stderr, "usage: movegen_check [--positions N] [--threads N] [--seed N] [--out FILE]"
+                    " [--max-failures N] [--recheck FILE]\n");
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv)
+{
+    int threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    for (int i = 1; i < argc; i++) {
+        if      (strcmp("--positions", argv[i]) == 0 && i+1 < argc)     target = atol(argv[++i]);
+        else if (strcmp("--threads", argv[i]) == 0 && i+1 < argc)       threads = atoi(argv[++i]);
+        else if (strcmp("--seed", argv[i]) == 0 && i+1 < argc)          seed = strtoull(argv[++i], NULL, 10);
+        else if (strcmp("--out", argv[i]) == 0 && i+1 < argc)           out_file = argv[++i];
+        else if (strcmp("--max-failures", argv[i]) == 0 && i+1 < argc)  max_failures = atol(argv[++i]);
+        else if (strcmp("--recheck", argv[i]) == 0 && i+1 < argc)       recheck_file = argv[++i];
+        else usage();
+    }
+    if (target <= 0 || seed == 0 || max_failures <= 0)
+        usage();
+    if (threads < 1)
+        threads = 1;
+
+    printf("checking");
+    for (int g = 0; g < NGENERATORS; g++)
+        printf(" %s", generators[g].name);
+    printf(" against %s\n", reference.name);
+    fflush(stdout);
+
+    if (recheck_file != NULL) {
+        out_file = NULL;
+        long count = recheck();
+        if (count < 0)
+            return EXIT_FAILURE;
+        printf("%ld positions, %ld failures\n", count, atomic_load(&failures));
+        return atomic_load(&failures) == 0 ? 0 : EXIT_FAILURE;
+    }
+
+#ifdef PERFT_DEPTH
+    check_perft();
+#endif
+
+    // Every thread plays its own games
+    pthread_t *pool = malloc(threads * sizeof(pthread_t));
+    uint64_t *seeds = malloc(threads * sizeof(uint64_t));
+    if (pool == NULL || seeds == NULL) {
+        fprintf(stderr, "movegen_check: out of memory\n");
+        return EXIT_FAILURE;
+    }
+    long start = now_ms();
+    int started = 0;
+    for (; started < threads; started++) {
+        seeds[started] = seed * 0x9E3779B97F4A7C15ull + started + 1;
+        if (pthread_create(&pool[started], NULL, check_thread, &seeds[started]) != 0)
+            break;
+    }
+    if (started == 0) {
+        seeds[0] = seed;
+        check_thread(&seeds[0]);
+    }
+
+    // Meanwhile, how it's going
+    long count;
+    while ((count = atomic_load(&checked)) < target && atomic_load(&failures) < max_failures
+           && started > 0) {
+        usleep(200000);
+        long ms = now_ms() - start;
+        fprintf(stderr, "\r%ld positions, %.0f/s, %ld failures", count,
+                (double) count / (ms > 0 ? ms : 1) * 1000, atomic_load(&failures));
+    }
+    for (int t = 0; t < started; t++)
+        pthread_join(pool[t], NULL);
+
+    long ms = now_ms() - start;
+    count = atomic_load(&checked);
+    fprintf(stderr, "\r%ld positions, %.0f/s, %ld failures\n", count,
+            (double) count / (ms > 0 ? ms : 1) * 1000, atomic_load(&failures));
+    free(seeds);
+    free(pool);
+    return atomic_load(&failures) == 0 ? 0 : EXIT_FAILURE;
+}
@@ -1,4 +1,6 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "checkers.h"
 
 
@@ -45,6 +47,12 @@ Movtype get_movtype(Game_state *state, Position src, Position dest)
         }
         else if (distance == 2)
         {
+#if !RULE_BACKWARD_CAPTURE
+            // Captures go forward too in this variant
+            bool forward = (atsrc == WHITE_STONE && vdir ==  1)
+                        || (atsrc == BLACK_STONE && vdir == -1);
+            if (!forward)  return INVALID;
+#endif
             // Possibly a capture
             Position mid = { src.row + vdir, src.col + hdir };
             int atmid = get_piece(state, mid);
@@ -67,6 +75,13 @@ Movtype get_movtype(Game_state *state, Position src, Position dest)
         {
             return REGULAR;
         }
+#if !RULE_FLYING_DAMES
+        // Dames move like stones in this variant, just in every direction
+        else if (distance > 2)
+        {
+            return INVALID;
+        }
+#endif
         else
         {
             // Iterate over the pieces in the middle of src and dest to determine the movement type
@@ -85,6 +100,13 @@ Movtype get_movtype(Game_state *state, Position src, Position dest)
                         // We break right away because otherwise a piece that comes later
                         // that has the opposite color would set 'type' to CAPTURE
                     } else {
+#if RULE_TURKISH_STRIKE
+                        // One piece per jump: a second one stops the dame
+                        if (type == CAPTURE) {
+                            type = INVALID;
+                            break;
+                        }
+#endif
                         type = CAPTURE;
                         // But we don't break here because there might be a piece of
                         // opposite color in the way later
@@ -191,9 +213,10 @@ void generate_dest_options(Game_state *state, Position src,
             {
                 int hdir = directions[j];
                 Position dest;
-                for (dest.row = src.row+vdir, dest.col = src.col+hdir;
-                     is_valid_position(dest);
-                     dest.row += vdir, dest.col += hdir)
+                int distance;
+                for (dest.row = src.row+vdir, dest.col = src.col+hdir, distance = 1;
+                     is_valid_position(dest) && distance <= DAME_RANGE;
+                     dest.row += vdir, dest.col += hdir, distance++)
                 {
                     Movtype type = get_movtype(state, src, dest);
                     if (type == CAPTURE)
@@ -215,9 +238,10 @@ void generate_dest_options(Game_state *state, Position src,
                 {
                     int hdir = directions[j];
                     Position dest;
-                    for (dest.row = src.row+vdir, dest.col = src.col+hdir;
-                         is_valid_position(dest);
-                         dest.row += vdir, dest.col += hdir)
+                    int distance;
+                    for (dest.row = src.row+vdir, dest.col = src.col+hdir, distance = 1;
+                         is_valid_position(dest) && distance <= DAME_RANGE;
+                         dest.row += vdir, dest.col += hdir, distance++)
                     {
                         Movtype type = get_movtype(state, src, dest);
                         if (type == REGULAR)
@@ -239,6 +263,10 @@ void generate_dest_options(Game_state *state, Position src,
  * regular move as an option even though some other piece in the board can
  * perform a capture. On the othar hand, generate_mov_options will ensure
  * that this rule is fulfilled.
+ * (It only looks at the first capture of each sequence, though, so in
+ * variants with RULE_MAJORITY_CAPTURE or RULE_TURKISH_STRIKE some of its
+ * options may not be allowed -- generate_moves has the final word on what
+ * can be played.)
  */
 void generate_mov_options(Game_state *state, Mov_options *mov_options)
 {   //{{{
@@ -333,3 +361,394 @@ end_regular_search:
 
 }   //}}}
 
+
+
+/* capture_step makes one step of a capture sequence that isn't over yet.
+ * With RULE_TURKISH_STRIKE the captured piece stays on the board until the
+ * sequence is over, which is just how a piece of the capturing player's own
+ * would behave: it can't be jumped and nothing can go past it.  So that's
+ * what it's turned into here, and generate_dest_options gets the next
+ * captures right without knowing anything about it.  (game_apply_move then
+ * takes each piece off as it's captured, which comes to the same.) */
+static void capture_step(Game_state *state, Position src, Position dest)
+{   //{{{
+#if RULE_TURKISH_STRIKE
+    Piece piece = get_piece(state, src);
+    Piece blocker = is_white(piece) ? WHITE_STONE : BLACK_STONE;
+    int vdir = dest.row > src.row ? 1 : -1;
+    int hdir = dest.col > src.col ? 1 : -1;
+    for (Position mid = { src.row + vdir, src.col + hdir }; mid.row != dest.row;
+         mid.row += vdir, mid.col += hdir)
+        if (!is_empty(get_piece(state, mid)))
+            set_piece(state, mid, blocker);
+    set_piece(state, src, EMPTY);
+    set_piece(state, dest, piece);
+#if RULE_PROMOTION == PROMOTE_DURING_CAPTURE
+    upgrade_stones_to_dames(state);
+#endif
+#else
+    perform_step(state, src, dest);
+#endif
+}   //}}}
+
+
+#if RULE_TURKISH_STRIKE
+/* must_go_on leaves out of a dame's capture options the landing squares it
+ * isn't allowed: past the piece it jumps it may stop on any empty square,
+ * unless it can capture again from some of them -- then it has to land on
+ * one of those. */
+static void must_go_on(Game_state *state, Dest_options *options)
+{   //{{{
+    Position src = options->src;
+    if (options->type != CAPTURE || !is_dame(get_piece(state, src)))
+        return;
+
+    bool goes_on[MAXOPTIONS];
+    bool direction_goes_on[4] = { false, false, false, false };
+    for (int i = 0; i < options->length; i++)
+    {
+        Position dest = options->array[i];
+        Game_state sub_state;
+        game_copy(&sub_state, state);
+        capture_step(&sub_state, src, dest);
+        Dest_options next;
+        generate_dest_options(&sub_state, dest, &next, true);
+        goes_on[i] = next.type == CAPTURE;
+        if (goes_on[i])
+            direction_goes_on[(dest.row > src.row) * 2 + (dest.col > src.col)] = true;
+    }
+
+    int kept = 0;
+    for (int i = 0; i < options->length; i++)
+    {
+        Position dest = options->array[i];
+        if (goes_on[i] || !direction_goes_on[(dest.row > src.row) * 2 + (dest.col > src.col)])
+            options->array[kept++] = dest;
+    }
+    options->length = kept;
+}   //}}}
+#endif
+
+
+/* add_move adds 'move' to the list.  Nothing proves that every position's
+ * movements fit in MAXMOVES (capture sequences of flying dames on 10x10 can
+ * branch a lot), so rather than leave a legal movement out without a word,
+ * a position with more of them stops the program. */
+static void add_move(Move_list *moves, Move *move)
+{   //{{{
+    if (moves->length == MAXMOVES)
+    {
+        fprintf(stderr, "checkers: a position with more than %d movements"
+                        " (make MAXMOVES bigger)\n", MAXMOVES);
+        abort();
+    }
+    moves->array[moves->length++] = *move;
+}   //}}}
+
+
+/* extend_captures: 'move' is a capture made by the current player that ends
+ * (so far) at its last position, and 'state' is the game right after it.  If
+ * the piece can keep capturing, every possible continuation is explored;
+ * otherwise the move is complete and goes into the list. */
+static void extend_captures(Game_state *state, Move *move, Move_list *moves)
+{   //{{{
+    Position at = move->path[move->length - 1];
+    Dest_options options;
+    generate_dest_options(state, at, &options, true);
+#if RULE_TURKISH_STRIKE
+    must_go_on(state, &options);
+#endif
+
+    bool over = options.type != CAPTURE || move->length == MAXPATH;
+#if RULE_PROMOTION == PROMOTION_ENDS_MOVE
+    // A stone that made it to the other side stops there
+    Piece piece = get_piece(state, at);
+    if ((piece == WHITE_STONE && at.row == BOARD_SIZE - 1)
+     || (piece == BLACK_STONE && at.row == 0))
+        over = true;
+#endif
+    if (over)
+    {
+        add_move(moves, move);
+        return;
+    }
+
+    for (int i = 0; i < options.length; i++)
+    {
+        Game_state sub_state;
+        game_copy(&sub_state, state);
+        capture_step(&sub_state, at, options.array[i]);
+
+        move->path[move->length++] = options.array[i];
+        extend_captures(&sub_state, move, moves);
+        move->length--;
+    }
+}   //}}}
+
+
+#if RULE_MAJORITY_CAPTURE
+/* captured_set tells which pieces a capture Move takes, as a set of bits
+ * (one per dark square: row * BOARD_SIZE + col over 2): the ones it jumps,
+ * which (RULE_TURKISH_STRIKE) are all still on the board before it.  The
+ * piece may go back over the square it started from, which doesn't count. */
+static uint64_t captured_set(Game_state *state, Move *move)
+{   //{{{
+    uint64_t set = 0;
+    for (int i = 1; i < move->length; i++)
+    {
+        Position from = move->path[i-1], to = move->path[i];
+        int vdir = to.row > from.row ? 1 : -1;
+        int hdir = to.col > from.col ? 1 : -1;
+        for (Position mid = { from.row + vdir, from.col + hdir }; mid.row != to.row;
+             mid.row += vdir, mid.col += hdir)
+            if (!is_empty(get_piece(state, mid))
+             && !(mid.row == move->path[0].row && mid.col == move->path[0].col))
+                set |= (uint64_t) 1 << ((mid.row * BOARD_SIZE + mid.col) / 2);
+    }
+    return set;
+}   //}}}
+#endif
+
+
+/* generate_moves: generates every complete Move the current player can make,
+ * in the same order as generate_mov_options.  A capture after which the
+ * piece can capture again is followed through all the ways it can go on
+ * (just like game_loop makes the player keep capturing), so each capture
+ * Move ends only when the piece has nothing left to capture (or, depending
+ * on the variant, when it gets promoted). */
+void generate_moves(Game_state *state, Move_list *moves)
+{   //{{{
+    Mov_options mov_options;
+    generate_mov_options(state, &mov_options);
+
+    moves->length = 0;
+    moves->type = mov_options.type;
+    for (int i = 0; i < mov_options.length; i++)
+    {
+        Dest_options *dest_options = &mov_options.array[i];
+#if RULE_TURKISH_STRIKE
+        must_go_on(state, dest_options);
+#endif
+        for (int j = 0; j < dest_options->length; j++)
+        {
+            Move move;
+            move.path[0] = dest_options->src;
+            move.path[1] = dest_options->array[j];
+            move.length = 2;
+
+            if (mov_options.type == REGULAR)
+            {
+                add_move(moves, &move);
+            }
+            else
+            {
+                Game_state sub_state;
+                game_copy(&sub_state, state);
+                capture_step(&sub_state, move.path[0], move.path[1]);
+                extend_captures(&sub_state, &move, moves);
+            }
+        }
+    }
+
+#if RULE_MAJORITY_CAPTURE
+    // Under these rules a capture is the pieces it takes and where it ends:
+    // sequences that take the same pieces to the same square in another
+    // order are the same movement, and only the first of them is kept.
+    // (Russian rules, which have no majority rule, tell them apart.)  Then
+    // only the ones that capture the most pieces are allowed.
+    if (moves->type == CAPTURE)
+    {
+        uint64_t captured[MAXMOVES];
+        int kept = 0;
+        for (int i = 0; i < moves->length; i++)
+        {
+            Move *move = &moves->array[i];
+            Position end = move->path[move->length - 1];
+            uint64_t set = captured_set(state, move);
+            bool seen = false;
+            for (int j = 0; j < kept && !seen; j++)
+            {
+                Move *other = &moves->array[j];
+                Position other_end = other->path[other->length - 1];
+                seen = captured[j] == set && other->path[0].row == move->path[0].row
+                    && other->path[0].col == move->path[0].col
+                    && other_end.row == end.row && other_end.col == end.col;
+            }
+            if (!seen)
+            {
+                captured[kept] = set;
+                moves->array[kept++] = *move;
+            }
+        }
+        moves->length = kept;
+
+        int counts[MAXMOVES];
+        int most = 0;
+        for (int i = 0; i < moves->length; i++)
+        {
+            counts[i] = 0;
+            for (uint64_t set = captured[i]; set != 0; set &= set - 1)
+                counts[i]++;
+            if (counts[i] > most)
+                most = counts[i];
+        }
+
+        kept = 0;
+        for (int i = 0; i < moves->length; i++)
+            if (counts[i] == most)
+                moves->array[kept++] = moves->array[i];
+        moves->length = kept;
+    }
+#endif
+}   //}}}
+
+
+/* update_blocked_situation is update_situation's complement for a player
+ * who still has pieces but can't move any of them: that player has lost.
+ * 'moves' are the position's (from generate_moves). */
+void update_blocked_situation(Game_state *state, Move_list *moves)
+{
+    if (state->situation == ONGOING && moves->length == 0)
+        state->situation = state->current_player == WHITE ? BLACK_WINS : WHITE_WINS;
+}
+
+
+static bool same_position(Position a, Position b)
+{
+    return a.row == b.row && a.col == b.col;
+}
+
+/* get_step_options: the player picks a Move one step at a time (the first
+ * movement, then each sequential capture), so get_step_options tells which
+ * steps can come after the ones in 'prefix' (all of them, if 'prefix' is
+ * NULL), according to the complete moves in 'moves'.  The options are
+ * grouped by source like generate_mov_options does; after a prefix there's
+ * at most one source, the prefix's last position, and no options at all
+ * once the prefix is a complete move. */
+void get_step_options(Move_list *moves, Move *prefix, Mov_options *options)
+{   //{{{
+    int done = prefix != NULL ? prefix->length : 1;
+
+    options->length = 0;
+    options->type = moves->type;
+
+    for (int i = 0; i < moves->length; i++)
+    {
+        Move *move = &moves->array[i];
+        if (move->length <= done)
+            continue;
+
+        bool matches = true;
+        for (int j = 0; j < done && prefix != NULL; j++)
+            if (!same_position(move->path[j], prefix->path[j]))
+                matches = false;
+        if (!matches)
+            continue;
+
+        Position src  = move->path[done - 1];
+        Position dest = move->path[done];
+
+        // Find (or add) the Dest_options for this source...
+        Dest_options *dest_options = NULL;
+        for (int j = 0; j < options->length; j++)
+            if (same_position(options->array[j].src, src))
+                dest_options = &options->array[j];
+        if (dest_options == NULL)
+        {
+            if (options->length == NUMPIECES)
+                continue;
+            dest_options = &options->array[options->length++];
+            dest_options->src = src;
+            dest_options->length = 0;
+            dest_options->type = moves->type;
+        }
+
+        // ... and add the destination, unless some other move already did
+        bool known = false;
+        for (int j = 0; j < dest_options->length; j++)
+            if (same_position(dest_options->array[j], dest))
+                known = true;
+        if (!known && dest_options->length < MAXOPTIONS)
+            dest_options->array[dest_options->length++] = dest;
+    }
+}   //}}}
+
+
+/* write_move writes the move's path like "(2,2) -> (3,3)" into 'str' and
+ * returns it. */
+char *write_move(Move *move, char *str)
+{
+    char *end = str;
+    for (int i = 0; i < move->length; i++)
+    {
+        if (i > 0)
+            end += sprintf(end, " -> ");
+        write_position(&move->path[i], end);
+        end += strlen(end);
+    }
+    return str;
+}
+
+
+/* find_move gives the index of 'move' in the list, or -1 if it's not there. */
+int find_move(Move_list *moves, Move *move)
+{
+    for (int i = 0; i < moves->length; i++) {
+        Move *other = &moves->array[i];
+        if (other->length == move->length
+         && memcmp(other->path, move->path, move->length * sizeof(Position)) == 0)
+            return i;
+    }
+    return -1;
+}
+
+
+/* move_to_text writes the move in the usual notation (see checkers.h) into
+ * 'text' and returns it; 'type' tells whether it's a capture. */
+char *move_to_text(Move *move, Movtype type, char *text)
+{
+    char *end = text;
+    for (int i = 0; i < move->length; i++)
+    {
+        if (i > 0)
+            *end++ = type == CAPTURE ? 'x' : '-';
+        end += sprintf(end, "%c%d", 'a' + move->path[i].col, move->path[i].row + 1);
+    }
+    return text;
+}
+
+
+/* move_from_text reads a move in the usual notation and looks it up in the
+ * moves the current player can make, storing it in 'move'.  Returns false
+ * if the text isn't a move or the move can't be played. */
+bool move_from_text(Game_state *state, const char *text, Move *move)
+{
+    Move read;
+    read.length = 0;
+
+    const char *c = text;
+    while (read.length < MAXPATH)
+    {
+        int col = *c - 'a', row, length;
+        if (col < 0 || col >= BOARD_SIZE || sscanf(c + 1, "%d%n", &row, &length) != 1)
+            return false;
+        read.path[read.length].row = row - 1;
+        read.path[read.length].col = col;
+        read.length++;
+
+        c += 1 + length;
+        if (*c != '-' && *c != 'x')
+            break;
+        c++;
+    }
+    if (*c != '\0' && *c != '\n' && *c != ' ')
+        return false;
+
+    Move_list moves;
+    generate_moves(state, &moves);
+    int index = find_move(&moves, &read);
+    if (index < 0)
+        return false;
+    *move = moves.array[index];
+    return true;
+}
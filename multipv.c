@@ -0,0 +1,214 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include "checkers.h"
+
+/* multipv shows the best few movements of a position as the search deepens,
+ * each with its exact score and the line of play the search expects after
+ * it (see "Multi-PV" at search in ai.c).
+ *
+ * Usage: multipv [options] [POSITION]
+ *   --lines N      how many movements (default 3, at most MAXMULTIPV)
+ *   --depth N      how deep to search (default 12)
+ *   --movetime MS  ... or for how long (default: no limit)
+ *   --hash MB      transposition table size (default 64)
+ *   --checkpoint FILE  keep the search in FILE, to pick it up again later
+ *   --checkpoint-every S  ... saving it at most every S seconds (default 60)
+ *   --verify       check FILE's whole table against its checksum first
+ * POSITION is written like game_to_text writes it (quoted, it has a space);
+ * the default is the starting position.
+ *
+ * A long analysis can be stopped and resumed: with --checkpoint, the
+ * transposition table and where the search got to are saved to FILE after
+ * a depth is done (if the last save is S seconds old) and when interrupted
+ * (^C).  Next time, if FILE is there, the table is loaded from it instead
+ * (mapped, so however big it is the search starts right away; --hash is
+ * then the file's) and the search goes on with FILE's position, unless
+ * another POSITION is given.  For FILE's position, the lines of the last
+ * depth it had done are printed again and the search goes on with the next
+ * depth, starting from them; for another one, the table is all that's
+ * resumed.
+ *
+ * Each depth prints a line per movement as soon as it's done, from the
+ * point of view of the player to move:
+ *   info depth 8 multipv 1 score 1.5 nodes 20311 time 12 pv c3-d4 f6-e5 ...
+ */
+
+static int lines = 3;
+static int max_depth = 12;
+static long movetime = 0;
+static size_t hash_mb = 64;
+static const char *checkpoint_file = NULL;
+static long checkpoint_every = 60;
+static bool verify = false;
+
+/* What's saved with the table: the position, and how far the search got */
+typedef struct {
+    char position[POSITION_TEXT_LENGTH];
+    int depth;
+    int nlines;
+    Pv_line lines[MAXMULTIPV];
+} Checkpoint;
+
+typedef struct {
+    Game_state *state;
+    Ttable *tt;
+    long start;
+    long saved;  // when the checkpoint was last saved
+} Info;
+
+static void save_checkpoint(Search *searcher, Info *info)
+{
+    Checkpoint checkpoint;
+    memset(&checkpoint, 0, sizeof(checkpoint));
+    game_to_text(info->state, checkpoint.position);
+    checkpoint.depth = atomic_load(&searcher->depth);
+    checkpoint.nlines = searcher->nlines;
+    memcpy(checkpoint.lines, searcher->lines, sizeof(checkpoint.lines));
+
+    long start = now_ms();
+    if (!tt_save(info->tt, checkpoint_file, &checkpoint, sizeof(checkpoint)))
+        fprintf(stderr, "multipv: %s: %s\n", checkpoint_file, strerror(errno));
+    else
+        fprintf(stderr, "multipv: saved depth %d to %s in %ld ms\n",
+                checkpoint.depth, checkpoint_file, now_ms() - start);
+    info->saved = now_ms();
+}
+
+/* restore_checkpoint sets the search up to go on where the checkpoint's
+ * left off (it must be of the same position); returns false if it has
+ * nothing to go on from. */
+static bool restore_checkpoint(Search *searcher, Game_state *state, Checkpoint *checkpoint)
+{
+    Move_list moves;
+    generate_moves(state, &moves);
+    int nlines = checkpoint->nlines < lines ? checkpoint->nlines : lines;
+    if (checkpoint->depth < 1 || nlines < 1 || nlines > MAXMULTIPV)
+        return false;
+    for (int i = 0; i < nlines; i++)
+        if (checkpoint->lines[i].length < 1 || checkpoint->lines[i].length > MAXPV
+         || checkpoint->lines[i].moves[0] >= moves.length)
+            return false;
+
+    memcpy(searcher->lines, checkpoint->lines, nlines * sizeof(Pv_line));
+    searcher->nlines = nlines;
+    searcher->best = moves.array[checkpoint->lines[0].moves[0]];
+    atomic_store(&searcher->score, checkpoint->lines[0].score);
+    atomic_store(&searcher->depth, checkpoint->depth);
+    return true;
+}
+
+/* ^C stops the search, which then saves the checkpoint */
+static Search *running;
+
+static void on_signal(int signal)
+{
+    (void) signal;
+    atomic_store(&running->stop, true);
+}
+
+static void on_depth(Search *searcher, void *data)
+{
+    Info *info = data;
+    for (int i = 0; i < searcher->nlines; i++) {
+        char pv[MAXPV * MOVE_TEXT_LENGTH];
+        printf("info depth %d multipv %d score %.1f nodes %ld time %ld pv %s\n",
+               atomic_load(&searcher->depth), i + 1, searcher->lines[i].score,
+               atomic_load(&searcher->nodes), now_ms() - info->start,
+               pv_to_text(info->state, &searcher->lines[i], pv, sizeof(pv)));
+    }
+    fflush(stdout);
+
+    if (checkpoint_file != NULL && now_ms() - info->saved >= checkpoint_every * 1000)
+        save_checkpoint(searcher, info);
+}
+
+static void usage()
+{
+    fprintf(stderr, "usage: multipv [--lines N] [--depth N] [--movetime MS] [--hash MB]"
+                    " [--checkpoint FILE [--checkpoint-every S] [--verify]] [POSITION]\n");
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv)
+{
+    Game_state state;
+    game_setup(&state);
+    bool position_given = false;
+    for (int i = 1; i < argc; i++) {
+        if      (strcmp("--lines", argv[i]) == 0 && i+1 < argc)     lines = atoi(argv[++i]);
+        else if (strcmp("--depth", argv[i]) == 0 && i+1 < argc)     max_depth = atoi(argv[++i]);
+        else if (strcmp("--movetime", argv[i]) == 0 && i+1 < argc)  movetime = atol(argv[++i]);
+        else if (strcmp("--hash", argv[i]) == 0 && i+1 < argc)      hash_mb = atol(argv[++i]);
+        else if (strcmp("--checkpoint", argv[i]) == 0 && i+1 < argc)        checkpoint_file = argv[++i];
+        else if (strcmp("--checkpoint-every", argv[i]) == 0 && i+1 < argc)  checkpoint_every = atol(argv[++i]);
+        else if (strcmp("--verify", argv[i]) == 0)                          verify = true;
+        else if (argv[i][0] != '-' && game_from_text(&state, argv[i]))      position_given = true;
+        else usage();
+    }
+    if (lines < 1 || lines > MAXMULTIPV || max_depth < 0 || hash_mb == 0 || checkpoint_every < 0
+     || (verify && checkpoint_file == NULL))
+        usage();
+
+    Ttable tt;
+    Checkpoint checkpoint;
+    bool resumed = false;
+    if (checkpoint_file != NULL) {
+        if (verify && !tt_verify_file(checkpoint_file) && errno != ENOENT) {
+            fprintf(stderr, "multipv: %s: %s\n", checkpoint_file,
+                    errno == EINVAL ? "damaged, or not a table of this build's" : strerror(errno));
+            return EXIT_FAILURE;
+        }
+        long start = now_ms();
+        resumed = tt_load(&tt, checkpoint_file, &checkpoint, sizeof(checkpoint));
+        if (!resumed && errno != ENOENT) {
+            fprintf(stderr, "multipv: %s: %s\n", checkpoint_file,
+                    errno == EINVAL ? "damaged, or not a table of this build's" : strerror(errno));
+            return EXIT_FAILURE;
+        }
+        if (resumed) {
+            if (!position_given && !game_from_text(&state, checkpoint.position)) {
+                fprintf(stderr, "multipv: %s: damaged position\n", checkpoint_file);
+                return EXIT_FAILURE;
+            }
+            fprintf(stderr, "multipv: loaded %zu MB from %s in %ld ms (it had got to depth %d)\n",
+                    tt.mapped >> 20, checkpoint_file, now_ms() - start, checkpoint.depth);
+        }
+    }
+
+    Search *searcher = malloc(sizeof(Search));
+    if (searcher == NULL || (!resumed && !tt_init(&tt, hash_mb))) {
+        fprintf(stderr, "multipv: out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    Info info = { &state, &tt, now_ms(), now_ms() };
+    search_init(searcher, max_depth, movetime, &tt, NULL);
+    searcher->multipv = lines;
+    searcher->on_depth = on_depth;
+    searcher->on_depth_data = &info;
+
+    char text[POSITION_TEXT_LENGTH];
+    if (resumed && strcmp(game_to_text(&state, text), checkpoint.position) == 0
+     && restore_checkpoint(searcher, &state, &checkpoint))
+        on_depth(searcher, &info);
+
+    running = searcher;
+    signal(SIGINT, on_signal);
+    search(&state, searcher);
+    signal(SIGINT, SIG_DFL);
+    if (checkpoint_file != NULL)
+        save_checkpoint(searcher, &info);
+
+    Move_list moves;
+    generate_moves(&state, &moves);
+    char move[MOVE_TEXT_LENGTH];
+    if (moves.length > 0)
+        printf("bestmove %s\n", move_to_text(&searcher->best, moves.type, move));
+
+    tt_free(&tt);
+    free(searcher);
+    return 0;
+}
@@ -0,0 +1,203 @@
+#include <stdio.h>
+#include <string.h>
+#include "checkers.h"
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/* The weights the evaluation uses; all zeros (and not used by evaluate)
+ * until nnue_load reads some.  They're only read while searching, so any
+ * number of threads can share them. */
+static Nnue_weights weights;
+bool nnue_loaded = false;
+
+// The output weights widened to 16 bits, for the SSE2 version of the output
+static int16_t output_weights16[NNUE_HIDDEN];
+
+// (the vector loops take 32 hidden units at a time)
+_Static_assert(NNUE_HIDDEN % 32 == 0, "NNUE_HIDDEN must be a multiple of 32");
+
+
+/* nnue_read reads the weights file at 'path' (as written by nnue_save).
+ * Returns false if the file isn't there or was made for another board or
+ * network size. */
+bool nnue_read(const char *path, Nnue_weights *read)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+        return false;
+
+    char magic[4];
+    uint32_t version;
+    uint16_t sizes[3];
+    bool ok = fread(magic, 1, 4, file) == 4 && memcmp(magic, NNUE_MAGIC, 4) == 0
+           && fread(&version, sizeof(version), 1, file) == 1 && version == NNUE_VERSION
+           && fread(sizes, sizeof(sizes), 1, file) == 1
+           && sizes[0] == BOARD_SIZE && sizes[1] == NNUE_FEATURES && sizes[2] == NNUE_HIDDEN
+           && fread(read, sizeof(*read), 1, file) == 1;
+    fclose(file);
+    return ok;
+}
+
+/* nnue_load makes evaluate use the weights in the file at 'path'; if they
+ * can't be read, it keeps the weights it had and returns false.  Positions
+ * set up before loading have to be nnue_refresh'ed. */
+bool nnue_load(const char *path)
+{
+    static Nnue_weights loaded;
+    if (!nnue_read(path, &loaded))
+        return false;
+
+    weights = loaded;
+    for (int i = 0; i < NNUE_HIDDEN; i++)
+        output_weights16[i] = weights.output_weights[i];
+    nnue_loaded = true;
+    return true;
+}
+
+/* nnue_save writes the weights to a file nnue_load can read. */
+bool nnue_save(const char *path, Nnue_weights *saved)
+{
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+        return false;
+
+    uint32_t version = NNUE_VERSION;
+    uint16_t sizes[3] = { BOARD_SIZE, NNUE_FEATURES, NNUE_HIDDEN };
+    bool ok = fwrite(NNUE_MAGIC, 1, 4, file) == 4
+           && fwrite(&version, sizeof(version), 1, file) == 1
+           && fwrite(sizes, sizeof(sizes), 1, file) == 1
+           && fwrite(saved, sizeof(*saved), 1, file) == 1;
+    return fclose(file) == 0 && ok;
+}
+
+
+/* nnue_feature gives the input feature of 'piece' being at 'pos'.  Pieces
+ * only ever stand on the dark squares, half of each row. */
+int nnue_feature(Position pos, Piece piece)
+{
+    return piece * NNUE_SQUARES + pos.row * (BOARD_SIZE / 2) + pos.col / 2;
+}
+
+/* The accumulator gets a feature's column of weights added or taken away.
+ * This is most of the work of keeping it up to date, so it's done 16 or 8
+ * numbers at a time where the processor can. */
+static void add_feature(int16_t *accumulator, int feature)
+{
+    const int16_t *column = weights.feature_weights[feature];
+#if defined(__AVX2__)
+    for (int i = 0; i < NNUE_HIDDEN; i += 16) {
+        __m256i a = _mm256_loadu_si256((__m256i *) &accumulator[i]);
+        __m256i c = _mm256_loadu_si256((const __m256i *) &column[i]);
+        _mm256_storeu_si256((__m256i *) &accumulator[i], _mm256_add_epi16(a, c));
+    }
+#elif defined(__SSE2__)
+    for (int i = 0; i < NNUE_HIDDEN; i += 8) {
+        __m128i a = _mm_loadu_si128((__m128i *) &accumulator[i]);
+        __m128i c = _mm_loadu_si128((const __m128i *) &column[i]);
+        _mm_storeu_si128((__m128i *) &accumulator[i], _mm_add_epi16(a, c));
+    }
+#else
+    for (int i = 0; i < NNUE_HIDDEN; i++)
+        accumulator[i] += column[i];
+#endif
+}
+
+static void remove_feature(int16_t *accumulator, int feature)
+{
+    const int16_t *column = weights.feature_weights[feature];
+#if defined(__AVX2__)
+    for (int i = 0; i < NNUE_HIDDEN; i += 16) {
+        __m256i a = _mm256_loadu_si256((__m256i *) &accumulator[i]);
+        __m256i c = _mm256_loadu_si256((const __m256i *) &column[i]);
+        _mm256_storeu_si256((__m256i *) &accumulator[i], _mm256_sub_epi16(a, c));
+    }
+#elif defined(__SSE2__)
+    for (int i = 0; i < NNUE_HIDDEN; i += 8) {
+        __m128i a = _mm_loadu_si128((__m128i *) &accumulator[i]);
+        __m128i c = _mm_loadu_si128((const __m128i *) &column[i]);
+        _mm_storeu_si128((__m128i *) &accumulator[i], _mm_sub_epi16(a, c));
+    }
+#else
+    for (int i = 0; i < NNUE_HIDDEN; i++)
+        accumulator[i] -= column[i];
+#endif
+}
+
+void nnue_refresh(Game_state *state)
+{
+    memcpy(state->accumulator, weights.hidden_bias, sizeof(state->accumulator));
+
+    Position p;
+    for (p.row = 0; p.row < BOARD_SIZE; p.row++)
+        for (p.col = 0; p.col < BOARD_SIZE; p.col++) {
+            Piece piece = get_piece(state, p);
+            if (!is_empty(piece))
+                add_feature(state->accumulator, nnue_feature(p, piece));
+        }
+}
+
+/* nnue_update is set_piece's part: 'removed' is what was at 'pos' and 'added'
+ * what's there now (either may be EMPTY).  (game_setup calls set_piece on a
+ * board that isn't set up yet, so anything that isn't a piece is ignored;
+ * it refreshes the accumulator afterwards anyway.) */
+void nnue_update(Game_state *state, Position pos, Piece removed, Piece added)
+{
+    if (removed < EMPTY)  remove_feature(state->accumulator, nnue_feature(pos, removed));
+    if (added < EMPTY)    add_feature(state->accumulator, nnue_feature(pos, added));
+}
+
+/* nnue_evaluate runs the rest of the network on the position's accumulator:
+ * the hidden units clip their sums to [0, NNUE_QA] and the output is their
+ * weighted sum. */
+double nnue_evaluate(Game_state *state)
+{
+    const int16_t *accumulator = state->accumulator;
+    int32_t sum = 0;
+
+#if defined(__AVX2__)
+    // 32 hidden units at a time: clip them to bytes, multiply by the (signed
+    // byte) output weights and add up in pairs, then in 32 bits
+    __m256i zero = _mm256_setzero_si256(), top = _mm256_set1_epi16(NNUE_QA);
+    __m256i ones = _mm256_set1_epi16(1), total = _mm256_setzero_si256();
+    for (int i = 0; i < NNUE_HIDDEN; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i *) &accumulator[i]);
+        __m256i b = _mm256_loadu_si256((const __m256i *) &accumulator[i + 16]);
+        a = _mm256_min_epi16(_mm256_max_epi16(a, zero), top);
+        b = _mm256_min_epi16(_mm256_max_epi16(b, zero), top);
+        // packus works within 128-bit lanes; the permutation puts the units
+        // back in order
+        __m256i units = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8);
+        __m256i w = _mm256_loadu_si256((const __m256i *) &weights.output_weights[i]);
+        __m256i products = _mm256_madd_epi16(_mm256_maddubs_epi16(units, w), ones);
+        total = _mm256_add_epi32(total, products);
+    }
+    __m128i half = _mm_add_epi32(_mm256_castsi256_si128(total),
+                                 _mm256_extracti128_si256(total, 1));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0x4E));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0xB1));
+    sum = _mm_cvtsi128_si32(half);
+#elif defined(__SSE2__)
+    __m128i zero = _mm_setzero_si128(), top = _mm_set1_epi16(NNUE_QA);
+    __m128i total = _mm_setzero_si128();
+    for (int i = 0; i < NNUE_HIDDEN; i += 8) {
+        __m128i a = _mm_loadu_si128((const __m128i *) &accumulator[i]);
+        a = _mm_min_epi16(_mm_max_epi16(a, zero), top);
+        __m128i w = _mm_loadu_si128((const __m128i *) &output_weights16[i]);
+        total = _mm_add_epi32(total, _mm_madd_epi16(a, w));
+    }
+    total = _mm_add_epi32(total, _mm_shuffle_epi32(total, 0x4E));
+    total = _mm_add_epi32(total, _mm_shuffle_epi32(total, 0xB1));
+    sum = _mm_cvtsi128_si32(total);
+#else
+    for (int i = 0; i < NNUE_HIDDEN; i++) {
+        int unit = accumulator[i];
+        if (unit < 0)        unit = 0;
+        if (unit > NNUE_QA)  unit = NNUE_QA;
+        sum += unit * output_weights16[i];
+    }
+#endif
+
+    return (sum + weights.output_bias) * NNUE_SCALE / (NNUE_QA * NNUE_QB);
+}
@@ -0,0 +1,269 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "checkers.h"
+
+/* nnue_train makes weights for the neural evaluation (see nnue.c) out of
+ * self-play games.
+ *
+ * Usage: nnue_train [options]
+ *   --games N        self-play games to learn from (default 200)
+ *   --depth N        how deep the engine searches in them (default 4)
+ *   --random N       plies played at random at the start of each game, so
+ *                    that the games differ (default 8)
+ *   --epochs N       passes over the positions (default 20)
+ *   --rate X         learning rate (default 0.01)
+ *   --weights FILE   play the games with these weights (otherwise with the
+ *                    hand-written evaluation), and start learning from them
+ *   --out FILE       where the new weights go (default checkers.nnue)
+ *
+ * Every position the engine searched becomes a sample whose target is half
+ * the search's score and half the game's result (a win is worth NNUE_SCALE).
+ * The network is trained in floating point by plain stochastic gradient
+ * descent, all on the CPU; since a position only has a few features, each
+ * step only touches their columns of weights.  Weights are kept within what
+ * the quantized network can hold, and quantized when saved. */
+
+static int ngames = 200;
+static int depth = 4;
+static int random_plies = 8;
+static int epochs = 20;
+static double rate = 0.01;
+
+#define MAXFEATURES (2 * NUMPIECES)
+#define MAXPLIES 300
+
+typedef struct {
+    uint16_t features[MAXFEATURES];
+    uint8_t nfeatures;
+    float score;   // the search's, from white's point of view, in NNUE_SCALE units
+    float target;
+} Sample;
+
+/* The network in floating point, the way it's trained */
+typedef struct {
+    float feature_weights[NNUE_FEATURES][NNUE_HIDDEN];
+    float hidden_bias[NNUE_HIDDEN];
+    float output_weights[NNUE_HIDDEN];
+    float output_bias;
+} Network;
+
+static Sample *samples;
+static int nsamples, capacity;
+
+static double random_unit()
+{
+    return rand() / (RAND_MAX + 1.0);
+}
+
+static bool add_sample(Game_state *state, double score)
+{
+    if (nsamples == capacity) {
+        capacity = capacity > 0 ? capacity * 2 : 4096;
+        samples = realloc(samples, capacity * sizeof(Sample));
+        if (samples == NULL)
+            return false;
+    }
+
+    Sample *sample = &samples[nsamples++];
+    sample->nfeatures = 0;
+    Position p;
+    for (p.row = 0; p.row < BOARD_SIZE; p.row++)
+        for (p.col = 0; p.col < BOARD_SIZE; p.col++) {
+            Piece piece = get_piece(state, p);
+            if (!is_empty(piece))
+                sample->features[sample->nfeatures++] = nnue_feature(p, piece);
+        }
+
+    // Scores past a few stones (or wins) say little more about the position
+    double white_score = state->current_player == WHITE ? score : -score;
+    white_score /= NNUE_SCALE;
+    if (white_score > 3)   white_score = 3;
+    if (white_score < -3)  white_score = -3;
+    sample->score = white_score;
+    return true;
+}
+
+/* self_play plays a game of the engine against itself, adding a sample for
+ * each position it searched. */
+static bool self_play(Ttable *tt, Search *searcher)
+{
+    Game_state state;
+    game_setup(&state);
+    History history;
+    history_init(&history, DEFAULT_NO_PROGRESS_LIMIT);
+    int first = nsamples;
+
+    for (int ply = 0; ply < MAXPLIES && state.situation == ONGOING; ply++) {
+        Move_list moves;
+        generate_moves(&state, &moves);
+        if (moves.length == 0) {
+            state.situation = state.current_player == WHITE ? BLACK_WINS : WHITE_WINS;
+            break;
+        }
+
+        Move move;
+        if (ply < random_plies) {
+            move = moves.array[rand() % moves.length];
+        } else {
+            search_init(searcher, depth, 0, tt, &history);
+            double score = search(&state, searcher);
+            move = searcher->best;
+            if (!add_sample(&state, score))
+                return false;
+        }
+        history_push(&history, &state);
+        game_apply_move(&state, &move);
+        update_draw_situation(&state, &history);
+    }
+
+    double result = state.situation == WHITE_WINS ?  1
+                  : state.situation == BLACK_WINS ? -1
+                  : 0;
+    for (int i = first; i < nsamples; i++)
+        samples[i].target = (samples[i].score + result) / 2;
+    return true;
+}
+
+
+static float clip(float x, float limit)
+{
+    return x > limit ? limit : x < -limit ? -limit : x;
+}
+
+// How far the weights may go so that the quantized network doesn't overflow
+#define HIDDEN_LIMIT 2.0f
+#define OUTPUT_LIMIT (127.0f / NNUE_QB)
+
+/* train_step does forward and backward on one sample; returns its error */
+static double train_step(Network *net, Sample *sample)
+{
+    float sums[NNUE_HIDDEN], units[NNUE_HIDDEN];
+    memcpy(sums, net->hidden_bias, sizeof(sums));
+    for (int f = 0; f < sample->nfeatures; f++)
+        for (int i = 0; i < NNUE_HIDDEN; i++)
+            sums[i] += net->feature_weights[sample->features[f]][i];
+
+    float output = net->output_bias;
+    for (int i = 0; i < NNUE_HIDDEN; i++) {
+        units[i] = sums[i] < 0 ? 0 : sums[i] > 1 ? 1 : sums[i];
+        output += net->output_weights[i] * units[i];
+    }
+
+    float error = output - sample->target;
+    float step = rate * error;
+    for (int i = 0; i < NNUE_HIDDEN; i++) {
+        float hidden_step = sums[i] > 0 && sums[i] < 1 ? step * net->output_weights[i] : 0;
+        net->output_weights[i] = clip(net->output_weights[i] - step * units[i], OUTPUT_LIMIT);
+        if (hidden_step == 0)
+            continue;
+        net->hidden_bias[i] = clip(net->hidden_bias[i] - hidden_step, HIDDEN_LIMIT);
+        for (int f = 0; f < sample->nfeatures; f++) {
+            float *weight = &net->feature_weights[sample->features[f]][i];
+            *weight = clip(*weight - hidden_step, HIDDEN_LIMIT);
+        }
+    }
+    net->output_bias -= step;
+    return error * error;
+}
+
+static void quantize(Network *net, Nnue_weights *out)
+{
+    for (int f = 0; f < NNUE_FEATURES; f++)
+        for (int i = 0; i < NNUE_HIDDEN; i++)
+            out->feature_weights[f][i] = (int16_t) lrintf(net->feature_weights[f][i] * NNUE_QA);
+    for (int i = 0; i < NNUE_HIDDEN; i++) {
+        out->hidden_bias[i] = (int16_t) lrintf(net->hidden_bias[i] * NNUE_QA);
+        out->output_weights[i] = (int8_t) lrintf(net->output_weights[i] * NNUE_QB);
+    }
+    out->output_bias = (int32_t) lrintf(net->output_bias * NNUE_QA * NNUE_QB);
+}
+
+static void dequantize(Nnue_weights *in, Network *net)
+{
+    for (int f = 0; f < NNUE_FEATURES; f++)
+        for (int i = 0; i < NNUE_HIDDEN; i++)
+            net->feature_weights[f][i] = (float) in->feature_weights[f][i] / NNUE_QA;
+    for (int i = 0; i < NNUE_HIDDEN; i++) {
+        net->hidden_bias[i] = (float) in->hidden_bias[i] / NNUE_QA;
+        net->output_weights[i] = (float) in->output_weights[i] / NNUE_QB;
+    }
+    net->output_bias = (float) in->output_bias / (NNUE_QA * NNUE_QB);
+}
+
+static void usage()
+{
+    fprintf(stderr, "usage: nnue_train [--games N] [--depth N] [--random N]"
+                    " [--epochs N] [--rate X] [--weights FILE] [--out FILE]\n");
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv)
+{
+    const char *from = NULL, *out = "checkers.nnue";
+    for (int i = 1; i < argc; i++) {
+        if      (strcmp("--games", argv[i]) == 0 && i+1 < argc)    ngames = atoi(argv[++i]);
+        else if (strcmp("--depth", argv[i]) == 0 && i+1 < argc)    depth = atoi(argv[++i]);
+        else if (strcmp("--random", argv[i]) == 0 && i+1 < argc)   random_plies = atoi(argv[++i]);
+        else if (strcmp("--epochs", argv[i]) == 0 && i+1 < argc)   epochs = atoi(argv[++i]);
+        else if (strcmp("--rate", argv[i]) == 0 && i+1 < argc)     rate = atof(argv[++i]);
+        else if (strcmp("--weights", argv[i]) == 0 && i+1 < argc)  from = argv[++i];
+        else if (strcmp("--out", argv[i]) == 0 && i+1 < argc)      out = argv[++i];
+        else usage();
+    }
+
+    static Network net;
+    static Nnue_weights quantized;
+    if (from != NULL) {
+        if (!nnue_read(from, &quantized) || !nnue_load(from)) {
+            fprintf(stderr, "%s: not a weights file for this board\n", from);
+            return EXIT_FAILURE;
+        }
+        dequantize(&quantized, &net);
+    } else {
+        for (int f = 0; f < NNUE_FEATURES; f++)
+            for (int i = 0; i < NNUE_HIDDEN; i++)
+                net.feature_weights[f][i] = (random_unit() - 0.5) * 0.2;
+        for (int i = 0; i < NNUE_HIDDEN; i++) {
+            net.hidden_bias[i] = 0.5;
+            net.output_weights[i] = (random_unit() - 0.5) * 0.2;
+        }
+    }
+
+    Ttable tt;
+    tt_init(&tt, 16);
+    Search *searcher = malloc(sizeof(Search));
+    for (int game = 0; game < ngames; game++) {
+        if (searcher == NULL || !self_play(&tt, searcher)) {
+            fprintf(stderr, "out of memory\n");
+            return EXIT_FAILURE;
+        }
+        fprintf(stderr, "\rgame %d/%d, %d positions", game + 1, ngames, nsamples);
+    }
+    fprintf(stderr, "\n");
+    free(searcher);
+    tt_free(&tt);
+
+    for (int epoch = 0; epoch < epochs; epoch++) {
+        // Shuffle, so that the positions of a game aren't learned in a row
+        for (int i = nsamples - 1; i > 0; i--) {
+            int j = rand() % (i + 1);
+            Sample swap = samples[i];
+            samples[i] = samples[j];
+            samples[j] = swap;
+        }
+        double total = 0;
+        for (int i = 0; i < nsamples; i++)
+            total += train_step(&net, &samples[i]);
+        fprintf(stderr, "epoch %d: mean squared error %.4f\n", epoch + 1,
+                nsamples > 0 ? total / nsamples : 0);
+    }
+
+    quantize(&net, &quantized);
+    if (!nnue_save(out, &quantized)) {
+        perror(out);
+        return EXIT_FAILURE;
+    }
+    return 0;
+}
@@ -0,0 +1,683 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "checkers.h"
+
+/* opening searches the opening deeper than one search can, by splitting it
+ * into work units that any number of processes -- on this machine or on
+ * others sharing the directory -- search independently.
+ *
+ * Usage: opening split DIR [--ply N] [--depth N]
+ *        opening work DIR [--hash MB] [--stale S]
+ *        opening status DIR [--stale S]
+ *        opening combine DIR
+ *
+ *   split    writes a unit for every position N plies (default 4) after
+ *            game_setup's, each to be searched --depth plies (default 12)
+ *            deeper; positions reached in several ways are one unit
+ *   work     takes units and searches them until there are none left; run
+ *            as many as there are cores (or machines)
+ *   status   how many units are waiting, being searched and done
+ *   combine  backs the units' scores up to the starting position, with
+ *            minimax, and prints the score of every first movement
+ *
+ * DIR holds the job's settings (DIR/job) and a directory for each state a
+ * unit can be in:
+ *   DIR/pending/unit-000123                 waiting
+ *   DIR/claimed/unit-000123.HOST.PID        being searched by that worker
+ *   DIR/done/unit-000123                    searched: its position, score,
+ *                                           best movement, depth and nodes
+ *   DIR/failed/unit-000123                  not a unit a worker can read
+ * A worker claims a unit by renaming it from pending into claimed, which
+ * only one of them can do; results are written to a temporary file and
+ * renamed into place, so a unit in done is always complete.  While it
+ * searches, the worker touches its claim every few seconds.  A claim that
+ * hasn't been touched for --stale seconds (default 60) is taken as the
+ * worker having died, and the next worker looking for work puts the unit
+ * back into pending.  (If the worker was only slow, the unit gets searched
+ * twice, which does no harm.)  A unit that doesn't parse is moved into
+ * failed instead of being searched, so that it isn't taken over and over;
+ * status counts them and combine reports their positions missing.
+ *
+ * Units are searched without knowing the movements that led to them, so
+ * draws by repetition across the split aren't seen -- not that the opening
+ * has many. */
+
+static int split_ply = 4;
+static int depth = 12;
+static size_t hash_mb = 64;
+static long stale_s = 60;
+
+#define UNIT_PREFIX "unit-"
+
+
+// {{{ Files
+static bool make_directory(const char *dir, const char *name)
+{
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    if (mkdir(path, 0755) != 0 && errno != EEXIST) {
+        perror(path);
+        return false;
+    }
+    return true;
+}
+
+/* write_file writes 'text' to 'path' through a temporary file renamed into
+ * place, so that nobody ever sees it half written */
+static bool write_file(const char *path, const char *text)
+{
+    char temporary[4200];
+    snprintf(temporary, sizeof(temporary), "%s.%d.tmp", path, (int) getpid());
+    FILE *out = fopen(temporary, "w");
+    if (out == NULL) {
+        perror(temporary);
+        return false;
+    }
+    bool ok = fputs(text, out) >= 0;
+    ok = fflush(out) == 0 && fsync(fileno(out)) == 0 && ok;
+    if (fclose(out) != 0 || !ok || rename(temporary, path) != 0) {
+        perror(path);
+        unlink(temporary);
+        return false;
+    }
+    return true;
+}
+
+/* read_value finds the line "key value" in a file's text and copies the
+ * value into 'value'; returns false if there's no such line */
+static bool read_value(const char *text, const char *key, char *value, size_t size)
+{
+    size_t length = strlen(key);
+    for (const char *line = text; *line != '\0'; ) {
+        size_t line_length = strcspn(line, "\n");
+        if (strncmp(line, key, length) == 0 && line[length] == ' ') {
+            snprintf(value, size, "%.*s", (int) (line_length - length - 1), line + length + 1);
+            return true;
+        }
+        line += line_length + (line[line_length] == '\n');
+    }
+    return false;
+}
+
+static bool read_file(const char *path, char *text, size_t size)
+{
+    FILE *in = fopen(path, "r");
+    if (in == NULL)
+        return false;
+    size_t length = fread(text, 1, size - 1, in);
+    text[length] = '\0';
+    fclose(in);
+    return true;
+}
+
+static int compare_names(const void *a, const void *b)
+{
+    return strcmp(*(char * const *) a, *(char * const *) b);
+}
+
+/* list_units gives the names in DIR/sub that are units (or claims), sorted;
+ * returns how many (free them with free_names) */
+static int list_units(const char *dir, const char *sub, char ***names)
+{
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%s", dir, sub);
+    *names = NULL;
+    DIR *d = opendir(path);
+    if (d == NULL)
+        return 0;
+
+    int count = 0, capacity = 0;
+    struct dirent *entry;
+    while ((entry = readdir(d)) != NULL) {
+        if (strncmp(entry->d_name, UNIT_PREFIX, strlen(UNIT_PREFIX)) != 0
+            || strstr(entry->d_name, ".tmp") != NULL)
+            continue;
+        if (count == capacity) {
+            capacity = capacity > 0 ? capacity * 2 : 256;
+            char **more = realloc(*names, capacity * sizeof(char *));
+            if (more == NULL)
+                break;
+            *names = more;
+        }
+        (*names)[count++] = strdup(entry->d_name);
+    }
+    closedir(d);
+    if (count > 0)
+        qsort(*names, count, sizeof(char *), compare_names);
+    return count;
+}
+
+static void free_names(char **names, int count)
+{
+    for (int i = 0; i < count; i++)
+        free(names[i]);
+    free(names);
+}
+
+/* last_touched is when a claim was made or last touched by its worker.
+ * Claiming renames the unit's file, which keeps its old modification time
+ * but updates its change time, so either may be the later one. */
+static time_t last_touched(const char *path)
+{
+    struct stat st;
+    if (stat(path, &st) != 0)
+        return 0;
+    return st.st_mtime > st.st_ctime ? st.st_mtime : st.st_ctime;
+}
+
+/* The unit a claim is for: its name up to the first '.' */
+static void claim_unit(const char *claim, char *unit, size_t size)
+{
+    snprintf(unit, size, "%.*s", (int) strcspn(claim, "."), claim);
+}
+
+static bool read_job(const char *dir)
+{
+    char path[4096], text[256];
+    snprintf(path, sizeof(path), "%s/job", dir);
+    if (!read_file(path, text, sizeof(text))) {
+        fprintf(stderr, "%s: no job here (see opening split)\n", dir);
+        return false;
+    }
+    char ply[32], deep[32];
+    if (!read_value(text, "ply", ply, sizeof(ply)) || !read_value(text, "depth", deep, sizeof(deep))) {
+        fprintf(stderr, "%s: bad job file\n", path);
+        return false;
+    }
+    split_ply = atoi(ply);
+    depth = atoi(deep);
+    return true;
+}
+// }}}
+
+
+// {{{ split
+typedef struct {
+    uint64_t hash;
+    char text[POSITION_TEXT_LENGTH];
+} Leaf;
+
+typedef struct {
+    Leaf *leaves;
+    long count, capacity;
+} Leaves;
+
+static bool collect(Game_state *state, int ply, Leaves *leaves)
+{
+    Move_list moves;
+    generate_moves(state, &moves);
+    if (moves.length == 0)
+        return true;  // decided already; combine sees that by itself
+
+    if (ply == split_ply) {
+        if (leaves->count == leaves->capacity) {
+            leaves->capacity = leaves->capacity > 0 ? leaves->capacity * 2 : 1024;
+            Leaf *more = realloc(leaves->leaves, leaves->capacity * sizeof(Leaf));
+            if (more == NULL)
+                return false;
+            leaves->leaves = more;
+        }
+        Leaf *leaf = &leaves->leaves[leaves->count++];
+        leaf->hash = state->hash;
+        game_to_text(state, leaf->text);
+        return true;
+    }
+
+    for (int i = 0; i < moves.length; i++) {
+        Game_state next;
+        game_copy(&next, state);
+        game_apply_move(&next, &moves.array[i]);
+        if (!collect(&next, ply + 1, leaves))
+            return false;
+    }
+    return true;
+}
+
+static int compare_leaves(const void *a, const void *b)
+{
+    const Leaf *x = a, *y = b;
+    return x->hash < y->hash ? -1 : x->hash > y->hash;
+}
+
+static int split(const char *dir)
+{
+    char path[4096], text[512];
+    snprintf(path, sizeof(path), "%s/job", dir);
+    if (access(path, F_OK) == 0) {
+        fprintf(stderr, "%s: there's a job here already\n", dir);
+        return EXIT_FAILURE;
+    }
+
+    Game_state state;
+    game_setup(&state);
+    Leaves leaves = { NULL, 0, 0 };
+    if (!collect(&state, 0, &leaves)) {
+        fprintf(stderr, "opening: out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    // The same position reached in different orders is one unit
+    qsort(leaves.leaves, leaves.count, sizeof(Leaf), compare_leaves);
+    long units = 0;
+    for (long i = 0; i < leaves.count; i++)
+        if (i == 0 || leaves.leaves[i].hash != leaves.leaves[i - 1].hash)
+            leaves.leaves[units++] = leaves.leaves[i];
+
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+        perror(dir);
+        return EXIT_FAILURE;
+    }
+    if (!make_directory(dir, "pending") || !make_directory(dir, "claimed")
+        || !make_directory(dir, "done") || !make_directory(dir, "failed"))
+        return EXIT_FAILURE;
+
+    for (long i = 0; i < units; i++) {
+        snprintf(path, sizeof(path), "%s/pending/" UNIT_PREFIX "%06ld", dir, i);
+        snprintf(text, sizeof(text), "position %s\ndepth %d\n", leaves.leaves[i].text, depth);
+        if (!write_file(path, text))
+            return EXIT_FAILURE;
+    }
+
+    // Written last: until it's there, there's no job to work on
+    snprintf(path, sizeof(path), "%s/job", dir);
+    snprintf(text, sizeof(text), "ply %d\ndepth %d\nunits %ld\n", split_ply, depth, units);
+    if (!write_file(path, text))
+        return EXIT_FAILURE;
+
+    printf("%ld units (%ld positions at ply %d), each searched %d plies deep\n",
+           units, leaves.count, split_ply, depth);
+    free(leaves.leaves);
+    return 0;
+}
+// }}}
+
+
+// {{{ work
+/* The claim the worker is searching, which the heartbeat thread keeps
+ * touching so that nobody takes it for abandoned */
+static pthread_mutex_t heartbeat_lock = PTHREAD_MUTEX_INITIALIZER;
+static char heartbeat_path[4096];
+
+static void *heartbeat_thread(void *arg)
+{
+    (void) arg;
+    long interval = stale_s / 4 > 0 ? stale_s / 4 : 1;
+    for (;;) {
+        sleep(interval);
+        pthread_mutex_lock(&heartbeat_lock);
+        if (heartbeat_path[0] != '\0')
+            utimensat(AT_FDCWD, heartbeat_path, NULL, 0);
+        pthread_mutex_unlock(&heartbeat_lock);
+    }
+    return NULL;
+}
+
+static void set_heartbeat(const char *path)
+{
+    pthread_mutex_lock(&heartbeat_lock);
+    snprintf(heartbeat_path, sizeof(heartbeat_path), "%s", path);
+    pthread_mutex_unlock(&heartbeat_lock);
+}
+
+/* reissue puts the units of claims nobody has touched for stale_s seconds
+ * back into pending (or just drops the claim, if the unit got done after
+ * all); returns how many claims are left */
+static int reissue(const char *dir)
+{
+    char **claims;
+    int nclaims = list_units(dir, "claimed", &claims);
+    int left = nclaims;
+    time_t now = time(NULL);
+    for (int i = 0; i < nclaims; i++) {
+        char claim[4096], unit[256], target[4096];
+        snprintf(claim, sizeof(claim), "%s/claimed/%s", dir, claims[i]);
+        time_t touched = last_touched(claim);
+        if (touched == 0 || now - touched < stale_s)
+            continue;
+
+        claim_unit(claims[i], unit, sizeof(unit));
+        snprintf(target, sizeof(target), "%s/done/%s", dir, unit);
+        if (access(target, F_OK) == 0) {
+            unlink(claim);
+        } else {
+            snprintf(target, sizeof(target), "%s/pending/%s", dir, unit);
+            if (rename(claim, target) != 0)
+                continue;  // someone else got there first
+            printf("%s: reissued (%s stopped)\n", unit, claims[i] + strlen(unit) + 1);
+        }
+        left--;
+    }
+    free_names(claims, nclaims);
+    return left;
+}
+
+/* claim takes a pending unit, renaming it to 'claim_path'; returns false if
+ * there's none left.  Workers start looking at different places in the
+ * list, so they don't all go for the same unit. */
+static bool claim(const char *dir, const char *worker, char *unit, size_t size,
+                  char *claim_path, size_t claim_size)
+{
+    char **names;
+    int count = list_units(dir, "pending", &names);
+    bool claimed = false;
+    for (int k = 0; k < count && !claimed; k++) {
+        const char *name = names[(k + getpid()) % count];
+        char from[4096];
+        snprintf(from, sizeof(from), "%s/pending/%s", dir, name);
+        snprintf(claim_path, claim_size, "%s/claimed/%s.%s", dir, name, worker);
+        if (rename(from, claim_path) == 0) {
+            utimensat(AT_FDCWD, claim_path, NULL, 0);
+            snprintf(unit, size, "%s", name);
+            claimed = true;
+        }
+    }
+    free_names(names, count);
+    return claimed;
+}
+
+static bool search_unit(const char *dir, const char *unit, const char *claim_path,
+                        Ttable *tt, Search *searcher)
+{
+    char text[1024], position[POSITION_TEXT_LENGTH], value[32];
+    Game_state state;
+    if (!read_file(claim_path, text, sizeof(text)))
+        return false;  // taken for abandoned and reissued already
+    if (!read_value(text, "position", position, sizeof(position))
+        || !game_from_text(&state, position)) {
+        // Searching it again won't make it any better
+        char failed[4096];
+        snprintf(failed, sizeof(failed), "%s/failed/%s", dir, unit);
+        if (rename(claim_path, failed) != 0)
+            perror(failed);
+        fprintf(stderr, "%s: not a unit, moved to %s\n", claim_path, failed);
+        return false;
+    }
+    int unit_depth = read_value(text, "depth", value, sizeof(value)) ? atoi(value) : depth;
+
+    long start = now_ms();
+    search_init(searcher, unit_depth, 0, tt, NULL);
+    double score = search(&state, searcher);
+
+    Move_list moves;
+    generate_moves(&state, &moves);
+    char move[MOVE_TEXT_LENGTH] = "none";
+    if (moves.length > 0)
+        move_to_text(&searcher->best, moves.type, move);
+
+    char result[1024], path[4096];
+    snprintf(result, sizeof(result), "position %s\nscore %.3f\nmove %s\ndepth %d\nnodes %ld\n",
+             position, score, move, atomic_load(&searcher->depth),
+             atomic_load(&searcher->nodes));
+    snprintf(path, sizeof(path), "%s/done/%s", dir, unit);
+    if (!write_file(path, result))
+        return false;
+
+    printf("%s: %s %.1f (%d plies, %.1fs)\n", unit, move, score,
+           atomic_load(&searcher->depth), (now_ms() - start) / 1000.0);
+    fflush(stdout);
+    return true;
+}
+
+static int work(const char *dir)
+{
+    if (!read_job(dir) || !make_directory(dir, "failed"))
+        return EXIT_FAILURE;
+
+    char host[256] = "localhost", worker[300];
+    gethostname(host, sizeof(host));
+    host[sizeof(host) - 1] = '\0';
+    for (char *c = host; *c != '\0'; c++)
+        if (*c == '.' || *c == '/')
+            *c = '-';
+    snprintf(worker, sizeof(worker), "%s.%d", host, (int) getpid());
+
+    Ttable tt;
+    Search *searcher = malloc(sizeof(Search));
+    if (searcher == NULL || !tt_init(&tt, hash_mb)) {
+        fprintf(stderr, "opening: out of memory\n");
+        return EXIT_FAILURE;
+    }
+    pthread_t heartbeat;
+    if (pthread_create(&heartbeat, NULL, heartbeat_thread, NULL) != 0) {
+        fprintf(stderr, "opening: can't start the heartbeat thread\n");
+        return EXIT_FAILURE;
+    }
+
+    int searched = 0;
+    for (;;) {
+        int others = reissue(dir);
+        char unit[256], claim_path[4096];
+        if (!claim(dir, worker, unit, sizeof(unit), claim_path, sizeof(claim_path))) {
+            // Nothing left to take, but units others are searching may
+            // still come back if they die
+            if (others == 0)
+                break;
+            sleep(stale_s / 4 > 0 ? stale_s / 4 : 1);
+            continue;
+        }
+
+        set_heartbeat(claim_path);
+        bool ok = search_unit(dir, unit, claim_path, &tt, searcher);
+        set_heartbeat("");
+        if (!ok) {
+            // It's been moved into failed, or it couldn't be written: then
+            // leave it to someone else (once it's stale), rather than
+            // failing on it over and over
+            continue;
+        }
+        unlink(claim_path);
+        searched++;
+    }
+
+    printf("no units left (%d searched here)\n", searched);
+    tt_free(&tt);
+    free(searcher);
+    return 0;
+}
+// }}}
+
+
+// {{{ status, combine
+static int status(const char *dir)
+{
+    if (!read_job(dir))
+        return EXIT_FAILURE;
+
+    char **names;
+    int pending = list_units(dir, "pending", &names);
+    free_names(names, pending);
+    int done = list_units(dir, "done", &names);
+    free_names(names, done);
+    int failed = list_units(dir, "failed", &names);
+    free_names(names, failed);
+
+    int claimed = list_units(dir, "claimed", &names), stale = 0;
+    time_t now = time(NULL);
+    for (int i = 0; i < claimed; i++) {
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/claimed/%s", dir, names[i]);
+        if (now - last_touched(path) >= stale_s)
+            stale++;
+    }
+    free_names(names, claimed);
+
+    printf("ply %d, depth %d: %d pending, %d being searched (%d stale), %d done",
+           split_ply, depth, pending, claimed, stale, done);
+    if (failed > 0)
+        printf(", %d failed (see %s/failed)", failed, dir);
+    printf("\n");
+    return 0;
+}
+
+typedef struct {
+    uint64_t hash;
+    double score;  // for the player to move there
+} Result;
+
+typedef struct {
+    Result *results;
+    int count;
+} Results;
+
+static int compare_results(const void *a, const void *b)
+{
+    const Result *x = a, *y = b;
+    return x->hash < y->hash ? -1 : x->hash > y->hash;
+}
+
+static bool load_results(const char *dir, Results *results)
+{
+    char **names;
+    int count = list_units(dir, "done", &names);
+    results->results = malloc((count > 0 ? count : 1) * sizeof(Result));
+    results->count = 0;
+    if (results->results == NULL)
+        return false;
+
+    for (int i = 0; i < count; i++) {
+        char path[4096], text[1024], position[POSITION_TEXT_LENGTH], score[32];
+        snprintf(path, sizeof(path), "%s/done/%s", dir, names[i]);
+        Game_state state;
+        if (!read_file(path, text, sizeof(text)))
+            continue;
+        if (!read_value(text, "position", position, sizeof(position))
+            || !read_value(text, "score", score, sizeof(score))
+            || !game_from_text(&state, position)) {
+            fprintf(stderr, "%s: not a result\n", path);
+            continue;
+        }
+        Result *result = &results->results[results->count++];
+        result->hash = state.hash;
+        result->score = atof(score);
+    }
+    free_names(names, count);
+    qsort(results->results, results->count, sizeof(Result), compare_results);
+    return true;
+}
+
+/* back_up is minimax over the tree down to the split, from the point of
+ * view of the player to move; NAN if no unit below has a result yet.  Wins
+ * further away are worth a ply less, as in the search. */
+static double back_up(Game_state *state, int ply, Results *results, long *missing)
+{
+    Move_list moves;
+    generate_moves(state, &moves);
+    if (moves.length == 0)
+        return -WIN_SCORE;
+
+    if (ply == split_ply) {
+        Result key = { state->hash, 0 };
+        Result *found = bsearch(&key, results->results, results->count, sizeof(Result),
+                                compare_results);
+        if (found == NULL) {
+            (*missing)++;
+            return NAN;
+        }
+        return found->score;
+    }
+
+    double best = NAN;
+    for (int i = 0; i < moves.length; i++) {
+        Game_state next;
+        game_copy(&next, state);
+        game_apply_move(&next, &moves.array[i]);
+        double value = 0 - back_up(&next, ply + 1, results, missing);  // (a draw isn't -0)
+        if (isnan(value))
+            continue;
+        if (value > WIN_SCORE / 2)   value -= 1;
+        if (value < -WIN_SCORE / 2)  value += 1;
+        if (isnan(best) || value > best)
+            best = value;
+    }
+    return best;
+}
+
+static int combine(const char *dir)
+{
+    Results results;
+    if (!read_job(dir) || !load_results(dir, &results))
+        return EXIT_FAILURE;
+
+    Game_state state;
+    game_setup(&state);
+    Move_list moves;
+    generate_moves(&state, &moves);
+
+    long missing = 0;
+    double best = NAN;
+    int best_index = -1;
+    for (int i = 0; i < moves.length; i++) {
+        Game_state next;
+        game_copy(&next, &state);
+        game_apply_move(&next, &moves.array[i]);
+        long missing_here = 0;
+        double value = 0 - back_up(&next, 1, &results, &missing_here);
+        missing += missing_here;
+
+        char move[MOVE_TEXT_LENGTH];
+        move_to_text(&moves.array[i], moves.type, move);
+        if (isnan(value))
+            printf("%-10s no results yet\n", move);
+        else
+            printf("%-10s %8.1f%s\n", move, value, missing_here > 0 ? " (partial)" : "");
+        if (!isnan(value) && (isnan(best) || value > best)) {
+            best = value;
+            best_index = i;
+        }
+    }
+
+    if (best_index >= 0) {
+        char move[MOVE_TEXT_LENGTH];
+        printf("best %s, %.1f for %s, searched %d + %d plies deep\n",
+               move_to_text(&moves.array[best_index], moves.type, move), best,
+               state.current_player == WHITE ? "white" : "black", split_ply, depth);
+    }
+    free(results.results);
+    if (missing > 0) {
+        printf("%ld positions at the split have no result yet\n", missing);
+        return EXIT_FAILURE;
+    }
+    return 0;
+}
+// }}}
+
+
+static void usage()
+{
+    fprintf(stderr, "usage: opening split DIR [--ply N] [--depth N]\n"
+                    "       opening work DIR [--hash MB] [--stale S]\n"
+                    "       opening status DIR [--stale S]\n"
+                    "       opening combine DIR\n");
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+        usage();
+    const char *command = argv[1], *dir = argv[2];
+    for (int i = 3; i < argc; i++) {
+        if      (strcmp("--ply", argv[i]) == 0 && i+1 < argc)    split_ply = atoi(argv[++i]);
+        else if (strcmp("--depth", argv[i]) == 0 && i+1 < argc)  depth = atoi(argv[++i]);
+        else if (strcmp("--hash", argv[i]) == 0 && i+1 < argc)   hash_mb = atol(argv[++i]);
+        else if (strcmp("--stale", argv[i]) == 0 && i+1 < argc)  stale_s = atol(argv[++i]);
+        else usage();
+    }
+    if (split_ply < 1 || depth < 1 || hash_mb == 0 || stale_s < 1)
+        usage();
+
+    if (strcmp(command, "split") == 0)    return split(dir);
+    if (strcmp(command, "work") == 0)     return work(dir);
+    if (strcmp(command, "status") == 0)   return status(dir);
+    if (strcmp(command, "combine") == 0)  return combine(dir);
+    usage();
+}
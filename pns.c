@@ -0,0 +1,340 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "checkers.h"
+
+/* Depth-first proof-number search (df-pn).  One player, the attacker, is
+ * trying to win; the other one is trying to stop that.  Every position
+ * gets a proof number, how many positions at least would still have to be
+ * shown won for the attacker to prove it won, and a disproof number, the
+ * same to show it's not.  Where the attacker moves, it's enough for one
+ * movement to win: the proof number is its children's smallest and the
+ * disproof number their sum; where the defender moves it's the other way
+ * round.  Writing them from the point of view of the player to move, as phi
+ * (the number that player wants to bring to 0) and delta, makes both the
+ * same:
+ *   phi(n) = min delta(child)      delta(n) = sum phi(child)
+ * and a player who can't move (lost) is phi = infinity, delta = 0.
+ *
+ * The search always goes down into the most promising child, the one with
+ * the smallest delta, and stays there until its numbers get past thresholds
+ * that say another child has become more promising (or that this node's
+ * numbers have grown past its own thresholds): then it goes back up, having
+ * left what it found in the table.  So there's no tree in memory, only the
+ * table, which is of fixed size: when it's full, the entries with the least
+ * work (nodes searched under them) make room.  Transpositions share their
+ * entry, so a position reached in several ways is only solved once.
+ *
+ * The threshold for the child is (1+epsilon) times the second best child's
+ * delta instead of just one more, so that the search doesn't keep going back
+ * and forth between two children that are almost as good (the "1+epsilon
+ * trick").
+ *
+ * Draws only matter to the attacker, who hasn't won: a position repeated
+ * along the path (or past PN_MAXDEPTH), or one reached after
+ * DEFAULT_NO_PROGRESS_LIMIT turns without a capture or a stone movement,
+ * counts as lost for the attacker.  Such an outcome depends on the path
+ * rather than the position, but it can only make a win go unnoticed, never
+ * make one up, so the search reports wins (proofs) and not disproofs.  For
+ * that, a position's entry in the table is for its turns without progress
+ * too: a win found with 10 of them left is no win with 2 left.  To tell
+ * whether the player to move wins or loses, proof_solve tries each of them
+ * as the attacker. */
+
+#define EPSILON_DIVISOR 4  // 1+epsilon = 1.25
+#define BUCKET 4           // entries a position can go in (next to each other)
+
+struct Pn_frame {
+    Move_list moves;
+    uint64_t hashes[MAXMOVES];  // of the positions the movements lead to
+    uint64_t keys[MAXMOVES];    // ... their entries' keys (see key)
+    bool no_progress[MAXMOVES]; // ... and whether they're drawn for it
+};
+
+/* proof_init allocates a table of (at most) the given size; the search
+ * stops after movetime_ms milliseconds (0 for no limit). */
+bool proof_init(Proof_search *ps, size_t megabytes, long movetime_ms)
+{
+    size_t entries = BUCKET;
+    while (entries * 2 * sizeof(Pn_entry) <= megabytes << 20)
+        entries *= 2;
+
+    ps->table = calloc(entries, sizeof(Pn_entry));
+    ps->mask = entries - 1;
+    ps->frames = malloc(PN_MAXDEPTH * sizeof(struct Pn_frame));
+    ps->max_nodes = 0;
+    ps->deadline_ms = movetime_ms > 0 ? now_ms() + movetime_ms : 0;
+    atomic_init(&ps->stop, false);
+    atomic_init(&ps->nodes, 0);
+    ps->on_progress = NULL;
+    ps->on_progress_data = NULL;
+    ps->result = PROOF_UNKNOWN;
+    ps->line.length = 0;
+    ps->line.score = 0;
+    if (ps->table == NULL || ps->frames == NULL) {
+        proof_free(ps);
+        return false;
+    }
+    return true;
+}
+
+void proof_free(Proof_search *ps)
+{
+    free(ps->table);
+    free(ps->frames);
+    ps->table = NULL;
+    ps->frames = NULL;
+}
+
+
+// {{{ Table
+/* key is the position's key in the table: its hash, scrambled with how many
+ * turns it's been without progress (with the splitmix64 finalizer, as in
+ * zobrist_key) */
+static uint64_t key(Game_state *state)
+{
+    uint64_t x = (uint64_t) (state->reversible_moves + 1) * 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return state->hash ^ x ^ (x >> 31);
+}
+
+static Pn_entry *find(Proof_search *ps, uint64_t hash)
+{
+    Pn_entry *bucket = &ps->table[hash & ps->mask & ~(size_t) (BUCKET - 1)];
+    for (int i = 0; i < BUCKET; i++)
+        if (bucket[i].key == hash)
+            return &bucket[i];
+    return NULL;
+}
+
+/* lookup gives the position's numbers, or 1 and 1 for a position nothing
+ * is known about yet */
+static void lookup(Proof_search *ps, uint64_t hash, uint32_t *phi, uint32_t *delta)
+{
+    Pn_entry *entry = find(ps, hash);
+    *phi = entry != NULL ? entry->phi : 1;
+    *delta = entry != NULL ? entry->delta : 1;
+}
+
+/* store keeps the position's numbers and adds 'work' to its work, taking
+ * the place of the entry with the least work in its bucket if it's not
+ * there yet */
+static void store(Proof_search *ps, uint64_t hash, uint32_t phi, uint32_t delta, uint64_t work)
+{
+    Pn_entry *entry = find(ps, hash);
+    if (entry == NULL) {
+        Pn_entry *bucket = &ps->table[hash & ps->mask & ~(size_t) (BUCKET - 1)];
+        entry = &bucket[0];
+        for (int i = 1; i < BUCKET; i++)
+            if (bucket[i].work < entry->work)
+                entry = &bucket[i];
+        entry->key = hash;
+        entry->work = 0;
+    }
+    entry->phi = phi;
+    entry->delta = delta;
+    entry->work += work;
+}
+// }}}
+
+
+/* draw gives the numbers of a position that counts as a draw: lost for the
+ * attacker, whoever's to move */
+static void draw(Proof_search *ps, Color mover, uint32_t *phi, uint32_t *delta)
+{
+    *phi   = mover == ps->attacker ? PN_INFINITY : 0;
+    *delta = mover == ps->attacker ? 0 : PN_INFINITY;
+}
+
+/* out_of_limits tells whether the search has to stop (checking the clock
+ * only now and then), and reports progress */
+static bool out_of_limits(Proof_search *ps)
+{
+    if (atomic_load_explicit(&ps->stop, memory_order_relaxed))
+        return true;
+    long nodes = atomic_load_explicit(&ps->nodes, memory_order_relaxed);
+    if (ps->max_nodes > 0 && nodes >= ps->max_nodes) {
+        atomic_store(&ps->stop, true);
+        return true;
+    }
+    if (nodes % 1024 == 0) {
+        long now = now_ms();
+        if (ps->deadline_ms > 0 && now >= ps->deadline_ms) {
+            atomic_store(&ps->stop, true);
+            return true;
+        }
+        if (ps->on_progress != NULL && now - ps->progress_ms >= 1000) {
+            ps->progress_ms = now;
+            ps->on_progress(ps, ps->on_progress_data);
+        }
+    }
+    return false;
+}
+
+static uint32_t add_numbers(uint32_t sum, uint32_t number)
+{
+    if (sum == PN_INFINITY || number == PN_INFINITY)
+        return PN_INFINITY;
+    // Only a child that's decided makes a sum infinite
+    uint64_t total = (uint64_t) sum + number;
+    return total < PN_INFINITY - 1 ? total : PN_INFINITY - 1;
+}
+
+/* mid ("multiple iterative deepening") searches the position at 'ply'
+ * until its numbers reach the thresholds; returns the nodes it searched. */
+static uint64_t mid(Proof_search *ps, Game_state *state, int ply,
+                    uint32_t phi_threshold, uint32_t delta_threshold)
+{
+    atomic_fetch_add_explicit(&ps->nodes, 1, memory_order_relaxed);
+    struct Pn_frame *frame = &ps->frames[ply];
+    generate_moves(state, &frame->moves);
+    if (state->situation != ONGOING || frame->moves.length == 0) {
+        store(ps, key(state), PN_INFINITY, 0, 1);
+        return 1;
+    }
+
+    Move_list *moves = &frame->moves;
+    for (int i = 0; i < moves->length; i++) {
+        Game_state child = *state;
+        game_apply_move(&child, &moves->array[i]);
+        frame->hashes[i] = child.hash;
+        frame->keys[i] = key(&child);
+        frame->no_progress[i] = child.reversible_moves >= DEFAULT_NO_PROGRESS_LIMIT;
+    }
+    ps->path[ply] = state->hash;
+
+    uint64_t work = 1;
+    uint32_t phi, delta;
+    for (;;) {
+        // This node's numbers from its children's, and the best two children
+        int best = 0;
+        uint32_t best_phi = 0, best_delta = PN_INFINITY, second_delta = PN_INFINITY;
+        phi = PN_INFINITY;
+        delta = 0;
+        for (int i = 0; i < moves->length; i++) {
+            uint32_t child_phi, child_delta;
+            bool drawn = ply + 1 >= PN_MAXDEPTH || frame->no_progress[i];
+            for (int p = ply; p >= 0 && !drawn; p--)
+                drawn = ps->path[p] == frame->hashes[i];
+            if (drawn)
+                draw(ps, state->current_player == WHITE ? BLACK : WHITE, &child_phi, &child_delta);
+            else
+                lookup(ps, frame->keys[i], &child_phi, &child_delta);
+
+            delta = add_numbers(delta, child_phi);
+            if (child_delta < best_delta) {
+                second_delta = best_delta;
+                best_delta = child_delta;
+                best_phi = child_phi;
+                best = i;
+            } else if (child_delta < second_delta) {
+                second_delta = child_delta;
+            }
+        }
+        phi = best_delta;
+
+        if (phi >= phi_threshold || delta >= delta_threshold || out_of_limits(ps))
+            break;
+
+        // The child's thresholds: past them, this node has reached its own,
+        // or another child is (enough) more promising
+        uint64_t child_phi_threshold = delta_threshold == PN_INFINITY ? PN_INFINITY
+                                     : (uint64_t) delta_threshold - delta + best_phi;
+        uint64_t child_delta_threshold = second_delta == PN_INFINITY ? PN_INFINITY
+                                       : (uint64_t) second_delta + second_delta / EPSILON_DIVISOR + 1;
+        if (child_delta_threshold > phi_threshold)
+            child_delta_threshold = phi_threshold;
+        if (child_phi_threshold > PN_INFINITY)
+            child_phi_threshold = PN_INFINITY;
+
+        Game_state child = *state;
+        game_apply_move(&child, &moves->array[best]);
+        work += mid(ps, &child, ply + 1, child_phi_threshold, child_delta_threshold);
+    }
+
+    store(ps, key(state), phi, delta, work);
+    return work;
+}
+
+/* find_line follows the proof from the root: the attacker's movement
+ * that's proved quickest, and the defender's that took the most work to
+ * refute */
+static void find_line(Proof_search *ps, Game_state *root)
+{
+    Game_state state = *root;
+    uint64_t seen[MAXPV];
+    ps->line.length = 0;
+    while (ps->line.length < MAXPV) {
+        Move_list moves;
+        generate_moves(&state, &moves);
+        if (moves.length == 0 || state.situation != ONGOING)
+            break;
+        seen[ps->line.length] = state.hash;
+
+        bool attacking = state.current_player == ps->attacker;
+        int chosen = -1;
+        uint64_t chosen_work = 0;
+        for (int i = 0; i < moves.length; i++) {
+            Game_state child = state;
+            game_apply_move(&child, &moves.array[i]);
+            Pn_entry *entry = find(ps, key(&child));
+            // Proved for the attacker: delta 0 where the defender moves next,
+            // phi 0 where the attacker does
+            bool proved = entry != NULL && (attacking ? entry->delta == 0 : entry->phi == 0);
+            if (proved && (chosen < 0 || (attacking ? entry->work < chosen_work
+                                                    : entry->work > chosen_work))) {
+                chosen = i;
+                chosen_work = entry->work;
+            }
+        }
+        if (chosen < 0)
+            break;
+
+        ps->line.moves[ps->line.length++] = chosen;
+        game_apply_move(&state, &moves.array[chosen]);
+        bool repeated = false;
+        for (int p = 0; p < ps->line.length && !repeated; p++)
+            repeated = seen[p] == state.hash;
+        if (repeated)
+            break;
+    }
+}
+
+/* prove runs the search with the given attacker until the root is decided
+ * or a limit is reached; returns whether the attacker wins */
+static bool prove(Proof_search *ps, Game_state *root, Color attacker)
+{
+    memset(ps->table, 0, (ps->mask + 1) * sizeof(Pn_entry));
+    ps->attacker = attacker;
+    ps->progress_ms = now_ms();
+    mid(ps, root, 0, PN_INFINITY, PN_INFINITY);
+
+    uint32_t phi, delta;
+    lookup(ps, key(root), &phi, &delta);
+    bool root_attacks = root->current_player == attacker;
+    return root_attacks ? phi == 0 : delta == 0;
+}
+
+/* proof_solve tries to prove the position won for the player to move, and
+ * then (if that failed without running out of time) lost.  The result is
+ * in ps->result too, with the line of play in ps->line. */
+Proof proof_solve(Game_state *state, Proof_search *ps)
+{
+    Color player = state->current_player;
+    Color opponent = player == WHITE ? BLACK : WHITE;
+    ps->result = PROOF_UNKNOWN;
+    ps->line.length = 0;
+    ps->line.score = 0;
+
+    if (prove(ps, state, player))
+        ps->result = PROOF_WIN;
+    else if (!atomic_load(&ps->stop) && prove(ps, state, opponent))
+        ps->result = PROOF_LOSS;
+
+    if (ps->result != PROOF_UNKNOWN) {
+        find_line(ps, state);
+        ps->line.score = ps->result == PROOF_WIN ? WIN_SCORE : -WIN_SCORE;
+    }
+    return ps->result;
+}
@@ -0,0 +1,736 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "checkers.h"
+
+/* checkers-server hosts many games at once, each on its own connection, with
+ * the engine playing one side (or none) in each of them.
+ *
+ * Usage: checkers-server [options]
+ *   --port N         listen on TCP port N (default 7000)
+ *   --host ADDR      ... on this address (default 127.0.0.1)
+ *   --unix PATH      listen on a unix socket instead
+ *   --workers N      threads searching engine movements (default 4)
+ *   --depth N, --movetime MS, --hash MB, --draw-limit N
+ *                    like for the game (the table is shared by all workers)
+ *
+ * One thread does all the networking: a nonblocking epoll loop over the
+ * listening socket, the connections and an eventfd the workers signal when
+ * they finish a search.  Engine movements are searched by a pool of worker
+ * threads, so a game where the engine is thinking doesn't hold up the others.
+ *
+ * The protocol is line based.  Each command gets one reply line, except that
+ * the engine's movements come whenever they're ready, as "move ..." lines:
+ *   new [white|black|none]   new game, the engine playing the given color
+ *                            (black if not given)          -> ok
+ *   position TEXT            set the position up (see game_to_text), same
+ *                            engine color as before        -> ok
+ *   move TEXT                play a movement ("c3-d4", "c3xe5xc7")  -> ok
+ *   go                       the engine plays for the side to move
+ *   moves                    -> moves TEXT TEXT ...
+ *   board                    -> position TEXT
+ *   quit
+ * Bad commands get "error ..." instead.  When a game ends, "result white",
+ * "result black" or "result draw" follows the movement (or position) that
+ * ended it; a player left without movements has lost.
+ * While the engine thinks, further commands wait for it to play.
+ * Clients that don't read their replies are disconnected, rather than
+ * having their output buffered without bound. */
+
+static int workers = 4;
+static int engine_depth = 0;          // no limit
+static long engine_movetime = 1000;   // milliseconds
+static size_t engine_hash = 64;       // megabytes, shared by all workers
+static int draw_limit = DEFAULT_NO_PROGRESS_LIMIT;
+
+
+// {{{ Sessions
+
+#define NO_ENGINE 2             // engine_color when the engine plays neither
+#define SESSION_LINE 128        // longest command line
+
+/* A Session is one connection and its game.  There may be thousands of them,
+ * most of them idle, so it's kept small: 136 bytes on 8x8 (a Game_state and
+ * a few fields), 176 on 10x10.  What else a game needs is allocated when it
+ * needs it:
+ *  - the hashes of the positions since the last capture or stone movement
+ *    (the only ones that can come back, see history_repetitions), which
+ *    only start piling up once dames move around, and never get to more
+ *    than the no-progress limit: ring_size() of them, 8 bytes each;
+ *  - the part of a command line that hasn't arrived completely yet, only
+ *    kept between reads that split a line, or while the engine thinks.
+ * A full History is only put together when it's needed. */
+typedef struct {
+    int fd;               // -1 while the slot is free
+    uint32_t generation;  // counts the connections the slot has been used for
+    int next_free;
+
+    Game_state state;
+    uint8_t engine_color;
+    bool thinking;        // a worker is searching this game's movement
+    uint16_t nhashes;     // positions pushed since the last progress
+    uint16_t in_length;
+    uint64_t *hashes;     // ring_size() of them, or NULL before the first one
+    char *in;             // SESSION_LINE chars, or NULL while in_length is 0
+} Session;
+
+/* ring_size is how many of the session's positions can matter for the draw
+ * rules: no more than the no-progress limit (and the History they go into
+ * takes MAXHISTORY). */
+static int ring_size()
+{
+    if (draw_limit < 1)           return 1;
+    if (draw_limit > MAXHISTORY)  return MAXHISTORY;
+    return draw_limit;
+}
+
+/* Sessions live in a pool: chunks of SESSION_CHUNK sessions, allocated as
+ * needed and never moved (so pointers to them stay good), with the free
+ * slots linked together.  A session is known by its index in the pool plus
+ * its generation; results that come back for an older generation of the slot
+ * were meant for a connection that's gone. */
+#define SESSION_CHUNK 256
+#define MAXCHUNKS 4096
+
+typedef struct {
+    Session *chunks[MAXCHUNKS];
+    int nchunks;
+    int first_free;  // -1 if there are no free slots
+    int active;
+} Session_pool;
+
+static Session *pool_get(Session_pool *pool, int index)
+{
+    return &pool->chunks[index / SESSION_CHUNK][index % SESSION_CHUNK];
+}
+
+static int pool_alloc(Session_pool *pool)
+{
+    if (pool->first_free < 0) {
+        if (pool->nchunks == MAXCHUNKS)
+            return -1;
+        Session *chunk = calloc(SESSION_CHUNK, sizeof(Session));
+        if (chunk == NULL)
+            return -1;
+
+        int base = pool->nchunks * SESSION_CHUNK;
+        pool->chunks[pool->nchunks++] = chunk;
+        for (int i = SESSION_CHUNK - 1; i >= 0; i--) {
+            chunk[i].fd = -1;
+            chunk[i].next_free = pool->first_free;
+            pool->first_free = base + i;
+        }
+    }
+
+    int index = pool->first_free;
+    Session *session = pool_get(pool, index);
+    pool->first_free = session->next_free;
+    session->generation++;
+    pool->active++;
+    return index;
+}
+
+static void pool_release(Session_pool *pool, int index)
+{
+    Session *session = pool_get(pool, index);
+    session->fd = -1;
+    session->generation++;
+    session->next_free = pool->first_free;
+    pool->first_free = index;
+    pool->active--;
+}
+
+/* The epoll data of a connection says which session it is */
+static uint64_t session_tag(Session_pool *pool, int index)
+{
+    return (uint64_t) pool_get(pool, index)->generation << 32 | (uint32_t) index;
+}
+
+/* session_history puts the session's positions into a History for the draw
+ * rules and the search. */
+static void session_history(Session *session, History *history)
+{
+    history_init(history, draw_limit);
+    int count = session->nhashes, size = ring_size();
+    int first = count > size ? count - size : 0;
+    for (int i = first; i < count; i++)
+        history->hashes[history->length++] = session->hashes[i % size];
+}
+
+/* session_blocked ends the session's game if the side to move has no
+ * movement left, which loses it (like in the game itself). */
+static void session_blocked(Session *session)
+{
+    Move_list moves;
+    generate_moves(&session->state, &moves);
+    update_blocked_situation(&session->state, &moves);
+}
+
+/* session_play plays 'move' in the session's game, keeping its positions up
+ * to date.  Returns false, without playing it, if there's no memory for
+ * them. */
+static bool session_play(Session *session, Move *move)
+{
+    Game_state next;
+    game_copy(&next, &session->state);
+    game_apply_move(&next, move);
+    if (next.reversible_moves == 0) {
+        session->nhashes = 0;
+    } else {
+        if (session->hashes == NULL
+         && (session->hashes = malloc(ring_size() * sizeof(uint64_t))) == NULL)
+            return false;
+        session->hashes[session->nhashes++ % ring_size()] = session->state.hash;
+    }
+    game_copy(&session->state, &next);
+
+    History history;
+    session_history(session, &history);
+    update_draw_situation(&session->state, &history);
+    session_blocked(session);
+    return true;
+}
+
+static void session_new_game(Session *session)
+{
+    game_setup(&session->state);
+    session->nhashes = 0;
+    free(session->hashes);
+    session->hashes = NULL;
+}
+// }}}
+
+
+// {{{ Workers
+
+/* A Job is an engine movement to be searched: a copy of the game (so the
+ * session can go away meanwhile) and, when done, the movement found. */
+typedef struct Job {
+    struct Job *next;
+    int session;
+    uint32_t generation;
+    Game_state state;
+    History history;
+    Move move;
+} Job;
+
+/* The jobs waiting for a worker, and the ones the workers are done with,
+ * waiting for the network thread to send them.  Both are FIFO lists behind
+ * one lock; the network thread sleeps in epoll_wait, so it's woken through
+ * 'done_fd' instead of a condition variable. */
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t  available;
+    Job *todo, *todo_last;
+    Job *done, *done_last;
+    int done_fd;
+    bool quit;
+
+    Ttable tt;  // shared by all the workers
+} Job_queue;
+
+typedef struct {
+    Job_queue *queue;
+    Search search;  // here so that quitting can stop it
+    pthread_t thread;
+} Worker;
+
+static void append(Job **first, Job **last, Job *job)
+{
+    job->next = NULL;
+    if (*first == NULL)  *first = job;
+    else                 (*last)->next = job;
+    *last = job;
+}
+
+static void *worker_thread(void *arg)
+{
+    Worker *worker = arg;
+    Job_queue *queue = worker->queue;
+
+    pthread_mutex_lock(&queue->lock);
+    for (;;) {
+        while (queue->todo == NULL && !queue->quit)
+            pthread_cond_wait(&queue->available, &queue->lock);
+        if (queue->quit)
+            break;
+        Job *job = queue->todo;
+        queue->todo = job->next;
+        // (initialized under the lock, so that quitting can't be missed)
+        search_init(&worker->search, engine_depth, engine_movetime, &queue->tt, &job->history);
+        pthread_mutex_unlock(&queue->lock);
+
+        search(&job->state, &worker->search);
+        job->move = worker->search.best;
+
+        pthread_mutex_lock(&queue->lock);
+        append(&queue->done, &queue->done_last, job);
+        uint64_t one = 1;
+        if (write(queue->done_fd, &one, sizeof(one)) < 0)
+            perror("eventfd");
+    }
+
+    pthread_mutex_unlock(&queue->lock);
+    return NULL;
+}
+// }}}
+
+
+// {{{ Network
+
+typedef struct {
+    int epoll_fd;
+    Session_pool pool;
+    Job_queue queue;
+} Server;
+
+static volatile sig_atomic_t quitting = 0;
+
+static void on_signal(int signal)
+{
+    (void) signal;
+    quitting = 1;
+}
+
+static void session_close(Server *server, int index)
+{
+    Session *session = pool_get(&server->pool, index);
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_DEL, session->fd, NULL);
+    close(session->fd);
+    free(session->hashes);
+    free(session->in);
+    session->hashes = NULL;
+    session->in = NULL;
+    pool_release(&server->pool, index);
+}
+
+/* reply sends a line to the session's client.  Replies are short and the
+ * client is supposed to read them, so if the socket can't take a whole line
+ * right away the client is disconnected.  Returns false then. */
+static bool reply(Server *server, int index, const char *format, ...)
+{
+    char line[SESSION_LINE + MAXMOVES * MOVE_TEXT_LENGTH];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(line, sizeof(line) - 1, format, args);
+    va_end(args);
+    if (length > (int) sizeof(line) - 2)
+        length = sizeof(line) - 2;
+    line[length++] = '\n';
+
+    Session *session = pool_get(&server->pool, index);
+    if (send(session->fd, line, length, MSG_NOSIGNAL) != length) {
+        session_close(server, index);
+        return false;
+    }
+    return true;
+}
+
+/* watch_input turns reading the session's socket on or off: while the engine
+ * thinks, commands are left in the socket until it has played. */
+static void watch_input(Server *server, int index, bool on)
+{
+    struct epoll_event event = {
+        .events = on ? EPOLLIN | EPOLLRDHUP : 0,
+        .data.u64 = session_tag(&server->pool, index),
+    };
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_MOD, pool_get(&server->pool, index)->fd, &event);
+}
+
+static bool report_result(Server *server, int index)
+{
+    switch (pool_get(&server->pool, index)->state.situation) {
+    case WHITE_WINS: return reply(server, index, "result white");
+    case BLACK_WINS: return reply(server, index, "result black");
+    case TIE:        return reply(server, index, "result draw");
+    default:         return true;
+    }
+}
+
+/* start_engine hands the session's position to the workers. */
+static bool start_engine(Server *server, int index)
+{
+    Session *session = pool_get(&server->pool, index);
+    Job *job = malloc(sizeof(Job));
+    if (job == NULL)
+        return reply(server, index, "error out of memory");
+
+    job->session = index;
+    job->generation = session->generation;
+    game_copy(&job->state, &session->state);
+    session_history(session, &job->history);
+
+    session->thinking = true;
+    watch_input(server, index, false);
+
+    Job_queue *queue = &server->queue;
+    pthread_mutex_lock(&queue->lock);
+    append(&queue->todo, &queue->todo_last, job);
+    pthread_cond_signal(&queue->available);
+    pthread_mutex_unlock(&queue->lock);
+    return true;
+}
+
+/* engine_turn starts the engine if it's its turn in the session's game. */
+static bool engine_turn(Server *server, int index)
+{
+    Session *session = pool_get(&server->pool, index);
+    if (!session->thinking && session->state.situation == ONGOING
+     && session->state.current_player == session->engine_color)
+        return start_engine(server, index);
+    return true;
+}
+
+/* command runs one command line; returns false if the session was closed. */
+static bool command(Server *server, int index, char *line)
+{
+    Session *session = pool_get(&server->pool, index);
+    char *argument = strchr(line, ' ');
+    if (argument != NULL)
+        *argument++ = '\0';
+    else
+        argument = "";
+
+    if (strcmp(line, "new") == 0) {
+        if      (strcmp(argument, "white") == 0)  session->engine_color = WHITE;
+        else if (strcmp(argument, "none") == 0)   session->engine_color = NO_ENGINE;
+        else if (strcmp(argument, "black") == 0 || *argument == '\0')
+            session->engine_color = BLACK;
+        else
+            return reply(server, index, "error new takes white, black or none");
+        session_new_game(session);
+        return reply(server, index, "ok") && engine_turn(server, index);
+    }
+    else if (strcmp(line, "position") == 0) {
+        Game_state state;
+        if (!game_from_text(&state, argument))
+            return reply(server, index, "error bad position");
+        session_new_game(session);
+        game_copy(&session->state, &state);
+        session_blocked(session);
+        return reply(server, index, "ok") && report_result(server, index)
+            && engine_turn(server, index);
+    }
+    else if (strcmp(line, "move") == 0) {
+        Move move;
+        if (session->state.situation != ONGOING)
+            return reply(server, index, "error the game is over");
+        if (session->state.current_player == session->engine_color)
+            return reply(server, index, "error it's the engine's turn");
+        if (!move_from_text(&session->state, argument, &move))
+            return reply(server, index, "error illegal move");
+        if (!session_play(session, &move))
+            return reply(server, index, "error out of memory");
+        return reply(server, index, "ok") && report_result(server, index)
+            && engine_turn(server, index);
+    }
+    else if (strcmp(line, "go") == 0) {
+        if (session->state.situation != ONGOING)
+            return reply(server, index, "error the game is over");
+        return start_engine(server, index);
+    }
+    else if (strcmp(line, "moves") == 0) {
+        Move_list moves;
+        char text[MAXMOVES * MOVE_TEXT_LENGTH] = "moves";
+        char *end = text + strlen(text);
+        generate_moves(&session->state, &moves);
+        for (int i = 0; i < moves.length; i++) {
+            *end++ = ' ';
+            move_to_text(&moves.array[i], moves.type, end);
+            end += strlen(end);
+        }
+        return reply(server, index, "%s", text);
+    }
+    else if (strcmp(line, "board") == 0) {
+        char text[POSITION_TEXT_LENGTH];
+        return reply(server, index, "position %s", game_to_text(&session->state, text));
+    }
+    else if (strcmp(line, "quit") == 0) {
+        session_close(server, index);
+        return false;
+    }
+    else if (*line == '\0') {
+        return true;
+    }
+    return reply(server, index, "error unknown command %s", line);
+}
+
+/* run_commands runs the complete lines the session has received, until it
+ * runs out of them or the engine starts thinking. */
+static bool run_commands(Server *server, int index)
+{
+    Session *session = pool_get(&server->pool, index);
+    char *newline;
+    while (!session->thinking && session->in_length > 0
+        && (newline = memchr(session->in, '\n', session->in_length)) != NULL) {
+        char line[SESSION_LINE];
+        int length = newline - session->in;
+        memcpy(line, session->in, length);
+        line[length] = '\0';
+        if (length > 0 && line[length-1] == '\r')
+            line[length-1] = '\0';
+
+        session->in_length -= length + 1;
+        memmove(session->in, newline + 1, session->in_length);
+
+        if (!command(server, index, line))
+            return false;
+    }
+
+    // Nothing left over: the buffer isn't needed until more comes
+    if (session->in_length == 0) {
+        free(session->in);
+        session->in = NULL;
+    }
+    return true;
+}
+
+static void on_readable(Server *server, int index)
+{
+    Session *session = pool_get(&server->pool, index);
+    if (session->in == NULL && (session->in = malloc(SESSION_LINE)) == NULL) {
+        session_close(server, index);
+        return;
+    }
+    ssize_t got = read(session->fd, session->in + session->in_length,
+                       SESSION_LINE - session->in_length);
+    if (got == 0 || (got < 0 && errno != EAGAIN && errno != EINTR)) {
+        session_close(server, index);
+        return;
+    }
+    if (got < 0)
+        return;
+    session->in_length += got;
+
+    if (!run_commands(server, index))
+        return;
+    if (session->in_length == SESSION_LINE
+     && memchr(session->in, '\n', SESSION_LINE) == NULL) {
+        reply(server, index, "error line too long");
+        session_close(server, index);
+    }
+}
+
+static void on_connection(Server *server, int listen_fd)
+{
+    for (;;) {
+        int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+            return;  // no more waiting (or out of descriptors: try again later)
+
+        int index = pool_alloc(&server->pool);
+        if (index < 0) {
+            close(fd);
+            continue;
+        }
+        Session *session = pool_get(&server->pool, index);
+        session->fd = fd;
+        session->engine_color = BLACK;
+        session->thinking = false;
+        session->in_length = 0;
+        session_new_game(session);
+
+        struct epoll_event event = {
+            .events = EPOLLIN | EPOLLRDHUP,
+            .data.u64 = session_tag(&server->pool, index),
+        };
+        if (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+            close(fd);
+            pool_release(&server->pool, index);
+        }
+    }
+}
+
+/* on_jobs_done plays the movements the workers found in their games. */
+static void on_jobs_done(Server *server)
+{
+    uint64_t count;
+    if (read(server->queue.done_fd, &count, sizeof(count)) < 0)
+        return;
+
+    Job_queue *queue = &server->queue;
+    pthread_mutex_lock(&queue->lock);
+    Job *job = queue->done;
+    queue->done = NULL;
+    pthread_mutex_unlock(&queue->lock);
+
+    while (job != NULL) {
+        Job *next = job->next;
+        Session *session = pool_get(&server->pool, job->session);
+        if (session->fd >= 0 && session->generation == job->generation) {
+            int index = job->session;
+            Move_list moves;
+            char text[MOVE_TEXT_LENGTH];
+            generate_moves(&session->state, &moves);
+            if (job->move.length == 0 && moves.length > 0)  // stopped before finding anything
+                job->move = moves.array[0];
+
+            // (Games where the engine can't move are over before it's asked,
+            // so there's always a movement here, but just in case)
+            bool sent;
+            session->thinking = false;
+            if (job->move.length == 0) {
+                update_blocked_situation(&session->state, &moves);
+                sent = report_result(server, index);
+            } else if (session_play(session, &job->move)) {
+                move_to_text(&job->move, moves.type, text);
+                sent = reply(server, index, "move %s", text) && report_result(server, index);
+            } else {
+                sent = reply(server, index, "error out of memory");
+            }
+            if (sent) {
+                watch_input(server, index, true);
+                if (run_commands(server, index))
+                    engine_turn(server, index);
+            }
+        }
+        free(job);
+        job = next;
+    }
+}
+
+static int listen_on(const char *host, int port, const char *unix_path)
+{
+    int fd;
+    if (unix_path != NULL) {
+        struct sockaddr_un address = { .sun_family = AF_UNIX };
+        strncpy(address.sun_path, unix_path, sizeof(address.sun_path) - 1);
+        unlink(unix_path);
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0 || bind(fd, (struct sockaddr *) &address, sizeof(address)) < 0)
+            return -1;
+    } else {
+        struct sockaddr_in address = { .sin_family = AF_INET, .sin_port = htons(port) };
+        if (inet_pton(AF_INET, host, &address.sin_addr) != 1)
+            return -1;
+        fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        int yes = 1;
+        if (fd < 0 || setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes)) < 0
+         || bind(fd, (struct sockaddr *) &address, sizeof(address)) < 0)
+            return -1;
+    }
+    return listen(fd, SOMAXCONN) == 0 ? fd : -1;
+}
+// }}}
+
+
+static void usage()
+{
+    fprintf(stderr, "usage: checkers-server [--port N] [--host ADDR] [--unix PATH]"
+                    " [--workers N] [--depth N] [--movetime MS] [--hash MB]"
+                    " [--draw-limit N]\n");
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv)
+{
+    int port = 7000;
+    const char *host = "127.0.0.1", *unix_path = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if      (strcmp("--port", argv[i]) == 0 && i+1 < argc)        port = atoi(argv[++i]);
+        else if (strcmp("--host", argv[i]) == 0 && i+1 < argc)        host = argv[++i];
+        else if (strcmp("--unix", argv[i]) == 0 && i+1 < argc)        unix_path = argv[++i];
+        else if (strcmp("--workers", argv[i]) == 0 && i+1 < argc)     workers = atoi(argv[++i]);
+        else if (strcmp("--depth", argv[i]) == 0 && i+1 < argc)       engine_depth = atoi(argv[++i]);
+        else if (strcmp("--movetime", argv[i]) == 0 && i+1 < argc)    engine_movetime = atol(argv[++i]);
+        else if (strcmp("--hash", argv[i]) == 0 && i+1 < argc)        engine_hash = atol(argv[++i]);
+        else if (strcmp("--draw-limit", argv[i]) == 0 && i+1 < argc)  draw_limit = atoi(argv[++i]);
+        else usage();
+    }
+    if (workers < 1)
+        usage();
+
+    int listen_fd = listen_on(host, port, unix_path);
+    if (listen_fd < 0) {
+        perror("listen");
+        return EXIT_FAILURE;
+    }
+
+    static Server server;
+    server.pool.first_free = -1;
+    server.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+
+    Job_queue *queue = &server.queue;
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->available, NULL);
+    queue->done_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    tt_init(&queue->tt, engine_hash);
+    Worker *pool = calloc(workers, sizeof(Worker));
+    if (server.epoll_fd < 0 || queue->done_fd < 0 || pool == NULL) {
+        perror("checkers-server");
+        return EXIT_FAILURE;
+    }
+
+    // The listening socket and the eventfd get tags no session can have
+    // (sessions' generations start at 1)
+    struct epoll_event event = { .events = EPOLLIN, .data.u64 = 0 };
+    epoll_ctl(server.epoll_fd, EPOLL_CTL_ADD, listen_fd, &event);
+    event.data.u64 = 1;
+    epoll_ctl(server.epoll_fd, EPOLL_CTL_ADD, queue->done_fd, &event);
+
+    for (int i = 0; i < workers; i++) {
+        pool[i].queue = queue;
+        pthread_create(&pool[i].thread, NULL, worker_thread, &pool[i]);
+    }
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    struct epoll_event events[64];
+    while (!quitting) {
+        int n = epoll_wait(server.epoll_fd, events, 64, -1);
+        for (int i = 0; i < n; i++) {
+            uint64_t tag = events[i].data.u64;
+            if (tag == 0) {
+                on_connection(&server, listen_fd);
+                continue;
+            }
+            if (tag == 1) {
+                on_jobs_done(&server);
+                continue;
+            }
+
+            // Events for a connection closed earlier in this same batch
+            // don't match the slot's generation anymore
+            int index = (uint32_t) tag;
+            if (index >= server.pool.nchunks * SESSION_CHUNK
+             || session_tag(&server.pool, index) != tag
+             || pool_get(&server.pool, index)->fd < 0)
+                continue;
+
+            if (events[i].events & (EPOLLERR | EPOLLHUP))
+                session_close(&server, index);
+            else if (events[i].events & EPOLLIN)
+                on_readable(&server, index);
+            else if (events[i].events & EPOLLRDHUP)
+                session_close(&server, index);
+        }
+    }
+
+    // Stop the searches in progress and let the workers go
+    pthread_mutex_lock(&queue->lock);
+    queue->quit = true;
+    for (int i = 0; i < workers; i++)
+        atomic_store(&pool[i].search.stop, true);
+    pthread_cond_broadcast(&queue->available);
+    pthread_mutex_unlock(&queue->lock);
+    for (int i = 0; i < workers; i++)
+        pthread_join(pool[i].thread, NULL);
+
+    if (unix_path != NULL)
+        unlink(unix_path);
+    tt_free(&queue->tt);
+    return 0;
+}
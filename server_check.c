@@ -0,0 +1,222 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+/* server_check starts checkers-server on a unix socket and goes through a
+ * few conversations with it, each on a connection of its own, checking that
+ * every reply is the one expected.  They're the cases the server has got
+ * wrong before, so that it doesn't again.
+ *
+ * Usage: server_check [--server PATH]
+ *   --server PATH   the server to run (default ./checkers-server)
+ *
+ * Each conversation that goes wrong is printed, with the reply that was
+ * expected and the one that came (or that none came within REPLY_TIMEOUT).
+ * Returns failure if there was one. */
+
+static const char *server_path = "./checkers-server";
+
+#define REPLY_TIMEOUT 5000   // milliseconds
+#define LINE_LENGTH 4096
+#define MAXLINES 16
+
+/* A Conversation is a list of lines: "> " ones are sent to the server and
+ * "< " ones the replies expected, in order.  An expected reply ending in
+ * '*' only has to start with what comes before. */
+typedef struct {
+    const char *name;
+    const char *lines[MAXLINES];
+} Conversation;
+
+static const Conversation conversations[] = {
+    { "engine to move without movements", {
+        "> new white",
+        "< ok",
+        "< move *",
+        "> position ......../......../......../......../......../..*...../.*....../o....... w",
+        "< ok",
+        "< result black",
+        "> go",
+        "< error the game is over",
+        "> board",
+        "< position ......../......../......../......../......../..*...../.*....../o....... w",
+    } },
+    { "player to move without movements", {
+        "> new black",
+        "< ok",
+        "> position ......../......../......../......../......../..*...../.*....../o....... w",
+        "< ok",
+        "< result black",
+        "> move a1-b2",
+        "< error the game is over",
+    } },
+    { "movement that leaves the engine without movements", {
+        "> new black",
+        "< ok",
+        "> position .......*/......o./......../....o.../......../......../......../........ w",
+        "< ok",
+        "> move e5-f6",
+        "< ok",
+        "< result white",
+        "> go",
+        "< error the game is over",
+    } },
+    { "engine movement", {
+        "> new black",
+        "< ok",
+        "> move c3-d4",
+        "< ok",
+        "< move *",
+        "> moves",
+        "< moves *",
+    } },
+};
+
+
+/* start_server runs the server, listening on 'path'; returns its pid */
+static pid_t start_server(const char *path)
+{
+    pid_t pid = fork();
+    if (pid == 0) {
+        execl(server_path, server_path, "--unix", path, "--workers", "1",
+              "--movetime", "100", "--hash", "1", (char *) NULL);
+        perror(server_path);
+        _exit(EXIT_FAILURE);
+    }
+    return pid;
+}
+
+/* connect_server connects to the server, giving it a few seconds to start
+ * listening; returns -1 if it doesn't */
+static int connect_server(const char *path)
+{
+    struct sockaddr_un address = { .sun_family = AF_UNIX };
+    strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+    for (int tries = 0; tries < 50; tries++) {
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+            return -1;
+        if (connect(fd, (struct sockaddr *) &address, sizeof(address)) == 0)
+            return fd;
+        close(fd);
+        usleep(100000);
+    }
+    return -1;
+}
+
+/* Replies are read through a buffer, since they come in whatever pieces */
+typedef struct {
+    int fd;
+    int length;
+    char data[LINE_LENGTH];
+} Reader;
+
+/* read_line reads the next reply into 'line' (without its newline); returns
+ * false if none comes in time */
+static bool read_line(Reader *reader, char *line)
+{
+    for (;;) {
+        char *newline = memchr(reader->data, '\n', reader->length);
+        if (newline != NULL) {
+            int length = newline - reader->data;
+            memcpy(line, reader->data, length);
+            line[length] = '\0';
+            reader->length -= length + 1;
+            memmove(reader->data, newline + 1, reader->length);
+            return true;
+        }
+
+        struct pollfd poll_fd = { .fd = reader->fd, .events = POLLIN };
+        if (reader->length == LINE_LENGTH || poll(&poll_fd, 1, REPLY_TIMEOUT) <= 0)
+            return false;
+        ssize_t got = read(reader->fd, reader->data + reader->length,
+                           LINE_LENGTH - reader->length);
+        if (got <= 0)
+            return false;
+        reader->length += got;
+    }
+}
+
+static bool matches(const char *expected, const char *line)
+{
+    size_t length = strlen(expected);
+    if (length > 0 && expected[length-1] == '*')
+        return strncmp(expected, line, length - 1) == 0;
+    return strcmp(expected, line) == 0;
+}
+
+/* converse goes through a conversation; returns false (after printing what
+ * went wrong) if a reply isn't the expected one */
+static bool converse(const char *path, const Conversation *conversation)
+{
+    Reader reader = { .fd = connect_server(path) };
+    if (reader.fd < 0) {
+        fprintf(stderr, "%s: can't connect to the server\n", conversation->name);
+        return false;
+    }
+
+    bool ok = true;
+    for (int i = 0; i < MAXLINES && conversation->lines[i] != NULL && ok; i++) {
+        const char *text = conversation->lines[i] + 2;
+        if (conversation->lines[i][0] == '>') {
+            char line[LINE_LENGTH];
+            int length = snprintf(line, sizeof(line), "%s\n", text);
+            ok = write(reader.fd, line, length) == length;
+            if (!ok)
+                fprintf(stderr, "%s: can't send \"%s\"\n", conversation->name, text);
+        } else {
+            char line[LINE_LENGTH];
+            if (!read_line(&reader, line)) {
+                fprintf(stderr, "%s: expected \"%s\", got nothing\n", conversation->name, text);
+                ok = false;
+            } else if (!matches(text, line)) {
+                fprintf(stderr, "%s: expected \"%s\", got \"%s\"\n", conversation->name, text, line);
+                ok = false;
+            }
+        }
+    }
+    close(reader.fd);
+    return ok;
+}
+
+
+static void usage()
+{
+    fprintf(stderr, "usage: server_check [--server PATH]\n");
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++) {
+        if (strcmp("--server", argv[i]) == 0 && i+1 < argc)  server_path = argv[++i];
+        else usage();
+    }
+
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/server_check.%d", (int) getpid());
+    pid_t server = start_server(path);
+    if (server < 0) {
+        perror("fork");
+        return EXIT_FAILURE;
+    }
+
+    int count = sizeof(conversations) / sizeof(conversations[0]);
+    int failures = 0;
+    for (int i = 0; i < count; i++)
+        if (!converse(path, &conversations[i]))
+            failures++;
+
+    kill(server, SIGTERM);
+    waitpid(server, NULL, 0);
+    printf("%d conversations, %d failed\n", count, failures);
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
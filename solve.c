@@ -0,0 +1,93 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include "checkers.h"
+
+/* solve tries to prove a position won or lost with proof-number search
+ * (see pns.c), for sharp positions whose outcome a depth-limited search
+ * can't see the end of.
+ *
+ * Usage: solve [options] POSITION
+ *   --hash MB    table size (default 256); the search never uses more
+ *   --time S     give up after S seconds (default: no limit)
+ *   --nodes N    ... or after N nodes
+ * POSITION is written like game_to_text writes it (quoted, it has a space).
+ * ^C gives up too.
+ *
+ * It prints how it's going once a second on stderr, and then "win", "loss"
+ * (for the player to move) or "unknown" -- a draw, or not enough time or
+ * memory -- with the line of play the proof found:
+ *   win in 17: e3-f4 g5xe3 d2xf4 ... */
+
+static size_t hash_mb = 256;
+static long seconds = 0;
+static long max_nodes = 0;
+
+static Proof_search *running;
+
+static void on_signal(int signal)
+{
+    (void) signal;
+    atomic_store(&running->stop, true);
+}
+
+static void on_progress(Proof_search *ps, void *data)
+{
+    long start = *(long *) data;
+    long nodes = atomic_load(&ps->nodes);
+    long ms = now_ms() - start;
+    fprintf(stderr, "\r%s: %ld nodes, %.0f/s, %ld s ",
+            ps->attacker == WHITE ? "white wins?" : "black wins?", nodes,
+            (double) nodes / (ms > 0 ? ms : 1) * 1000, ms / 1000);
+}
+
+static void usage()
+{
+    fprintf(stderr, "usage: solve [--hash MB] [--time S] [--nodes N] POSITION\n");
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv)
+{
+    Game_state state;
+    bool position_given = false;
+    for (int i = 1; i < argc; i++) {
+        if      (strcmp("--hash", argv[i]) == 0 && i+1 < argc)   hash_mb = atol(argv[++i]);
+        else if (strcmp("--time", argv[i]) == 0 && i+1 < argc)   seconds = atol(argv[++i]);
+        else if (strcmp("--nodes", argv[i]) == 0 && i+1 < argc)  max_nodes = atol(argv[++i]);
+        else if (argv[i][0] != '-' && game_from_text(&state, argv[i]))  position_given = true;
+        else usage();
+    }
+    if (!position_given || hash_mb == 0 || seconds < 0 || max_nodes < 0)
+        usage();
+
+    Proof_search *ps = malloc(sizeof(Proof_search));
+    if (ps == NULL || !proof_init(ps, hash_mb, seconds * 1000)) {
+        fprintf(stderr, "solve: out of memory\n");
+        return EXIT_FAILURE;
+    }
+    long start = now_ms();
+    ps->max_nodes = max_nodes;
+    ps->on_progress = on_progress;
+    ps->on_progress_data = &start;
+    running = ps;
+    signal(SIGINT, on_signal);
+
+    Proof result = proof_solve(&state, ps);
+    long ms = now_ms() - start;
+    fprintf(stderr, "\r%ld nodes in %ld ms%20s\n", atomic_load(&ps->nodes), ms, "");
+
+    if (result == PROOF_UNKNOWN) {
+        printf("unknown\n");
+    } else {
+        char line[MAXPV * MOVE_TEXT_LENGTH];
+        pv_to_text(&state, &ps->line, line, sizeof(line));
+        printf("%s in %d%s: %s\n", result == PROOF_WIN ? "win" : "loss", ps->line.length,
+               ps->line.length == MAXPV ? "+" : "", line);
+    }
+
+    proof_free(ps);
+    free(ps);
+    return 0;
+}
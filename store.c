@@ -0,0 +1,308 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "checkers.h"
+
+/* See checkers.h for what the store looks like on disk. */
+
+static void file_header(Store_file_header *header, const char *magic)
+{
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, magic, 4);
+    header->version = strcmp(magic, STORE_INDEX_MAGIC) == 0 ? STORE_INDEX_VERSION : STORE_VERSION;
+    header->board_size = BOARD_SIZE;
+    header->variant = VARIANT;
+}
+
+static bool same_header(Store_file_header *a, Store_file_header *b)
+{
+    return memcmp(a->magic, b->magic, 4) == 0 && a->version == b->version
+        && a->board_size == b->board_size && a->variant == b->variant;
+}
+
+/* open_log opens games.log for appending, creating it if it's not there. */
+static int open_log(const char *directory)
+{
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/games.log", directory);
+    int fd = open(path, O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return -1;
+
+    // Whoever creates the file writes the header; the others wait for it
+    Store_file_header expected, header;
+    file_header(&expected, STORE_LOG_MAGIC);
+    flock(fd, LOCK_EX);
+    if (lseek(fd, 0, SEEK_END) == 0
+     && write(fd, &expected, sizeof(expected)) != sizeof(expected)) {
+        close(fd);
+        return -1;
+    }
+    flock(fd, LOCK_UN);
+
+    if (pread(fd, &header, sizeof(header), 0) != sizeof(header)
+     || !same_header(&header, &expected)) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+    return fd;
+}
+
+/* open_index opens and maps positions.idx, creating it with room for
+ * 'entries' positions (rounded up to a power of two) if it's not there. */
+static bool open_index(Game_store *store, const char *directory, uint64_t entries)
+{
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/positions.idx", directory);
+    store->index_fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (store->index_fd < 0)
+        return false;
+
+    uint64_t capacity = 1;
+    while (capacity < entries)
+        capacity *= 2;
+
+    flock(store->index_fd, LOCK_EX);
+    struct stat st;
+    if (fstat(store->index_fd, &st) == 0 && st.st_size == 0) {
+        // A new index: the entries start out as zeros, which is what
+        // ftruncate fills the file with (without using the disk for them)
+        Index_header header;
+        memset(&header, 0, sizeof(header));
+        file_header(&header.file, STORE_INDEX_MAGIC);
+        header.capacity = capacity;
+        if (write(store->index_fd, &header, sizeof(header)) != sizeof(header)
+         || ftruncate(store->index_fd, sizeof(header) + capacity * sizeof(Index_entry)) < 0) {
+            flock(store->index_fd, LOCK_UN);
+            return false;
+        }
+        fstat(store->index_fd, &st);
+    }
+    flock(store->index_fd, LOCK_UN);
+
+    store->map_size = st.st_size;
+    store->index = mmap(NULL, store->map_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                        store->index_fd, 0);
+    if (store->index == MAP_FAILED) {
+        store->index = NULL;
+        return false;
+    }
+
+    Store_file_header expected;
+    file_header(&expected, STORE_INDEX_MAGIC);
+    if (store->map_size < sizeof(Index_header)
+     || !same_header(&store->index->file, &expected)
+     || store->map_size != sizeof(Index_header) + store->index->capacity * sizeof(Index_entry)) {
+        errno = EINVAL;
+        return false;
+    }
+    store->entries = (Index_entry *) (store->index + 1);
+    return true;
+}
+
+/* store_open opens the store in 'directory' (which must exist), creating its
+ * files if they're not there yet; a new index gets room for 'index_entries'
+ * positions.  Returns false (with errno telling why) if it couldn't, e.g.
+ * because the files were written by a build with other rules. */
+bool store_open(Game_store *store, const char *directory, uint64_t index_entries)
+{
+    store->index = NULL;
+    store->index_fd = -1;
+    store->log_fd = open_log(directory);
+    if (store->log_fd < 0 || !open_index(store, directory, index_entries)) {
+        int error = errno;
+        store_close(store);
+        errno = error;
+        return false;
+    }
+    return true;
+}
+
+void store_close(Game_store *store)
+{
+    if (store->index != NULL)   munmap(store->index, store->map_size);
+    if (store->index_fd >= 0)   close(store->index_fd);
+    if (store->log_fd >= 0)     close(store->log_fd);
+    store->index = NULL;
+    store->index_fd = store->log_fd = -1;
+}
+
+
+/* A position is never further than this from its place in the table; when
+ * the table gets that crowded, new positions are left out. */
+#define MAXPROBES 256
+
+/* find_entry gives the position's entry in the index, taking an empty one
+ * for it if 'add' and it's not there yet.  NULL if it's not there (or there's
+ * no room left for it).
+ * Entries are never removed, so a probe can stop at the first empty one; a
+ * writer claims an empty entry by swapping its key in, and if another writer
+ * got there first it just takes a look at what key that one put. */
+static Index_entry *find_entry(Game_store *store, uint64_t hash, bool add)
+{
+    uint64_t key = hash != 0 ? hash : 1;  // 0 marks empty entries
+    uint64_t mask = store->index->capacity - 1;
+
+    for (uint64_t probe = 0; probe < MAXPROBES && probe <= mask; probe++) {
+        Index_entry *entry = &store->entries[(key + probe) & mask];
+        uint64_t found = atomic_load_explicit(&entry->key, memory_order_acquire);
+        if (found == 0) {
+            if (!add)
+                return NULL;
+            if (atomic_compare_exchange_strong(&entry->key, &found, key)) {
+                atomic_fetch_add(&store->index->used, 1);
+                return entry;
+            }
+        }
+        if (found == key)
+            return entry;
+    }
+    return NULL;
+}
+
+/* A position of a game, by its key (see game_key) */
+typedef struct {
+    uint64_t key;
+    bool mirrored;
+} Game_position;
+
+static int compare_positions(const void *a, const void *b)
+{
+    uint64_t x = ((const Game_position *) a)->key, y = ((const Game_position *) b)->key;
+    return (x > y) - (x < y);
+}
+
+/* The entry of a position reached by its mirror image counts the results
+ * the other way around */
+static Situation mirror_result(Situation result, bool mirrored)
+{
+    if (mirrored && result == WHITE_WINS)  return BLACK_WINS;
+    if (mirrored && result == BLACK_WINS)  return WHITE_WINS;
+    return result;
+}
+
+/* store_append adds a game to the log and its positions to the index.  The
+ * moves are checked by replaying them; returns false if they're not legal
+ * or the game couldn't be written (a full index only loses the positions
+ * that don't fit). */
+bool store_append(Game_store *store, Game_record *record)
+{
+    Game_position positions[MAXRECORD + 1];
+    Game_state state;
+    game_setup(&state);
+    positions[0].key = game_key(&state, &positions[0].mirrored);
+    for (int turn = 0; turn < record->length; turn++) {
+        Move move;
+        if (!record_move(record, turn, &state, &move))
+            return false;
+        game_apply_move(&state, &move);
+        positions[turn + 1].key = game_key(&state, &positions[turn + 1].mirrored);
+    }
+
+    // The whole game in one write, so that games appended at the same time
+    // by different processes don't get mixed up
+    uint8_t buffer[sizeof(Record_header) + MAXRECORD];
+    Record_header header = {
+        .length = (uint16_t) record->length,
+        .result = (uint8_t) record->result,
+    };
+    size_t size = sizeof(header) + record->length;
+    memcpy(buffer, &header, sizeof(header));
+    memcpy(buffer + sizeof(header), record->moves, record->length);
+    if (write(store->log_fd, buffer, size) != (ssize_t) size)
+        return false;
+
+    int npositions = record->length + 1;
+    qsort(positions, npositions, sizeof(Game_position), compare_positions);
+    for (int i = 0; i < npositions; i++) {
+        if (i > 0 && positions[i].key == positions[i-1].key)
+            continue;
+        Index_entry *entry = find_entry(store, positions[i].key, true);
+        if (entry == NULL)
+            continue;
+        Situation result = mirror_result(record->result, positions[i].mirrored);
+        if (result != ONGOING)
+            atomic_fetch_add_explicit(&entry->results[result - 1], 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&entry->games, 1, memory_order_relaxed);
+    }
+    atomic_fetch_add_explicit(&store->index->games, 1, memory_order_relaxed);
+    return true;
+}
+
+/* store_lookup tells how many games reached the position and how they ended.
+ * Returns false if none did.  (The counts of a game that's being added right
+ * then may be seen half updated.) */
+bool store_lookup(Game_store *store, Game_state *state, Position_stats *stats)
+{
+    bool mirrored;
+    Index_entry *entry = find_entry(store, game_key(state, &mirrored), false);
+    if (entry == NULL)
+        return false;
+
+    Situation white_wins = mirror_result(WHITE_WINS, mirrored);
+    Situation black_wins = mirror_result(BLACK_WINS, mirrored);
+    stats->games      = atomic_load_explicit(&entry->games, memory_order_relaxed);
+    stats->white_wins = atomic_load_explicit(&entry->results[white_wins - 1], memory_order_relaxed);
+    stats->black_wins = atomic_load_explicit(&entry->results[black_wins - 1], memory_order_relaxed);
+    stats->ties       = atomic_load_explicit(&entry->results[TIE - 1], memory_order_relaxed);
+    return true;
+}
+
+/* store_read reads the game at 'offset' in the log (0 for the first one)
+ * and returns the offset of the next one, or -1 if there are no more. */
+long store_read(Game_store *store, long offset, Game_record *record)
+{
+    if (offset == 0)
+        offset = sizeof(Store_file_header);
+
+    Record_header header;
+    if (pread(store->log_fd, &header, sizeof(header), offset) != sizeof(header)
+     || header.length > MAXRECORD || header.result > TIE)
+        return -1;
+    offset += sizeof(header);
+    if (pread(store->log_fd, record->moves, header.length, offset) != header.length)
+        return -1;
+
+    record->length = header.length;
+    record->result = header.result;
+    return offset + header.length;
+}
+
+
+void record_init(Game_record *record)
+{
+    record->result = ONGOING;
+    record->length = 0;
+}
+
+/* record_push adds the next turn to the record: 'move', out of the 'moves'
+ * that were possible then.  Returns false if the record is full (or the move
+ * isn't in the list). */
+bool record_push(Game_record *record, Move_list *moves, Move *move)
+{
+    int index = find_move(moves, move);
+    if (index < 0 || record->length == MAXRECORD)
+        return false;
+    record->moves[record->length++] = (uint8_t) index;
+    return true;
+}
+
+/* record_move gets the movement of the given turn, 'state' being the position
+ * the game was in then.  Returns false if the record doesn't make sense
+ * there. */
+bool record_move(Game_record *record, int turn, Game_state *state, Move *move)
+{
+    Move_list moves;
+    generate_moves(state, &moves);
+    if (turn >= record->length || record->moves[turn] >= moves.length)
+        return false;
+    *move = moves.array[record->moves[turn]];
+    return true;
+}
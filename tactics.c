@@ -0,0 +1,371 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include "checkers.h"
+
+/* tactics runs the search on a suite of positions whose best movement is
+ * known (shots, breakthroughs, dame endings...), to tell how strong and how
+ * fast it is at the same time: how many it solves, and how much time and
+ * how many nodes it takes to find each solution.
+ *
+ * Usage: tactics [FILE] [options]
+ *   FILE             the suite (default tactics.txt)
+ *   --movetime MS    time per position (default 1000, unless one of the
+ *                    other limits is given)
+ *   --nodes N        nodes per position
+ *   --depth N        depth per position
+ *   --threads N      positions searched at a time (default: one per core)
+ *   --hash MB        transposition table of each thread (default 16)
+ *   --no-times       leave the times out of the report
+ *   --compare        also search each position with plain alpha-beta (see
+ *                    Search.plain), and report how many nodes both searches
+ *                    took to get to each depth; this needs --depth (9 if
+ *                    not given) and no other limit
+ *
+ * Each line of the suite is a position (see game_to_text), the movements
+ * that solve it and a name, separated by ';':
+ *   <position> ; <move> [<move>...] ; <name>
+ * Empty lines and lines starting with '#' are skipped.
+ *
+ * A position is solved when the search ends with one of its movements, and
+ * it was solved at the first depth from which the search kept choosing one
+ * of them.  The report has one line per position, in the suite's order, and
+ * the totals; each thread clears its table before each position, so with
+ * --nodes or --depth (and --no-times) the same engine always writes the same
+ * report, and two engines can be compared with diff. */
+
+static long movetime_ms = 0;
+static long max_nodes = 0;
+static int max_depth = 0;
+static size_t hash_mb = 16;
+static bool show_times = true;
+static bool compare = false;
+
+#define MAXSOLUTIONS 8
+#define MAXNAME 64
+
+typedef struct {
+    int line;
+    char name[MAXNAME];
+    Game_state state;
+    int solutions[MAXSOLUTIONS];  // indexes in the position's Move_list
+    int nsolutions;
+
+    // What the search made of it
+    Move best;
+    int depth;
+    long nodes, ms;
+    int solved_depth;             // 0 if not solved
+    long solved_nodes, solved_ms;
+
+    // With --compare: the nodes it took to finish each depth, with plain
+    // alpha-beta [0] and with the usual search [1]; 0 if it didn't get there
+    long depth_nodes[2][MAXDEPTH + 1];
+} Problem;
+
+typedef struct {
+    Problem *problems;
+    int nproblems;
+    atomic_int next;              // the next problem a thread may take
+} Suite;
+
+/* Each time a depth is done, the Problem's solution depth is set if the best
+ * movement is a solution, and forgotten if it isn't */
+typedef struct {
+    Problem *problem;
+    Move_list moves;
+    long start;
+    bool plain;
+} Attempt;
+
+static void on_depth(Search *searcher, void *data)
+{
+    Attempt *attempt = data;
+    Problem *problem = attempt->problem;
+    problem->depth_nodes[!attempt->plain][atomic_load(&searcher->depth)]
+        = atomic_load(&searcher->nodes);
+    if (attempt->plain)
+        return;
+
+    int index = find_move(&attempt->moves, &searcher->best);
+    bool solution = false;
+    for (int i = 0; i < problem->nsolutions; i++)
+        if (problem->solutions[i] == index)
+            solution = true;
+
+    if (!solution) {
+        problem->solved_depth = 0;
+    } else if (problem->solved_depth == 0) {
+        problem->solved_depth = atomic_load(&searcher->depth);
+        problem->solved_nodes = atomic_load(&searcher->nodes);
+        problem->solved_ms = now_ms() - attempt->start;
+    }
+}
+
+static void solve(Problem *problem, Search *searcher, Ttable *tt)
+{
+    Attempt attempt = { .problem = problem };
+    generate_moves(&problem->state, &attempt.moves);
+
+    tt_clear(tt);
+    problem->solved_depth = 0;
+    attempt.start = now_ms();
+    search_init(searcher, max_depth, movetime_ms, tt, NULL);
+    searcher->max_nodes = max_nodes;
+    searcher->on_depth = on_depth;
+    searcher->on_depth_data = &attempt;
+    search(&problem->state, searcher);
+
+    problem->best = searcher->best;
+    problem->depth = atomic_load(&searcher->depth);
+    problem->nodes = atomic_load(&searcher->nodes);
+    problem->ms = now_ms() - attempt.start;
+
+    if (compare) {
+        tt_clear(tt);
+        attempt.plain = true;
+        search_init(searcher, max_depth, 0, tt, NULL);
+        searcher->plain = true;
+        searcher->on_depth = on_depth;
+        searcher->on_depth_data = &attempt;
+        search(&problem->state, searcher);
+    }
+}
+
+static void *solve_thread(void *arg)
+{
+    Suite *suite = arg;
+
+    // Search holds a whole History, so it's better off on the heap
+    Search *searcher = malloc(sizeof(Search));
+    Ttable tt;
+    if (searcher == NULL || !tt_init(&tt, hash_mb)) {
+        free(searcher);
+        return NULL;
+    }
+
+    int i;
+    while ((i = atomic_fetch_add(&suite->next, 1)) < suite->nproblems)
+        solve(&suite->problems[i], searcher, &tt);
+
+    tt_free(&tt);
+    free(searcher);
+    return NULL;
+}
+
+
+static char *trim(char *text)
+{
+    while (isspace((unsigned char) *text))
+        text++;
+    char *end = text + strlen(text);
+    while (end > text && isspace((unsigned char) end[-1]))
+        *--end = '\0';
+    return text;
+}
+
+/* parse_problem reads a line of the suite into 'problem'; returns false (and
+ * says why) if it isn't one */
+static bool parse_problem(char *line, Problem *problem, const char *file)
+{
+    char *position = line;
+    char *solutions = strchr(position, ';');
+    if (solutions == NULL) {
+        fprintf(stderr, "%s:%d: no ';' after the position\n", file, problem->line);
+        return false;
+    }
+    *solutions++ = '\0';
+    char *name = strchr(solutions, ';');
+    if (name != NULL)
+        *name++ = '\0';
+
+    if (!game_from_text(&problem->state, trim(position))) {
+        fprintf(stderr, "%s:%d: not a position (for this board)\n", file, problem->line);
+        return false;
+    }
+
+    Move_list moves;
+    generate_moves(&problem->state, &moves);
+    problem->nsolutions = 0;
+    for (char *text = strtok(solutions, " \t\n"); text != NULL; text = strtok(NULL, " \t\n")) {
+        Move move;
+        if (problem->nsolutions == MAXSOLUTIONS || !move_from_text(&problem->state, text, &move)) {
+            fprintf(stderr, "%s:%d: %s can't be played there\n", file, problem->line, text);
+            return false;
+        }
+        problem->solutions[problem->nsolutions++] = find_move(&moves, &move);
+    }
+    if (problem->nsolutions == 0) {
+        fprintf(stderr, "%s:%d: no solution\n", file, problem->line);
+        return false;
+    }
+
+    if (name != NULL && *trim(name) != '\0')
+        snprintf(problem->name, MAXNAME, "%s", trim(name));
+    else
+        snprintf(problem->name, MAXNAME, "line %d", problem->line);
+    return true;
+}
+
+static bool read_suite(const char *file, Suite *suite)
+{
+    FILE *in = fopen(file, "r");
+    if (in == NULL) {
+        perror(file);
+        return false;
+    }
+
+    char line[512];
+    int capacity = 0, number = 0;
+    bool ok = true;
+    while (fgets(line, sizeof(line), in) != NULL) {
+        number++;
+        char *text = trim(line);
+        if (*text == '\0' || *text == '#')
+            continue;
+
+        if (suite->nproblems == capacity) {
+            capacity = capacity > 0 ? capacity * 2 : 64;
+            suite->problems = realloc(suite->problems, capacity * sizeof(Problem));
+            if (suite->problems == NULL) {
+                fprintf(stderr, "out of memory\n");
+                fclose(in);
+                return false;
+            }
+        }
+        Problem *problem = &suite->problems[suite->nproblems];
+        memset(problem, 0, sizeof(*problem));
+        problem->line = number;
+        if (parse_problem(text, problem, file))
+            suite->nproblems++;
+        else
+            ok = false;
+    }
+    fclose(in);
+    return ok;
+}
+
+/* report prints a line per problem and the totals.  Unsolved problems count
+ * with everything their search took, as if they had been solved right at
+ * the end. */
+static void report(Suite *suite)
+{
+    printf("%-32s %-8s %-12s %5s %10s", "position", "result", "move", "depth", "nodes");
+    if (show_times)
+        printf(" %8s", "ms");
+    printf("\n");
+
+    int solved = 0;
+    long total_nodes = 0, total_ms = 0;
+    for (int i = 0; i < suite->nproblems; i++) {
+        Problem *problem = &suite->problems[i];
+        Move_list moves;
+        generate_moves(&problem->state, &moves);
+        char text[MOVE_TEXT_LENGTH];
+        move_to_text(&problem->best, moves.type, text);
+
+        if (problem->solved_depth > 0) {
+            solved++;
+            printf("%-32s %-8s %-12s %5d %10ld", problem->name, "solved", text,
+                   problem->solved_depth, problem->solved_nodes);
+            if (show_times)
+                printf(" %8ld", problem->solved_ms);
+            total_nodes += problem->solved_nodes;
+            total_ms += problem->solved_ms;
+        } else {
+            printf("%-32s %-8s %-12s %5d %10ld", problem->name, "FAILED", text,
+                   problem->depth, problem->nodes);
+            if (show_times)
+                printf(" %8ld", problem->ms);
+            total_nodes += problem->nodes;
+            total_ms += problem->ms;
+        }
+        printf("\n");
+    }
+
+    printf("solved %d of %d, %ld nodes", solved, suite->nproblems, total_nodes);
+    if (show_times)
+        printf(", %.1f s", total_ms / 1000.0);
+    printf(" to solution\n");
+}
+
+/* report_depths prints, for each depth, how many nodes both searches took to
+ * get there, added up over the positions where both did (a search stops
+ * early when it finds a win). */
+static void report_depths(Suite *suite)
+{
+    printf("\n%5s %9s %12s %12s %6s\n", "depth", "positions", "plain", "nodes", "ratio");
+    for (int depth = 1; depth <= max_depth; depth++) {
+        int positions = 0;
+        long plain = 0, nodes = 0;
+        for (int i = 0; i < suite->nproblems; i++) {
+            long *depth_nodes[2] = { suite->problems[i].depth_nodes[0],
+                                     suite->problems[i].depth_nodes[1] };
+            if (depth_nodes[0][depth] == 0 || depth_nodes[1][depth] == 0)
+                continue;
+            positions++;
+            plain += depth_nodes[0][depth];
+            nodes += depth_nodes[1][depth];
+        }
+        if (positions == 0)
+            break;
+        printf("%5d %9d %12ld %12ld %6.2f\n", depth, positions, plain, nodes,
+               (double) nodes / plain);
+    }
+}
+
+static void usage()
+{
+    fprintf(stderr, "usage: tactics [FILE] [--movetime MS] [--nodes N] [--depth N]"
+                    " [--threads N] [--hash MB] [--no-times] [--compare]\n");
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv)
+{
+    const char *file = "tactics.txt";
+    int threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    for (int i = 1; i < argc; i++) {
+        if      (strcmp("--movetime", argv[i]) == 0 && i+1 < argc)  movetime_ms = atol(argv[++i]);
+        else if (strcmp("--nodes", argv[i]) == 0 && i+1 < argc)     max_nodes = atol(argv[++i]);
+        else if (strcmp("--depth", argv[i]) == 0 && i+1 < argc)     max_depth = atoi(argv[++i]);
+        else if (strcmp("--threads", argv[i]) == 0 && i+1 < argc)   threads = atoi(argv[++i]);
+        else if (strcmp("--hash", argv[i]) == 0 && i+1 < argc)      hash_mb = atol(argv[++i]);
+        else if (strcmp("--no-times", argv[i]) == 0)                show_times = false;
+        else if (strcmp("--compare", argv[i]) == 0)                 compare = true;
+        else if (argv[i][0] != '-')                                 file = argv[i];
+        else usage();
+    }
+    if (compare) {
+        movetime_ms = max_nodes = 0;
+        if (max_depth <= 0 || max_depth > MAXDEPTH)
+            max_depth = 9;
+    } else if (movetime_ms <= 0 && max_nodes <= 0 && max_depth <= 0) {
+        movetime_ms = 1000;
+    }
+    if (threads < 1)
+        threads = 1;
+
+    static Suite suite;
+    if (!read_suite(file, &suite) && suite.nproblems == 0)
+        return EXIT_FAILURE;
+
+    pthread_t *pool = malloc(threads * sizeof(pthread_t));
+    int started = 0;
+    for (; pool != NULL && started < threads && started < suite.nproblems; started++)
+        if (pthread_create(&pool[started], NULL, solve_thread, &suite) != 0)
+            break;
+    if (started == 0)
+        solve_thread(&suite);  // no threads: do it all right here
+    for (int t = 0; t < started; t++)
+        pthread_join(pool[t], NULL);
+    free(pool);
+
+    report(&suite);
+    if (compare)
+        report_depths(&suite);
+    free(suite.problems);
+    return 0;
+}
@@ -1,3 +1,4 @@
+#include <stdio.h>
 #include "checkers.h"
 
 int main()
@@ -8,10 +9,16 @@ int main()
     // printf("%g\n", evaluate(&state, WHITE));
     // printf("%g\n", evaluate(&state, BLACK));
 
-    Position src, dest;
-    minimax(&state, 2, WHITE, &src, &dest);
+    // Only does something when built with -DTRACE_SEARCH
+    TRACE_OPEN("search.trace");
 
-    printf("(%d,%d) -> (%d,%d)\n", src.col, src.row, dest.col, dest.row);
+    Move best;
+    minimax(&state, 2, WHITE, &best);
+
+    TRACE_CLOSE();
+
+    char str[10*MAXPATH];
+    printf("%s\n", write_move(&best, str));
 
     return 0;
 }
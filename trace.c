@@ -0,0 +1,63 @@
+#include <stdio.h>
+#include <string.h>
+#include "checkers.h"
+
+/* The trace file currently being written; NULL when no trace is open, in
+ * which case trace_record does nothing.  Only one search at a time is traced. */
+static FILE *trace_file = NULL;
+
+/* Searches visit a lot of nodes, so give stdio a big buffer instead of
+ * hitting the disk every few records. */
+static char trace_buffer[1 << 16];
+
+static uint8_t pack_position(Position p)
+{
+    return (uint8_t) (p.row << 4 | p.col);
+}
+
+/* trace_open creates (or truncates) the trace file at 'path' and writes its
+ * header.  Returns false if the file couldn't be created. */
+bool trace_open(const char *path)
+{
+    trace_close();
+
+    trace_file = fopen(path, "wb");
+    if (trace_file == NULL)
+        return false;
+    setvbuf(trace_file, trace_buffer, _IOFBF, sizeof(trace_buffer));
+
+    uint32_t version = TRACE_VERSION;
+    fwrite(TRACE_MAGIC, 1, strlen(TRACE_MAGIC), trace_file);
+    fwrite(&version, sizeof(version), 1, trace_file);
+    return true;
+}
+
+/* trace_record appends a record for the movement src -> dest, searched at
+ * 'ply' with 'depth' plies left in the window [alpha, beta], which turned out
+ * to be worth 'score'. */
+void trace_record(int ply, int depth, Position src, Position dest,
+                  double alpha, double beta, double score)
+{
+    if (trace_file == NULL)
+        return;
+
+    Trace_record record = {
+        .ply   = (uint8_t) ply,
+        .depth = (uint8_t) depth,
+        .src   = pack_position(src),
+        .dest  = pack_position(dest),
+        .alpha = (float) alpha,
+        .beta  = (float) beta,
+        .score = (float) score,
+    };
+    fwrite(&record, sizeof(record), 1, trace_file);
+}
+
+/* trace_close flushes and closes the trace file, if there's one open. */
+void trace_close()
+{
+    if (trace_file != NULL) {
+        fclose(trace_file);
+        trace_file = NULL;
+    }
+}
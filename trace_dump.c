@@ -0,0 +1,145 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "checkers.h"
+
+/* trace_dump reads a search trace written by trace.c and prints it as an
+ * indented tree (one movement per line, replies indented under it), or as
+ * flat lines that are easy to grep/sort.
+ *
+ * Usage: trace_dump [options] file.trace
+ *   --max-ply N     don't show movements deeper than N plies from the root
+ *   --move C,R-C,R  only show the subtree of this root movement
+ *   --flat          one line per movement, no indentation, in file order
+ *   --summary       just count the movements searched at each ply
+ *
+ * Positions are printed as (col,row), the same way test.c prints them.
+ */
+
+static int max_ply = 255;
+static bool filter_move = false;
+static uint8_t filter_src, filter_dest;
+
+static void print_record(Trace_record *r, int indent)
+{
+    print_indentation(indent);
+    printf("(%d,%d) -> (%d,%d) %g [%g, %g] depth %d\n",
+            r->src & 0xF, r->src >> 4, r->dest & 0xF, r->dest >> 4,
+            r->score, r->alpha, r->beta, r->depth);
+}
+
+/* render prints the records in [start, end), which hold the subtrees of the
+ * movements at 'ply'.  Since the file is in post-order, each movement comes
+ * right after its own subtree, so the first record with ply == 'ply' closes
+ * the first subtree, the next one closes the second, and so on. */
+static void render(Trace_record *records, int start, int end, int ply)
+{
+    int first = start;
+    while (first < end) {
+        int root = first;
+        while (root < end && records[root].ply != ply)
+            root++;
+        if (root == end)
+            break;  // truncated trace: the rest has no parent record
+
+        Trace_record *r = &records[root];
+        bool shown = ply < max_ply
+                  && !(filter_move && ply == 0
+                       && (r->src != filter_src || r->dest != filter_dest));
+        if (shown) {
+            print_record(r, ply * 4);
+            render(records, first, root, ply + 1);
+        }
+        first = root + 1;
+    }
+}
+
+static bool parse_move(char *s, uint8_t *src, uint8_t *dest)
+{
+    int scol, srow, dcol, drow;
+    if (sscanf(s, "%d,%d-%d,%d", &scol, &srow, &dcol, &drow) != 4)
+        return false;
+    *src  = (uint8_t) (srow << 4 | scol);
+    *dest = (uint8_t) (drow << 4 | dcol);
+    return true;
+}
+
+static void usage()
+{
+    fprintf(stderr, "usage: trace_dump [--max-ply N] [--move C,R-C,R]"
+                    " [--flat | --summary] file.trace\n");
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv)
+{
+    bool flat = false, summary = false;
+    char *path = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--max-ply") == 0 && i + 1 < argc)
+            max_ply = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--move") == 0 && i + 1 < argc) {
+            if (!parse_move(argv[++i], &filter_src, &filter_dest))
+                usage();
+            filter_move = true;
+        }
+        else if (strcmp(argv[i], "--flat") == 0)     flat = true;
+        else if (strcmp(argv[i], "--summary") == 0)  summary = true;
+        else if (path == NULL)                       path = argv[i];
+        else                                         usage();
+    }
+    if (path == NULL)
+        usage();
+
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        perror(path);
+        return EXIT_FAILURE;
+    }
+
+    char magic[4];
+    uint32_t version;
+    if (fread(magic, 1, 4, file) != 4 || memcmp(magic, TRACE_MAGIC, 4) != 0
+     || fread(&version, sizeof(version), 1, file) != 1 || version != TRACE_VERSION) {
+        fprintf(stderr, "%s: not a version %d search trace\n", path, TRACE_VERSION);
+        return EXIT_FAILURE;
+    }
+
+    // The whole trace is loaded because rendering it as a tree needs to look
+    // ahead (a movement is stored after its replies).
+    int length = 0, capacity = 1024;
+    Trace_record *records = malloc(capacity * sizeof(*records));
+    while (records != NULL && fread(&records[length], sizeof(*records), 1, file) == 1) {
+        if (++length == capacity) {
+            capacity *= 2;
+            records = realloc(records, capacity * sizeof(*records));
+        }
+    }
+    fclose(file);
+    if (records == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    if (summary) {
+        long per_ply[256] = { 0 };
+        for (int i = 0; i < length; i++)
+            per_ply[records[i].ply]++;
+        for (int ply = 0; ply < 256 && ply < max_ply; ply++)
+            if (per_ply[ply] > 0)
+                printf("ply %d: %ld movements\n", ply, per_ply[ply]);
+    } else if (flat) {
+        for (int i = 0; i < length; i++) {
+            if (records[i].ply >= max_ply)
+                continue;
+            printf("%d ", records[i].ply);
+            print_record(&records[i], 0);
+        }
+    } else {
+        render(records, 0, length, 0);
+    }
+
+    free(records);
+    return 0;
+}
@@ -0,0 +1,136 @@
+#include <string.h>
+#include <math.h>
+#include "checkers.h"
+
+_Static_assert(DARK_SQUARES <= sizeof(Square_mask) * 8, "Square_mask is too small");
+
+/* dark_square numbers the dark squares row by row from a1; they're the ones
+ * whose row and column have the same parity (a1 is dark). */
+int dark_square(Position pos)
+{
+    return pos.row * (BOARD_SIZE / 2) + pos.col / 2;
+}
+
+Position dark_square_position(int square)
+{
+    Position pos;
+    pos.row = square / (BOARD_SIZE / 2);
+    pos.col = square % (BOARD_SIZE / 2) * 2 + pos.row % 2;
+    return pos;
+}
+
+
+/* mirror_squares turns a mask around with the board (see game_key): dark
+ * square i becomes DARK_SQUARES-1-i, since turning the board around reverses
+ * the order of the rows and of the squares in each of them.  So it's just
+ * reversing the bits, swapping halves, then quarters, and so on. */
+Square_mask mirror_squares(Square_mask squares)
+{
+    uint64_t x = squares;
+    x = (x >> 1  & 0x5555555555555555ull) | (x & 0x5555555555555555ull) << 1;
+    x = (x >> 2  & 0x3333333333333333ull) | (x & 0x3333333333333333ull) << 2;
+    x = (x >> 4  & 0x0F0F0F0F0F0F0F0Full) | (x & 0x0F0F0F0F0F0F0F0Full) << 4;
+    x = (x >> 8  & 0x00FF00FF00FF00FFull) | (x & 0x00FF00FF00FF00FFull) << 8;
+    x = (x >> 16 & 0x0000FFFF0000FFFFull) | (x & 0x0000FFFF0000FFFFull) << 16;
+    x = x >> 32 | x << 32;
+    return (Square_mask) (x >> (64 - DARK_SQUARES));
+}
+
+/* mirror_packed makes the packed position its mirror image: the board
+ * turned around, the colors (and the game's winner) swapped and the other
+ * player to move.  The score, being the player to move's, stays. */
+void mirror_packed(Packed_position *packed)
+{
+    Square_mask black = packed->occupied & ~packed->white;
+    packed->occupied = mirror_squares(packed->occupied);
+    packed->white = mirror_squares(black);
+    packed->dames = mirror_squares(packed->dames);
+
+    Situation result = (Situation) (packed->flags >> 1 & 3);
+    if      (result == WHITE_WINS)  result = BLACK_WINS;
+    else if (result == BLACK_WINS)  result = WHITE_WINS;
+    packed->flags = ((packed->flags & PACKED_BLACK_TO_MOVE) ^ PACKED_BLACK_TO_MOVE) | result << 1;
+}
+
+
+void pack_position(Game_state *state, double score, Situation result, Packed_position *packed)
+{
+    memset(packed, 0, sizeof(*packed));
+    for (int square = 0; square < DARK_SQUARES; square++) {
+        Piece piece = get_piece(state, dark_square_position(square));
+        if (is_empty(piece))
+            continue;
+        Square_mask bit = (Square_mask) 1 << square;
+        packed->occupied |= bit;
+        if (is_white(piece))  packed->white |= bit;
+        if (is_dame(piece))   packed->dames |= bit;
+    }
+
+    double tenths = round(score * 10);
+    if      (score > WIN_SCORE / 2)       packed->score = TRAINING_WIN;
+    else if (score < -WIN_SCORE / 2)      packed->score = -TRAINING_WIN;
+    else if (tenths >= TRAINING_WIN)      packed->score = TRAINING_WIN - 1;
+    else if (tenths <= -TRAINING_WIN)     packed->score = -(TRAINING_WIN - 1);
+    else                                  packed->score = (int16_t) tenths;
+
+    packed->flags = (state->current_player == BLACK ? PACKED_BLACK_TO_MOVE : 0) | result << 1;
+}
+
+/* unpack_position sets 'state' up with the packed position (as if the game
+ * had just made progress, like game_from_text) and gives its score and
+ * result. */
+void unpack_position(Packed_position *packed, Game_state *state, double *score, Situation *result)
+{
+    Position p;
+    for (p.row = 0; p.row < BOARD_SIZE; p.row++)
+        for (p.col = 0; p.col < BOARD_SIZE; p.col++)
+            state->board[p.row][p.col] = EMPTY;
+
+    for (int square = 0; square < DARK_SQUARES; square++) {
+        Square_mask bit = (Square_mask) 1 << square;
+        if (!(packed->occupied & bit))
+            continue;
+        bool white = packed->white & bit, dame = packed->dames & bit;
+        Piece piece = white ? (dame ? WHITE_DAME : WHITE_STONE)
+                            : (dame ? BLACK_DAME : BLACK_STONE);
+        Position pos = dark_square_position(square);
+        state->board[pos.row][pos.col] = piece;
+    }
+
+    state->current_player = packed->flags & PACKED_BLACK_TO_MOVE ? BLACK : WHITE;
+    state->reversible_moves = 0;
+    game_rehash(state);
+#ifdef NNUE
+    nnue_refresh(state);
+#endif
+    update_situation(state);
+
+    if (score != NULL)
+        *score = abs(packed->score) == TRAINING_WIN ? copysign(WIN_SCORE, packed->score)
+                                                    : packed->score / 10.0;
+    if (result != NULL)
+        *result = (Situation) (packed->flags >> 1 & 3);
+}
+
+
+void training_header(Training_header *header, uint64_t count)
+{
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, TRAINING_MAGIC, 4);
+    header->version = TRAINING_VERSION;
+    header->board_size = BOARD_SIZE;
+    header->variant = VARIANT;
+    header->record_size = sizeof(Packed_position);
+    header->count = count;
+}
+
+/* training_header_ok tells whether a file with this header can be read by
+ * this build */
+bool training_header_ok(Training_header *header)
+{
+    return memcmp(header->magic, TRAINING_MAGIC, 4) == 0
+        && header->version == TRAINING_VERSION
+        && header->board_size == BOARD_SIZE
+        && header->variant == VARIANT
+        && header->record_size == sizeof(Packed_position);
+}
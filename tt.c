@@ -0,0 +1,319 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "checkers.h"
+
+/* The transposition table remembers what the search found out about the
+ * positions it visited, so that a position reached again (through a
+ * different order of movements, in the next iteration of iterative deepening,
+ * or in the next search altogether) doesn't have to be searched from scratch.
+ *
+ * It's a plain array indexed by the low bits of the position's hash, one
+ * entry per slot.  Each entry is two 64-bit words: the packed data and the
+ * hash XORed with the data.  An entry is only believed when XORing its two
+ * words gives back the hash being probed, so if two threads write the same
+ * slot at the same time the mixed-up entry is just treated as a miss, and no
+ * locks are needed. */
+
+static uint64_t pack_entry(Tt_entry *entry)
+{
+    uint32_t score_bits;
+    float score = entry->score;
+    memcpy(&score_bits, &score, sizeof(score_bits));
+
+    return (uint64_t) score_bits
+         | (uint64_t) (uint8_t) entry->depth << 32
+         | (uint64_t) entry->bound << 40
+         | (uint64_t) entry->move  << 48
+         | (uint64_t) entry->mirrored << 56;
+}
+
+static void unpack_entry(uint64_t data, Tt_entry *entry)
+{
+    uint32_t score_bits = (uint32_t) data;
+    float score;
+    memcpy(&score, &score_bits, sizeof(score));
+
+    entry->score = score;
+    entry->depth = (int8_t) (data >> 32);
+    entry->bound = (uint8_t) (data >> 40);
+    entry->move  = (uint8_t) (data >> 48);
+    entry->mirrored = (uint8_t) (data >> 56);
+}
+
+/* tt_init allocates a table of (at most) the given size, rounded down to a
+ * power of two number of slots.  Returns false if it couldn't be allocated. */
+bool tt_init(Ttable *tt, size_t megabytes)
+{
+    size_t slots = 1;
+    while (slots * 2 * sizeof(Tt_slot) <= megabytes << 20)
+        slots *= 2;
+
+    tt->slots = calloc(slots, sizeof(Tt_slot));
+    tt->mask = tt->slots != NULL ? slots - 1 : 0;
+    tt->mapping = NULL;
+    tt->mapped = 0;
+    return tt->slots != NULL;
+}
+
+void tt_free(Ttable *tt)
+{
+    if (tt->mapping != NULL)
+        munmap(tt->mapping, tt->mapped);
+    else
+        free(tt->slots);
+    tt->slots = NULL;
+    tt->mask = 0;
+    tt->mapping = NULL;
+    tt->mapped = 0;
+}
+
+/* tt_clear forgets everything in the table. */
+void tt_clear(Ttable *tt)
+{
+    if (tt->slots != NULL)
+        memset(tt->slots, 0, (tt->mask + 1) * sizeof(Tt_slot));
+}
+
+/* tt_probe looks the position with the given hash up, copying its entry into
+ * 'entry' and returning true if it's there. */
+bool tt_probe(Ttable *tt, uint64_t hash, Tt_entry *entry)
+{
+    if (tt->slots == NULL)
+        return false;
+
+    Tt_slot *slot = &tt->slots[hash & tt->mask];
+    uint64_t check = atomic_load_explicit(&slot->check, memory_order_relaxed);
+    uint64_t data  = atomic_load_explicit(&slot->data, memory_order_relaxed);
+    if ((check ^ data) != hash || data == 0)
+        return false;
+
+    unpack_entry(data, entry);
+    return true;
+}
+
+/* tt_store stores what was found out about the position with the given hash,
+ * replacing whatever was in its slot unless it's the same position searched
+ * deeper. */
+void tt_store(Ttable *tt, uint64_t hash, Tt_entry *entry)
+{
+    if (tt->slots == NULL)
+        return;
+
+    Tt_slot *slot = &tt->slots[hash & tt->mask];
+    Tt_entry old;
+    if (tt_probe(tt, hash, &old) && old.depth > entry->depth)
+        return;
+
+    uint64_t data = pack_entry(entry);
+    atomic_store_explicit(&slot->data, data, memory_order_relaxed);
+    atomic_store_explicit(&slot->check, hash ^ data, memory_order_relaxed);
+}
+
+
+// {{{ Saving and loading
+/* checksum adds 'size' bytes to a running checksum, a word at a time (the
+ * last few bytes, if 'size' isn't a multiple of 8, padded with zeros).  It's
+ * not cryptographic, just quick enough to go over gigabytes in about the
+ * time it takes to read them, and it notices any flipped or moved bits. */
+static uint64_t checksum(uint64_t sum, const void *data, size_t size)
+{
+    const unsigned char *bytes = data;
+    for (size_t i = 0; i < size; i += 8) {
+        uint64_t word = 0;
+        memcpy(&word, bytes + i, size - i < 8 ? size - i : 8);
+        sum = (sum ^ word) * 0x9E3779B97F4A7C15ull;
+        sum ^= sum >> 29;
+    }
+    return sum;
+}
+
+static void file_header(Tt_file_header *header, uint64_t slots)
+{
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, TT_FILE_MAGIC, 4);
+    header->version = TT_FILE_VERSION;
+    header->board_size = BOARD_SIZE;
+    header->variant = VARIANT;
+    header->slot_size = sizeof(Tt_slot);
+    header->slots = slots;
+}
+
+static uint64_t header_checksum(Tt_file_header *header)
+{
+    Tt_file_header copy = *header;
+    copy.header_checksum = 0;
+    return checksum(0, &copy, sizeof(copy));
+}
+
+/* tt_save writes the table and 'root' to 'path', through a temporary file
+ * renamed into place so that an interrupted save leaves the last one as it
+ * was.  The search can go on meanwhile: the slots are copied a chunk at a
+ * time, and the checksum is of the copy, so it matches the file even if
+ * the slots changed while it was being written.  (The file is then a mix of
+ * the table at different moments, which is fine for a table.)  Returns
+ * false, with errno set, if it couldn't. */
+bool tt_save(Ttable *tt, const char *path, const void *root, size_t root_size)
+{
+    if (tt->slots == NULL || root_size > TT_FILE_MAX_ROOT) {
+        errno = EINVAL;
+        return false;
+    }
+
+    char temporary[4096];
+    snprintf(temporary, sizeof(temporary), "%s.tmp", path);
+    int fd = open(temporary, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return false;
+
+    // The header goes last, once the slots' checksum is known
+    enum { CHUNK = 1 << 16 };
+    Tt_slot *chunk = malloc(CHUNK * sizeof(Tt_slot));
+    size_t slots = tt->mask + 1;
+    uint64_t sum = 0;
+    bool ok = chunk != NULL && lseek(fd, TT_FILE_HEADER, SEEK_SET) == TT_FILE_HEADER;
+    for (size_t start = 0; ok && start < slots; start += CHUNK) {
+        size_t count = slots - start < CHUNK ? slots - start : CHUNK;
+        for (size_t i = 0; i < count; i++) {
+            Tt_slot *slot = &tt->slots[start + i];
+            atomic_init(&chunk[i].check, atomic_load_explicit(&slot->check, memory_order_relaxed));
+            atomic_init(&chunk[i].data, atomic_load_explicit(&slot->data, memory_order_relaxed));
+        }
+        sum = checksum(sum, chunk, count * sizeof(Tt_slot));
+        ok = write_all(fd, chunk, count * sizeof(Tt_slot));
+    }
+    free(chunk);
+
+    char page[TT_FILE_HEADER];
+    memset(page, 0, sizeof(page));
+    Tt_file_header *header = (Tt_file_header *) page;
+    file_header(header, slots);
+    header->slots_checksum = sum;
+    header->root_size = root_size;
+    header->root_checksum = checksum(0, root, root_size);
+    header->header_checksum = header_checksum(header);
+    memcpy(page + sizeof(*header), root, root_size);
+
+    ok = ok && lseek(fd, 0, SEEK_SET) == 0 && write_all(fd, page, sizeof(page))
+            && fsync(fd) == 0;
+    int error = errno;
+    if (close(fd) != 0 || !ok || rename(temporary, path) != 0) {
+        error = ok ? errno : error;
+        unlink(temporary);
+        errno = error;
+        return false;
+    }
+    return true;
+}
+
+/* read_header reads and checks the header of the table in 'fd' and the root
+ * data after it (into 'page'), and that the file is as long as it says. */
+static bool read_header(int fd, char *page, size_t root_size)
+{
+    struct stat st;
+    Tt_file_header *header = (Tt_file_header *) page;
+    Tt_file_header expected;
+    if (pread(fd, page, TT_FILE_HEADER, 0) != TT_FILE_HEADER || fstat(fd, &st) != 0) {
+        errno = errno != 0 ? errno : EINVAL;
+        return false;
+    }
+
+    file_header(&expected, header->slots);
+    if (memcmp(header->magic, expected.magic, 4) != 0 || header->version != expected.version
+     || header->board_size != expected.board_size || header->variant != expected.variant
+     || header->slot_size != expected.slot_size || header->header_checksum != header_checksum(header)
+     || header->slots == 0 || (header->slots & (header->slots - 1)) != 0
+     || (uint64_t) st.st_size != TT_FILE_HEADER + header->slots * sizeof(Tt_slot)
+     || header->root_size != root_size
+     || header->root_checksum != checksum(0, page + sizeof(*header), root_size)) {
+        errno = EINVAL;
+        return false;
+    }
+    return true;
+}
+
+/* tt_load sets 'tt' up (as tt_init would) with the table saved in 'path',
+ * and copies the root data saved with it into 'root'. */
+bool tt_load(Ttable *tt, const char *path, void *root, size_t root_size)
+{
+    tt->slots = NULL;
+    tt->mask = 0;
+    tt->mapping = NULL;
+    tt->mapped = 0;
+    if (root_size > TT_FILE_MAX_ROOT) {
+        errno = EINVAL;
+        return false;
+    }
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+    char page[TT_FILE_HEADER];
+    errno = 0;
+    if (!read_header(fd, page, root_size)) {
+        int error = errno;
+        close(fd);
+        errno = error;
+        return false;
+    }
+
+    Tt_file_header *header = (Tt_file_header *) page;
+    size_t size = TT_FILE_HEADER + header->slots * sizeof(Tt_slot);
+    void *mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    int error = errno;
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        errno = error;
+        return false;
+    }
+    // The search goes all over the table: reading ahead would only waste time
+    madvise(mapping, size, MADV_RANDOM);
+
+    memcpy(root, page + sizeof(*header), root_size);
+    tt->slots = (Tt_slot *) ((char *) mapping + TT_FILE_HEADER);
+    tt->mask = header->slots - 1;
+    tt->mapping = mapping;
+    tt->mapped = size;
+    return true;
+}
+
+/* tt_verify_file checks the slots of the table saved in 'path' against their
+ * checksum (and its header, whatever root data it has). */
+bool tt_verify_file(const char *path)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+    char page[TT_FILE_HEADER];
+    Tt_file_header *header = (Tt_file_header *) page;
+    errno = 0;
+    if (pread(fd, page, TT_FILE_HEADER, 0) != TT_FILE_HEADER
+     || header->root_size > TT_FILE_MAX_ROOT || !read_header(fd, page, header->root_size)) {
+        int error = errno != 0 ? errno : EINVAL;
+        close(fd);
+        errno = error;
+        return false;
+    }
+
+    size_t size = TT_FILE_HEADER + header->slots * sizeof(Tt_slot);
+    void *mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    int error = errno;
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        errno = error;
+        return false;
+    }
+    madvise(mapping, size, MADV_SEQUENTIAL);
+    bool ok = checksum(0, (char *) mapping + TT_FILE_HEADER, size - TT_FILE_HEADER)
+           == header->slots_checksum;
+    munmap(mapping, size);
+    if (!ok)
+        errno = EINVAL;
+    return ok;
+}
+// }}}
@@ -1,5 +1,8 @@
 #include <stdio.h>
 #include <ctype.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
 
 #include "checkers.h"
 
@@ -12,6 +15,43 @@ void print_indentation(int i) {
     while (i-- > 0) putchar(' ');
 }
 
+char* write_position(Position *pos, char *str) {
+    sprintf(str, "(%d,%d)", pos->col, pos->row);
+    return str;
+}
+
+long now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* next_random is a small random number generator (xorshift64*) whose state
+ * is 'seed', so that each thread can have its own: rand() isn't meant for
+ * several threads. */
+uint32_t next_random(uint64_t *seed) {
+    *seed ^= *seed >> 12;
+    *seed ^= *seed << 25;
+    *seed ^= *seed >> 27;
+    return (uint32_t) ((*seed * 0x2545F4914F6CDD1Dull) >> 32);
+}
+
+/* write_all writes all of 'data', however many write calls it takes;
+ * returns false if one fails. */
+bool write_all(int fd, const void *data, size_t size) {
+    const char *bytes = data;
+    while (size > 0) {
+        ssize_t written = write(fd, bytes, size);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return false;
+        bytes += written;
+        size -= written;
+    }
+    return true;
+}
+
 //
 // Predicates
 //